@@ -47,17 +47,27 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <sensor_msgs/image_encodings.h>  // ROS header for the different supported image encoding types
 #include <sensor_msgs/fill_image.h>
 #include <spinnaker_camera_driver/camera_exceptions.h>
-#include <cv_bridge/cv_bridge.h>
 
+#include <atomic>
+#include <functional>
 #include <sstream>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <utility>
+#include <vector>
 
 // Header generated by dynamic_reconfigure
 #include <spinnaker_camera_driver/SpinnakerConfig.h>
+#include "spinnaker_camera_driver/burst_capture.h"
 #include "spinnaker_camera_driver/camera.h"
+#include "spinnaker_camera_driver/capture_metrics.h"
+#include "spinnaker_camera_driver/control_queue.h"
 #include "spinnaker_camera_driver/cm3.h"
 #include "spinnaker_camera_driver/set_property.h"
+#include "spinnaker_camera_driver/frame_ring.h"
+#include "spinnaker_camera_driver/huge_pages.h"
+#include "spinnaker_camera_driver/pixel_converter.h"
 
 // Spinnaker SDK
 #include "Spinnaker.h"
@@ -79,6 +89,8 @@ public:
   * dynamic_reconfigure, values that are not valid are changed by the driver and can
   * be inspected after this function ends.
   * This function will stop and restart the camera when called on a SensorLevels::RECONFIGURE_STOP level.
+  * While capturing, changes on the RECONFIGURE_RUNNING level are queued without waiting for the grab lock and applied
+  * by grabImage() before the next frame. Errors are then logged instead of thrown.
   * \param config  camera_library::CameraConfig object passed by reference.  Values will be changed to those the driver
   * is currently using.
   * \param level  Reconfiguration level. See constants below for details.
@@ -138,6 +150,17 @@ public:
   */
   void grabImage(sensor_msgs::Image* image, const std::string& frame_id);
 
+  /*!
+  * \brief Drains the frames of a FrameBurstStart trigger into a burst buffer.
+  *
+  * Waits up to the grab timeout for the first frame, then copies the frames into burst as fast as they arrive
+  * without converting or publishing them. A burst cut short by a timeout after its first frame is kept. The
+  * frames are still taken off the stream if burst has no free buffer.
+  * \param frame_count Number of frames in a burst, AcquisitionBurstFrameCount.
+  * \return Number of frames received.
+  */
+  uint32_t grabBurst(BurstCapture* burst, const uint32_t frame_count);
+
   /*!
   * \brief Will set grabImage timeout for the camera.
   *
@@ -159,7 +182,183 @@ public:
   */
   void setDesiredCamera(const uint32_t& id);
 
+  /*!
+  * \brief Sets the transport parameters used for GigE cameras.
+  *
+  * Applied on connect(), ignored for other interfaces.
+  * \param auto_packet_size If true, the largest packet size the network path carries unfragmented is discovered and
+  * packet_size is ignored.
+  * \param packet_size The packet size in bytes to use if auto_packet_size is false.
+  * \param packet_delay The inter-packet delay in timestamp ticks to use if cameras_per_nic is 0.
+  * \param cameras_per_nic Number of cameras streaming through the same network interface. If not 0, the packet delay
+  * is computed so that the packets of all these cameras interleave at link speed.
+  */
+  void setGigEParameters(const bool auto_packet_size, const unsigned int packet_size, const unsigned int packet_delay,
+                         const unsigned int cameras_per_nic);
+
+  /*!
+  * \brief Reads the packet and frame counters of the transport layer stream.
+  *
+  * Counters that the device or the Spinnaker version does not provide are skipped. Called from the diagnostics
+  * thread, so reading the counters does not throw.
+  * \param statistics Filled with name and value of every available counter, empty if not connected or on failure.
+  * \return false if the counters could not be read, e.g. because the camera was unplugged.
+  */
+  bool getStreamStatistics(std::vector<std::pair<std::string, int64_t> >* statistics);
+
+  /*!
+  * \brief Attaches a pre-trigger ring buffer that receives a copy of every grabbed frame.
+  *
+  * Must be called before the acquisition thread starts grabbing. Pass an empty pointer to detach.
+  */
+  void setFrameRing(const std::shared_ptr<FrameRing>& frame_ring)
+  {
+    frame_ring_ = frame_ring;
+  }
+
+  /// Counts grabbed frames and times the retrieve and convert stages, same threading rules as setFrameRing.
+  void setMetrics(const std::shared_ptr<CaptureMetrics>& metrics)
+  {
+    metrics_ = metrics;
+  }
+
+  /// Receives the name, frame ID and camera timestamp in nanoseconds of a device event, 0 if not reported.
+  typedef std::function<void(const std::string&, const uint64_t, const uint64_t)> DeviceEventCallback;
+
+  /*!
+  * \brief Enables device events on the camera, callback is called from the event thread of the SDK for each.
+  *
+  * Must be called before connect(), the events are enabled again on every reconnect. The callback delays the
+  * events that follow it and must return quickly.
+  * \param events Entries of EventSelector, e.g. ExposureEnd or FrameStart. Unsupported ones are skipped.
+  */
+  void setDeviceEvents(const std::vector<std::string>& events, const DeviceEventCallback& callback)
+  {
+    device_events_ = events;
+    device_event_callback_ = callback;
+  }
+
+  /*!
+  * \brief Converts the frames of grabImage to encoding on the way into the message, see PixelConverter.
+  *
+  * Pixel formats without a conversion to encoding are published as they come from the camera.
+  * \param encoding mono8, rgb8 or bgr8, empty to always publish the pixel format of the camera.
+  */
+  void setOutputEncoding(const std::string& encoding);
+
+  /*!
+  * \brief Sets a manual gain in dB, queued like a RECONFIGURE_RUNNING configuration while capturing.
+  */
   void setGain(const float& gain);
+
+  /// Sets a manual exposure time in microseconds, queued like setGain().
+  void setExposureTime(const float exposure_time);
+
+  /// Sets manual red and blue white balance ratios, queued like setGain().
+  void setWhiteBalance(const float red, const float blue);
+
+  /*!
+  * \brief Caps the acquisition frame rate of every following configuration, see Camera::setFrameRateLimit.
+  *
+  * Kept across reconnects. \param limit Frame rate in Hz, 0 removes the cap.
+  */
+  void setFrameRateLimit(const float limit);
+
+  /*!
+  * \brief Limits the bytes per second the camera sends over its link through DeviceLinkThroughputLimit.
+  *
+  * Kept across reconnects. \param limit Bytes per second, 0 restores the maximum.
+  */
+  void setLinkThroughputLimit(const int limit);
+
+  /*!
+  * \brief Overrides the pixel format of every following RECONFIGURE_STOP configuration, see Camera::setPixelFormat.
+  *
+  * Kept across reconnects. \param format GenICam PixelFormat like "Mono16", empty to remove the override.
+  */
+  void setPixelFormat(const std::string& format);
+
+  /*!
+  * \brief Programs the on-camera sequencer to bracket exposure and gain, see Camera::setSequence.
+  *
+  * Stops the acquisition while the sets are written. Kept across reconnects.
+  * Throws std::runtime_error if the camera has no sequencer or too few sets, the sequencer is then off.
+  * \param sets Sets captured in turn with every frame, empty to turn the sequencer off.
+  */
+  void setSequence(const std::vector<Camera::SequencerSet>& sets);
+
+  /*!
+  * \brief Gets the sequencer set the last grabbed frame was exposed with.
+  *
+  * Only valid in the thread calling grabImage.
+  * \param index Set to the index of the set. \param length Set to the number of sets in the sequence.
+  * \param set Set to the exposure and gain of the set.
+  * \return false if the frame was not captured by the sequencer.
+  */
+  bool getSequenceSet(uint32_t* index, uint32_t* length, Camera::SequencerSet* set) const;
+
+  /*!
+  * \brief Executes TriggerSoftware on the camera.
+  *
+  * Does not wait for grabImage, which may be blocked waiting for the frame of this trigger. The camera must be
+  * configured with enable_trigger On and trigger_source Software for a frame to follow.
+  * Throws std::runtime_error if not connected or the camera has no software trigger.
+  */
+  void fireSoftwareTrigger();
+
+  /// How grabImage picks frames when the consumer falls behind the camera.
+  enum FrameDelivery
+  {
+    DELIVER_ALL,    ///< Every frame in order, latency grows up to the buffer count when falling behind.
+    DELIVER_NEWEST  ///< The newest complete frame, older buffered frames are dropped.
+  };
+
+  /*!
+  * \brief Sets the buffer handling of the stream, takes effect with the next start().
+  *
+  * DELIVER_NEWEST uses the NewestOnly buffer handling of the SDK if available, otherwise grabImage drains the queue.
+  */
+  void setFrameDelivery(const FrameDelivery delivery);
+
+  /*!
+  * \brief Acquires into buffers allocated by the driver on 2 MB pages instead of the ones the SDK allocates.
+  *
+  * The buffers are sized for the payload of the camera and handed to the SDK by start(). Needs Spinnaker 2 or later
+  * and the SPINNAKER_USER_BUFFERS build option, otherwise the SDK keeps allocating the buffers.
+  * \param count Number of frames the buffers hold, 0 for the buffers of the SDK.
+  * \param lock mlock the buffers.
+  */
+  void setUserBuffers(const size_t count, const bool lock);
+
+  /// The buffers of the current acquisition, NULL while the SDK allocates them.
+  std::shared_ptr<const HugePageBuffer> getUserBuffers();
+
+  /// Frames the camera sent that grabImage never returned, counted from gaps in the frame IDs.
+  uint64_t getDroppedFrames() const
+  {
+    return dropped_frames_;
+  }
+
+  /// Number of incomplete frames grabbed since construction, including those dropped by frame checking.
+  uint64_t getIncompleteFrames() const
+  {
+    return incomplete_frames_;
+  }
+
+  /*!
+  * \brief Latches the camera clock to relate image timestamps to the host.
+  *
+  * \param offset Set to the nanoseconds to add to a camera timestamp to get std::chrono::steady_clock time.
+  * \return false if the camera has no timestamp latch.
+  */
+  bool getClockOffset(int64_t* offset);
+
+  /// Nominal payload bandwidth of the link the camera is connected with in bytes per second, 0 if unknown.
+  double getLinkSpeed() const
+  {
+    return link_speed_;
+  }
+
   int getHeightMax();
   int getWidthMax();
   Spinnaker::GenApi::CNodePtr readProperty(const Spinnaker::GenICam::gcstring property_name);
@@ -183,8 +382,26 @@ private:
   Spinnaker::ChunkData image_metadata_;
 
   std::mutex mutex_;  ///< A mutex to make sure that we don't try to grabImages while reconfiguring or vice versa.
-  volatile bool captureRunning_;  ///< A status boolean that checks if the camera has been started and is loading images
-                                  ///  into its buffer.
+  std::atomic<bool> captureRunning_;  ///< A status boolean that checks if the camera has been started and is loading
+                                      ///  images into its buffer.
+
+  /// A change that can be applied while streaming, handed to the acquisition thread through controls_.
+  struct ControlRequest
+  {
+    enum Type
+    {
+      CONFIGURATION,
+      GAIN,
+      EXPOSURE_TIME,
+      WHITE_BALANCE
+    };
+    Type type;
+    spinnaker_camera_driver::SpinnakerConfig config;  ///< For CONFIGURATION.
+    float value;                                      ///< For GAIN and EXPOSURE_TIME, the red ratio for WHITE_BALANCE.
+    float blue;                                       ///< For WHITE_BALANCE.
+  };
+  ControlQueue<ControlRequest> controls_;
+  std::vector<ControlRequest> pending_controls_;  ///< Drained from controls_ by applyPendingControls().
 
   /// If true, camera is currently running in color mode, otherwise camera is running in mono mode
   bool isColor_;
@@ -196,14 +413,79 @@ private:
   unsigned int packet_size_;
   /// GigE packet delay:
   unsigned int packet_delay_;
+  /// Number of cameras streaming through the same network interface, 0 uses packet_delay_ as is:
+  unsigned int cameras_per_nic_;
+  /// If true, the connected camera is a GigE Vision device:
+  bool is_gige_;
 
   uint64_t timeout_;
 
+  double link_speed_;          ///< Detected in connect(), bytes per second.
+  float frame_rate_limit_;     ///< Reapplied to every new camera_.
+  int link_throughput_limit_;  ///< Reapplied on connect, 0 keeps the camera maximum.
+  std::string pixel_format_;   ///< Reapplied to every new camera_, empty if not overridden.
+  std::atomic<uint64_t> incomplete_frames_;
+
+  FrameDelivery frame_delivery_;
+  bool drain_queue_;         ///< Set by start() if the SDK cannot keep only the newest frame by itself.
+  bool have_frame_id_;       ///< Whether a frame was grabbed since start().
+  uint64_t last_frame_id_;   ///< Of the previous grabbed frame, valid with have_frame_id_.
+  std::atomic<uint64_t> dropped_frames_;
+
+  std::vector<Camera::SequencerSet> sequence_;  ///< Reprogrammed into every new camera_, empty if not sequencing.
+  uint64_t first_frame_id_;                    ///< Of the first frame after start(), the sequence starts with it.
+  int sequence_index_;                         ///< Set of the last grabbed frame, -1 if not sequenced.
+  uint32_t sequence_length_;                   ///< Sets in the sequence of the last grabbed frame.
+  Camera::SequencerSet sequence_set_;          ///< Values of sequence_index_.
+
+  std::mutex trigger_mutex_;                    ///< Guards trigger_ptr_, grabImage may hold mutex_ for a whole timeout.
+  Spinnaker::GenApi::CCommandPtr trigger_ptr_;  ///< TriggerSoftware of the connected camera.
+
+  std::shared_ptr<FrameRing> frame_ring_;  ///< Optional pre-trigger ring fed from grabImage.
+  std::shared_ptr<CaptureMetrics> metrics_;  ///< Optional, updated from grabImage.
+  std::unique_ptr<PixelConverter> converter_;  ///< Set by setOutputEncoding, guarded by mutex_.
+
+  size_t user_buffer_count_;  ///< Frames in user_buffers_, 0 to let the SDK allocate the buffers.
+  bool lock_user_buffers_;
+  std::shared_ptr<HugePageBuffer> user_buffers_;  ///< Kept across restarts, the SDK holds on to them while acquiring.
+
+  std::vector<std::string> device_events_;  ///< Enabled on every connect, none if empty.
+  DeviceEventCallback device_event_callback_;
+  std::shared_ptr<Spinnaker::DeviceEvent> device_event_handler_;  ///< Registered with pCam_ while connected.
+
+  /// Turns on the notification of device_events_ and registers device_event_handler_.
+  void enableDeviceEvents();
+
   // This function configures the camera to add chunk data to each image. It does
   // this by enabling each type of chunk data before enabling chunk data mode.
   // When chunk data is turned on, the data is made available in both the nodemap
   // and each image.
   void ConfigureChunkData(const Spinnaker::GenApi::INodeMap& nodeMap);
+
+  /// ROS encoding of the frames the camera sends with bits_per_pixel.
+  std::string getImageEncoding(const size_t bits_per_pixel);
+
+  /// Counts the frames missing before frame_id and remembers the first frame after start().
+  void countFrameId(const uint64_t frame_id);
+
+  /// Reads the sequencer set of a grabbed frame from its chunk data, falling back to counting frames.
+  int readSequenceIndex(Spinnaker::ImagePtr image_ptr, const uint64_t frame_id) const;
+
+  /// Applies packet size, packet delay and packet resend to a connected GigE camera.
+  void configureGigE();
+
+  /// Applies frame_delivery_ to the stream, called before acquisition starts.
+  void configureBufferHandling();
+
+  /// Hands user_buffers_ to the stream, reallocated if the payload outgrew them, called before acquisition starts.
+  void configureUserBuffers();
+
+  /// Queues request while capturing, otherwise applies it right away under mutex_.
+  void submitControl(const ControlRequest& request);
+
+  /// Applies all queued controls, skipping those replaced by a newer request of the same type. Needs mutex_.
+  void applyPendingControls();
+  void applyControl(const ControlRequest& request);
 };
 }  // namespace spinnaker_camera_driver
 #endif  // SPINNAKER_CAMERA_DRIVER_SPINNAKERCAMERA_H
@@ -0,0 +1,152 @@
+/**
+Software License Agreement (BSD)
+
+\file      auto_exposure.h
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef SPINNAKER_CAMERA_DRIVER_AUTO_EXPOSURE_H
+#define SPINNAKER_CAMERA_DRIVER_AUTO_EXPOSURE_H
+
+#include <diagnostic_msgs/DiagnosticStatus.h>
+#include <ros/ros.h>
+#include <sensor_msgs/Image.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//*******************************************
+// Software auto exposure and gray world white
+// balance run on the grabbed frames. Every
+// few rows of the frame are metered into a
+// luminance histogram, weighted by a coarse
+// metering mask so that e.g. the sky can be
+// ignored. Exposure time is raised before
+// gain and lowered after it.
+//*******************************************
+
+namespace spinnaker_camera_driver
+{
+class AutoExposure
+{
+public:
+  struct Parameters
+  {
+    double target;          ///< Mean brightness to reach, as a fraction of full scale.
+    double max_saturated;   ///< Fraction of metered pixels allowed to saturate before exposure is reduced.
+    double min_exposure;    ///< Exposure time range in microseconds.
+    double max_exposure;
+    double min_gain;        ///< Gain range in dB.
+    double max_gain;
+    double damping;         ///< Fraction of the correction applied per step, between 0 and 1.
+    int settle_frames;      ///< Frames skipped after a change until the new exposure shows in the image.
+    int subsample;          ///< Meter every n-th row, every n-th quad row for Bayer images.
+    bool white_balance;     ///< Also balance red and blue of color images to a gray world.
+  };
+
+  /// Rectangle in fractions of the image size. Regions apply in order, so later ones override earlier ones.
+  struct MeteringRegion
+  {
+    double x;
+    double y;
+    double width;
+    double height;
+    int weight;  ///< 0 excludes the region, the default weight of the image is 1.
+  };
+
+  /// Weighted luminance histogram and channel sums of a frame.
+  struct Histogram
+  {
+    uint64_t bins[256];
+    uint64_t weight;       ///< Sum of the weights of all metered pixels.
+    uint64_t channels[3];  ///< Weighted sums of red, green and blue, color images only.
+  };
+
+  /// Size of the metering mask grid in each direction.
+  static const int GRID_SIZE = 16;
+
+  AutoExposure(const Parameters& parameters, const std::vector<MeteringRegion>& regions);
+
+  /*!
+  * \brief Reads metering regions from the parameter server.
+  *
+  * Every entry is a struct with x, y, width and height as fractions of the image and an integer weight.
+  * \return false if the parameter is malformed.
+  */
+  static bool loadRegions(const ros::NodeHandle& pnh, const std::string& param, std::vector<MeteringRegion>* regions);
+
+  /// Starts over from the current camera settings.
+  void reset(const double exposure_time, const double gain);
+
+  /*!
+  * \brief Meters image and steps exposure, gain and white balance towards the target.
+  *
+  * \return true if the settings changed and need to be applied to the camera.
+  */
+  bool process(const sensor_msgs::Image& image);
+
+  /*!
+  * \brief Fills histogram from every subsample-th row of image, weighted by the metering mask.
+  *
+  * \return false for unsupported encodings.
+  */
+  bool meter(const sensor_msgs::Image& image, Histogram* histogram) const;
+
+  double getExposureTime() const
+  {
+    return exposure_time_;
+  }
+  double getGain() const
+  {
+    return gain_;
+  }
+  double getRedRatio() const
+  {
+    return red_ratio_;
+  }
+  double getBlueRatio() const
+  {
+    return blue_ratio_;
+  }
+  /// True once the white balance was computed from a color frame.
+  bool hasWhiteBalance() const
+  {
+    return has_white_balance_;
+  }
+
+  diagnostic_msgs::DiagnosticStatus getStatus(const std::string& name) const;
+
+private:
+  Parameters parameters_;
+  uint8_t mask_[GRID_SIZE * GRID_SIZE];  ///< Weight of each grid cell, row major.
+  int settling_;                         ///< Frames left until the last change shows in the image.
+
+  // Written by the acquisition thread, read by reconfigure and diagnostics
+  std::atomic<double> exposure_time_;
+  std::atomic<double> gain_;
+  std::atomic<double> red_ratio_;
+  std::atomic<double> blue_ratio_;
+  std::atomic<bool> has_white_balance_;
+  std::atomic<double> brightness_;  ///< Metered mean of the last frame.
+  std::atomic<double> saturated_;   ///< Saturated fraction of the last frame.
+};
+}  // namespace spinnaker_camera_driver
+#endif  // SPINNAKER_CAMERA_DRIVER_AUTO_EXPOSURE_H
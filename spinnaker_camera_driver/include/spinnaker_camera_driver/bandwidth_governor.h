@@ -0,0 +1,103 @@
+/**
+Software License Agreement (BSD)
+
+\file      bandwidth_governor.h
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef SPINNAKER_CAMERA_DRIVER_BANDWIDTH_GOVERNOR_H
+#define SPINNAKER_CAMERA_DRIVER_BANDWIDTH_GOVERNOR_H
+
+#include <diagnostic_msgs/DiagnosticStatus.h>
+
+#include <string>
+
+//*******************************************
+// Picks frame rate, binning and sensor ROI so
+// that a camera stays within a bandwidth
+// budget. Frame rate is given up first, down
+// to a minimum, then resolution by binning,
+// and finally field of view by shrinking the
+// ROI around the image center.
+//*******************************************
+
+namespace spinnaker_camera_driver
+{
+class BandwidthGovernor
+{
+public:
+  /// A stream configuration. Width, height and offsets are in binned pixels like the sensor ROI configuration.
+  struct OperatingPoint
+  {
+    int binning;
+    int width;
+    int height;
+    int x_offset;
+    int y_offset;
+    double frame_rate;
+    double bytes_per_second;
+    double max_frame_rate;  ///< Highest frame rate at which this format still fits the budget.
+  };
+
+  /*!
+  * \param budget Bytes per second this camera may use.
+  * \param min_frame_rate Frame rate below which binning is raised instead.
+  * \param max_binning Largest binning factor the governor may select, the ROI is shrunk beyond that.
+  */
+  BandwidthGovernor(const double budget, const double min_frame_rate, const int max_binning);
+
+  /*!
+  * \brief Chooses the operating point closest to the requested one that fits the budget and the link.
+  *
+  * \param requested Configured stream, only ever reduced.
+  * \param sensor_width Sensor width in unbinned pixels.
+  * \param sensor_height Sensor height in unbinned pixels.
+  * \param bits_per_pixel Transmitted bits per pixel of the current pixel format.
+  * \param link_limit Bytes per second the link can carry, 0 if unknown.
+  */
+  OperatingPoint choose(const OperatingPoint& requested, const int sensor_width, const int sensor_height,
+                        const double bits_per_pixel, const double link_limit);
+
+  /// The effective budget used by the last choose() call, the smaller of the configured budget and the link limit.
+  double getEffectiveBudget() const
+  {
+    return effective_budget_;
+  }
+
+  /// True if the last choice had to lower binning or ROI, not only the frame rate.
+  bool isFormatReduced() const
+  {
+    return chosen_.binning != requested_.binning || chosen_.width != requested_.width ||
+           chosen_.height != requested_.height;
+  }
+
+  /// Describes the last choice for the diagnostics aggregator.
+  diagnostic_msgs::DiagnosticStatus getStatus(const std::string& name, const std::string& hardware_id) const;
+
+private:
+  double budget_;
+  double min_frame_rate_;
+  int max_binning_;
+
+  double effective_budget_;
+  OperatingPoint requested_;
+  OperatingPoint chosen_;
+};
+}  // namespace spinnaker_camera_driver
+#endif  // SPINNAKER_CAMERA_DRIVER_BANDWIDTH_GOVERNOR_H
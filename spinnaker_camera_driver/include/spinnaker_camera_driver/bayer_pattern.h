@@ -0,0 +1,64 @@
+/**
+Software License Agreement (BSD)
+
+\file      bayer_pattern.h
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef SPINNAKER_CAMERA_DRIVER_BAYER_PATTERN_H
+#define SPINNAKER_CAMERA_DRIVER_BAYER_PATTERN_H
+
+#include <string>
+
+//*******************************************
+// Bayer pattern of ROS image encodings and of
+// camera PixelFormat names, for everything
+// that meters, previews or demosaics raw
+// frames.
+//*******************************************
+
+namespace spinnaker_camera_driver
+{
+/*!
+* \brief Index of the red sample in the top left 2x2 quad, row major: 0 RGGB, 1 GRBG, 2 GBRG, 3 BGGR.
+*
+* \param encoding A ROS encoding like bayer_grbg8 or a PixelFormat like BayerGR12p.
+* \return -1 if encoding is not a Bayer mosaic.
+*/
+inline int getBayerRedIndex(const std::string& encoding)
+{
+  std::string first_row;
+  if (encoding.compare(0, 6, "bayer_") == 0)
+    first_row = encoding.substr(6, 2);
+  else if (encoding.compare(0, 5, "Bayer") == 0)
+    first_row = encoding.substr(5, 2);
+
+  // The first row decides the pattern, the second one holds the other two colors
+  if (first_row == "rg" || first_row == "RG")
+    return 0;
+  if (first_row == "gr" || first_row == "GR")
+    return 1;
+  if (first_row == "gb" || first_row == "GB")
+    return 2;
+  if (first_row == "bg" || first_row == "BG")
+    return 3;
+  return -1;
+}
+}  // namespace spinnaker_camera_driver
+#endif  // SPINNAKER_CAMERA_DRIVER_BAYER_PATTERN_H
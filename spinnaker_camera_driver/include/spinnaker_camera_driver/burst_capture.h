@@ -0,0 +1,152 @@
+/**
+Software License Agreement (BSD)
+
+\file      burst_capture.h
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef SPINNAKER_CAMERA_DRIVER_BURST_CAPTURE_H
+#define SPINNAKER_CAMERA_DRIVER_BURST_CAPTURE_H
+
+#include <image_transport/image_transport.h>
+#include <ros/ros.h>
+#include <sensor_msgs/CameraInfo.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "spinnaker_camera_driver/worker_pool.h"
+
+//*******************************************
+// Frames of a FrameBurstStart trigger are
+// drained at wire speed into buffers that
+// hold a whole burst, allocated in one pool.
+// A background thread publishes the burst on
+// burst/image_raw, optionally records it to a
+// bag file and reports its timing on
+// burst_statistics.
+//*******************************************
+
+namespace spinnaker_camera_driver
+{
+class BurstCapture
+{
+public:
+  /// What the camera reports with each frame of a burst.
+  struct FrameInfo
+  {
+    uint64_t device_stamp;  ///< Nanoseconds on the camera clock.
+    bool incomplete;
+  };
+
+  /*!
+  * \brief Advertises burst/image_raw and burst_statistics.
+  *
+  * \param buffer_count Number of bursts that can be published while the next one is captured.
+  * \param record_directory Each burst is written to a bag file in this directory, not recorded if empty.
+  * \param prefix File name prefix of the bag files, usually the camera serial.
+  * \param frame_id Frame id of the published images.
+  */
+  BurstCapture(ros::NodeHandle& nh, const size_t buffer_count, const std::string& record_directory,
+               const std::string& prefix, const std::string& frame_id);
+
+  /*!
+  * \brief Reserves a buffer for a burst, called from the acquisition thread with its first frame.
+  *
+  * The pool is only reallocated if the burst length or the frame geometry changed while no burst was published.
+  * \return false if every buffer is still being published, the burst is then skipped.
+  */
+  bool begin(const uint32_t frame_count, const uint32_t width, const uint32_t height, const uint32_t step,
+             const std::string& encoding);
+
+  /// Storage of the next frame of the burst begun last, step * height bytes.
+  uint8_t* nextFrame()
+  {
+    return pool_.get() + (burst_->buffer * frame_count_ + burst_->frames.size()) * frame_size_;
+  }
+
+  /// Called once the next frame was copied to nextFrame().
+  void frameReceived(const FrameInfo& info);
+
+  /*!
+  * \brief Hands the burst begun last to the publishing thread, does nothing if no burst was begun.
+  *
+  * \param info Published with every frame, the stamp is that of the frame.
+  */
+  void end(const sensor_msgs::CameraInfo& info);
+
+  uint64_t getBurstsSkipped() const
+  {
+    return bursts_skipped_;
+  }
+
+private:
+  struct FreeDeleter
+  {
+    void operator()(void* p) const
+    {
+      std::free(p);
+    }
+  };
+
+  /// A burst handed to the publishing thread, the frames stay in the buffer until it is published.
+  struct Burst
+  {
+    size_t buffer;
+    std::vector<FrameInfo> frames;
+    uint32_t width;
+    uint32_t height;
+    uint32_t step;
+    std::string encoding;
+    ros::Time stamp;  ///< Host time of the first frame.
+    double drain_time;
+    sensor_msgs::CameraInfo info;
+  };
+
+  void publish(const std::shared_ptr<Burst>& burst);
+  void record(const Burst& burst, const std::vector<sensor_msgs::ImagePtr>& images) const;
+
+  image_transport::ImageTransport it_;
+  image_transport::CameraPublisher pub_;
+  ros::Publisher statistics_pub_;
+  std::string record_directory_;
+  std::string prefix_;
+  std::string frame_id_;
+
+  size_t buffer_count_;
+  std::unique_ptr<uint8_t[], FreeDeleter> pool_;   ///< buffer_count_ bursts of frame_count_ frames.
+  std::unique_ptr<std::atomic<bool>[]> busy_;      ///< Set while a buffer waits to be published.
+  uint32_t frame_count_;
+  size_t frame_size_;
+
+  // Only used by the acquisition thread
+  std::shared_ptr<Burst> burst_;  ///< Begun last, NULL if none or skipped.
+  std::chrono::steady_clock::time_point drain_start_;
+
+  std::atomic<uint64_t> bursts_;
+  std::atomic<uint64_t> bursts_skipped_;
+  WorkerPool worker_;  ///< Last so that the bursts still queued are published before the pool is freed.
+};
+}  // namespace spinnaker_camera_driver
+#endif  // SPINNAKER_CAMERA_DRIVER_BURST_CAPTURE_H
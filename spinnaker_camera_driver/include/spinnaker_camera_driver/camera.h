@@ -27,6 +27,9 @@ ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSI
 
 #include <ros/ros.h>
 
+#include <string>
+#include <vector>
+
 // Header generated by dynamic_reconfigure
 #include <spinnaker_camera_driver/SpinnakerConfig.h>
 #include "spinnaker_camera_driver/set_property.h"
@@ -63,9 +66,59 @@ public:
   static const uint8_t LEVEL_RECONFIGURE_RUNNING = 0;
 
   virtual void setGain(const float& gain);
+
+  /// Switches exposure to manual and sets the exposure time in microseconds.
+  virtual void setExposureTime(const float exposure_time);
+
+  /// Switches white balance to manual and sets the red and blue balance ratios.
+  virtual void setBRWhiteBalance(const float red, const float blue);
+  /*!
+  * \brief Caps the acquisition frame rate, also forcing manual frame rate control while set.
+  *
+  * Takes effect with the next configuration. \param limit Frame rate in Hz, 0 removes the cap.
+  */
+  void setFrameRateLimit(const float limit)
+  {
+    frame_rate_limit_ = limit;
+  }
+
+  /*!
+  * \brief Overrides the pixel format of the configuration and the parameter file.
+  *
+  * Takes effect with the next RECONFIGURE_STOP configuration. \param format GenICam PixelFormat, empty to not override.
+  */
+  void setPixelFormat(const std::string& format)
+  {
+    pixel_format_ = format;
+  }
   int getHeightMax();
   int getWidthMax();
 
+  /*!
+  * \brief Set the stream channel parameters of GigE cameras.
+  *
+  * Must be called while the camera is not streaming.
+  * \param packet_size GevSCPSPacketSize in bytes, should be the largest size the network path carries unfragmented.
+  * \param packet_delay GevSCPD, the delay between stream packets in timestamp ticks.
+  */
+  virtual void setGigEParameters(const unsigned int packet_size, const unsigned int packet_delay);
+
+  /// One step of the on-camera sequencer.
+  struct SequencerSet
+  {
+    float exposure_time;  ///< Microseconds.
+    float gain;           ///< dB.
+  };
+
+  /*!
+  * \brief Programs the sequencer to cycle through the sets, advancing with every frame.
+  *
+  * Must be called while the camera is not streaming. The sequencer then owns exposure and gain and is reprogrammed
+  * after every RECONFIGURE_STOP configuration. Every frame carries the active set in the SequencerSetActive chunk.
+  * \param sets Sets in the order they are captured, empty to turn the sequencer off.
+  */
+  virtual void setSequence(const std::vector<SequencerSet>& sets);
+
   Spinnaker::GenApi::CNodePtr
   readProperty(const Spinnaker::GenICam::gcstring property_name);
 
@@ -76,6 +129,18 @@ protected:
 
   int height_max_;
   int width_max_;
+  float frame_rate_limit_;  ///< Upper bound applied to every frame rate set, 0 if unlimited.
+  std::string pixel_format_;  ///< Pixel format override, empty if not set.
+  std::vector<SequencerSet> sequence_;  ///< Sets programmed into the sequencer, empty if it is off.
+
+  /// Writes sequence_ to the sequencer, or turns it off if sequence_ is empty.
+  virtual void applySequence();
+
+  /// Returns frame_rate reduced to the frame rate limit.
+  float limitFrameRate(const float frame_rate) const
+  {
+    return frame_rate_limit_ > 0.0f && frame_rate > frame_rate_limit_ ? frame_rate_limit_ : frame_rate;
+  }
 
   /*!
   * \brief Changes the video mode of the connected camera.
@@ -85,50 +150,6 @@ protected:
   */
   virtual void setFrameRate(const float frame_rate);
   virtual void setImageControlFormats(const spinnaker_camera_driver::SpinnakerConfig& config);
-  /*!
-  * \brief Set parameters relative to GigE cameras.
-  *
-  * \param auto_packet_size Flag stating if packet size should be automatically determined or not.
-  * \param packet_size The packet size value to use if auto_packet_size is false.
-  */
-  // TODO(mhosmar): Implement later
-  // void setGigEParameters(bool auto_packet_size, unsigned int packet_size, unsigned int packet_delay);
-
-  /*!
-  * \brief Will autoconfigure the packet size of the GigECamera with the given GUID.
-  *
-  * Note that this is expected only to work for GigE cameras, and only if the camera
-  * is not connected.
-  *
-  * \param guid the camera to autoconfigure
-  */
-  // TODO(mhosmar): Implement later
-  // void setupGigEPacketSize(FlyCapture2::PGRGuid & guid);
-
-  /*!
-  * \brief Will configure the packet size of the GigECamera with the given GUID to a given value.
-  *
-  * Note that this is expected only to work for GigE cameras, and only if the camera
-  * is not connected.
-  *
-  * \param guid the camera to autoconfigure
-  * \param packet_size The packet size value to use.
-  */
-  // TODO(mhosmar): Implement later
-  // void setupGigEPacketSize(FlyCapture2::PGRGuid & guid, unsigned int packet_size);
-
-  /*!
-  * \brief Will configure the packet delay of the GigECamera with the given GUID to a given value.
-  *
-  * Note that this is expected only to work for GigE cameras, and only if the camera
-  * is not connected.
-  *
-  * \param guid the camera to autoconfigure
-  * \param packet_delay The packet delay value to use.
-  */
-  // TODO(mhosmar): Implement later
-  // void setupGigEPacketDelay(FlyCapture2::PGRGuid & guid, unsigned int packet_delay);
-
   /*!
   * \brief Gets the current frame rate.
   *
@@ -150,8 +171,6 @@ protected:
   // float getCameraTemperature();
 
   // TODO(mhosmar): Implement the following methods later
-  // void setBRWhiteBalance(bool auto_white_balance, uint16_t &blue, uint16_t &red);
-
   // uint getGain();
 
   // uint getShutter();
@@ -0,0 +1,131 @@
+/**
+Software License Agreement (BSD)
+
+\file      capture_metrics.h
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef SPINNAKER_CAMERA_DRIVER_CAPTURE_METRICS_H
+#define SPINNAKER_CAMERA_DRIVER_CAPTURE_METRICS_H
+
+#include <spinnaker_camera_driver/CameraMetrics.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+//*******************************************
+// Counters and latency histograms of the
+// capture path. Updated without locks by the
+// acquisition thread and read by the
+// exporters, published as CameraMetrics and
+// written in the Prometheus text format.
+//*******************************************
+
+namespace spinnaker_camera_driver
+{
+/// Histogram of durations with log2 spaced buckets from 10 us to about 5 s.
+class DurationHistogram
+{
+public:
+  static const size_t BUCKETS = 20;  ///< Bounded buckets, one more counts everything above.
+
+  DurationHistogram();
+
+  void record(const double seconds);
+
+  /// Upper bound of bucket in seconds.
+  static double upperBound(const size_t bucket);
+
+  uint64_t count(const size_t bucket) const
+  {
+    return buckets_[bucket];
+  }
+  uint64_t count() const
+  {
+    return count_;
+  }
+  double sum() const
+  {
+    return sum_us_ * 1e-6;
+  }
+
+private:
+  std::atomic<uint64_t> buckets_[BUCKETS + 1];
+  std::atomic<uint64_t> count_;
+  std::atomic<uint64_t> sum_us_;
+};
+
+class CaptureMetrics
+{
+public:
+  enum Stage
+  {
+    STAGE_RETRIEVE,  ///< Waiting for the SDK to hand out the next image.
+    STAGE_CONVERT,   ///< From the SDK buffer to the image message.
+    STAGE_PUBLISH,   ///< From the grabbed image to every output published.
+    STAGE_COUNT
+  };
+
+  CaptureMetrics();
+
+  void recordStage(const Stage stage, const double seconds)
+  {
+    stages_[stage].record(seconds);
+  }
+
+  /*!
+  * \brief Fills message with the current counters.
+  *
+  * The rates cover the time since the previous call, so only one thread may fill messages.
+  */
+  void fillMessage(const std::string& serial, CameraMetrics* message);
+
+  /// Writes the metrics in the Prometheus text exposition format, labelled with camera and serial.
+  void writePrometheus(std::ostream& out, const std::string& camera, const std::string& serial) const;
+
+  /*!
+  * \brief Replaces path with the Prometheus metrics, for the textfile collector of node_exporter.
+  *
+  * Written to a temporary file first and renamed, so readers never see a partial file.
+  * \return false if the file could not be written.
+  */
+  bool writePrometheusFile(const std::string& path, const std::string& camera, const std::string& serial) const;
+
+  std::atomic<uint64_t> frames_grabbed;
+  std::atomic<uint64_t> frames_incomplete;
+  std::atomic<uint64_t> frames_dropped;
+  std::atomic<uint64_t> frames_published;
+  std::atomic<uint64_t> timeouts;
+  std::atomic<uint64_t> errors;
+  std::atomic<uint64_t> reconnects;
+  std::atomic<uint64_t> bytes;
+
+private:
+  DurationHistogram stages_[STAGE_COUNT];
+
+  // At the previous fillMessage, for the rates
+  std::chrono::steady_clock::time_point last_fill_;
+  uint64_t last_frames_;
+  uint64_t last_bytes_;
+};
+}  // namespace spinnaker_camera_driver
+#endif  // SPINNAKER_CAMERA_DRIVER_CAPTURE_METRICS_H
@@ -47,6 +47,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <diagnostic_msgs/DiagnosticStatus.h>
 #include <ros/ros.h>
 
+#include <map>
+#include <mutex>
 #include <utility>
 #include <string>
 #include <vector>
@@ -95,6 +97,14 @@ public:
                      std::pair<float, float> operational = std::make_pair(0.0, 0.0), float lower_bound = 0,
                      float upper_bound = 0);
 
+  /*!
+   * \brief Publish a status computed by the driver itself with every following update
+   *
+   * Replaces the previous status with the same name. Can be called from any thread.
+   * \param status is the complete status, its hardware_id is set to the camera serial
+   */
+  void updateStatus(const diagnostic_msgs::DiagnosticStatus& status);
+
 private:
   /*
    * diagnostic_params is aData Structure to represent a parameter and its
@@ -131,6 +141,11 @@ private:
   // vectors to keep track of the items to publish
   std::vector<diagnostic_params<int>> integer_params_;
   std::vector<diagnostic_params<float>> float_params_;
+  // stream counters of the previous update, to detect new losses
+  std::map<std::string, int64_t> previous_stream_statistics_;
+  // statuses reported by the driver, keyed by name
+  std::mutex driver_status_mutex_;
+  std::map<std::string, diagnostic_msgs::DiagnosticStatus> driver_status_;
   // Information about the device model, firmware, etc
   // TODO(mlowe): Allow these to be configured
   // clang-format off
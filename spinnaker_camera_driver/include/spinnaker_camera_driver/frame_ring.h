@@ -0,0 +1,145 @@
+/**
+Software License Agreement (BSD)
+
+\file      frame_ring.h
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef SPINNAKER_CAMERA_DRIVER_FRAME_RING_H
+#define SPINNAKER_CAMERA_DRIVER_FRAME_RING_H
+
+#include <ros/ros.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//*******************************************
+// Pre-trigger ring buffer of raw frames.
+// The storage is allocated once and sized in
+// bytes. The acquisition thread pushes frames
+// without locking, a background thread writes
+// the frames around a trigger to a bag file.
+//*******************************************
+
+namespace spinnaker_camera_driver
+{
+class FrameRing
+{
+public:
+  /*!
+  * \brief Allocates the ring storage and starts the dump thread.
+  *
+  * \param capacity_bytes Total number of bytes available for frame data.
+  * \param output_directory Directory the bag files are written to.
+  * \param prefix File name prefix of the bag files, usually the camera serial.
+  * \param frame_id Frame id written into the header of the dumped images.
+  */
+  FrameRing(const size_t capacity_bytes, const std::string& output_directory, const std::string& prefix,
+            const std::string& frame_id);
+  ~FrameRing();
+
+  /*!
+  * \brief Copies a frame into the ring, overwriting the oldest one.
+  *
+  * Called from the acquisition thread for every grabbed frame. Never blocks unless the frame size changed.
+  */
+  void push(const uint8_t* data, const uint32_t width, const uint32_t height, const uint32_t step,
+            const std::string& encoding, const ros::Time& stamp);
+
+  /*!
+  * \brief Schedules the frames in [trigger_time - pre, trigger_time + post] to be written to disk.
+  *
+  * Returns immediately, the frames are written by the dump thread while acquisition continues.
+  * \param path Filled with the bag file that will be written.
+  * \return false if a dump is already in progress.
+  */
+  bool requestDump(const ros::Time& trigger_time, const ros::Duration& pre, const ros::Duration& post,
+                   std::string* path);
+
+  bool isDumping() const
+  {
+    return dumping_;
+  }
+
+  size_t getCapacity() const
+  {
+    return capacity_;
+  }
+
+private:
+  struct FrameHeader
+  {
+    ros::Time stamp;
+    uint32_t width;
+    uint32_t height;
+    uint32_t step;
+    char encoding[32];
+  };
+
+  struct Slot
+  {
+    /// Seqlock word: odd while the producer writes the slot, 2 * (index + 1) once frame `index` is complete.
+    std::atomic<uint64_t> sequence;
+    FrameHeader header;
+    uint8_t* data;
+  };
+
+  struct DumpJob
+  {
+    ros::Time start;
+    ros::Time end;
+    std::string path;
+  };
+
+  void repartition(const size_t frame_size);
+  /// Index of the oldest frame that can still be read given the current head.
+  uint64_t oldestIndex(const uint64_t head);
+  /// Copies frame `index` out of the ring. Returns false if it was overwritten before or during the copy.
+  bool readFrame(const uint64_t index, FrameHeader* header, std::vector<uint8_t>* buffer);
+  void dumpThread();
+  void writeDump(const DumpJob& job);
+
+  size_t capacity_;
+  std::string output_directory_;
+  std::string prefix_;
+  std::string frame_id_;
+  std::unique_ptr<uint8_t[]> storage_;  ///< Allocated once, shared by all slots.
+
+  std::mutex layout_mutex_;  ///< Only taken by the producer when the frame size changes.
+  std::unique_ptr<Slot[]> slots_;
+  size_t slot_count_;
+  size_t slot_size_;
+  std::atomic<uint64_t> head_;  ///< Index of the next frame to be pushed.
+  uint64_t layout_start_;       ///< First frame index stored with the current layout.
+
+  std::mutex job_mutex_;
+  std::condition_variable job_cv_;
+  std::unique_ptr<DumpJob> job_;
+  std::atomic<bool> dumping_;
+  std::atomic<bool> shutdown_;
+  std::thread dump_thread_;
+};
+}  // namespace spinnaker_camera_driver
+#endif  // SPINNAKER_CAMERA_DRIVER_FRAME_RING_H
@@ -0,0 +1,99 @@
+/**
+Software License Agreement (BSD)
+
+\file      hdr_fusion.h
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef SPINNAKER_CAMERA_DRIVER_HDR_FUSION_H
+#define SPINNAKER_CAMERA_DRIVER_HDR_FUSION_H
+
+#include <ros/ros.h>
+#include <sensor_msgs/Image.h>
+#include <std_msgs/Header.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//*******************************************
+// Fusion of exposure brackets captured by
+// the camera sequencer. The raw frames of a
+// bracket are kept in a pool allocated once,
+// when the last one arrives they are merged
+// pixel by pixel on the mono or Bayer data
+// and one frame is published on image_hdr.
+//*******************************************
+
+namespace spinnaker_camera_driver
+{
+class HdrFusion
+{
+public:
+  enum Method
+  {
+    RADIANCE,        ///< Linear radiance in 16 bit, the full scale of the shortest exposure maps to 65535.
+    EXPOSURE_FUSION  ///< Average weighted by how well exposed each sample is, in the encoding of the input.
+  };
+
+  /// Advertises image_hdr.
+  HdrFusion(ros::NodeHandle& nh, const Method method);
+
+  /// Parses "radiance" or "exposure_fusion". Returns false for any other name.
+  static bool parseMethod(const std::string& name, Method* method);
+
+  /*!
+  * \brief Adds a frame of a bracket, fusing and publishing the bracket with its last frame.
+  *
+  * Frames must arrive in sequence order, a bracket missing a frame is skipped. Supports mono and Bayer images
+  * with 8 or 16 bits per sample. The fused frame has the header of the first frame of the bracket.
+  * \param index Position of the frame in the bracket. \param length Number of frames in the bracket.
+  * \param exposure_time Exposure time of the frame in microseconds.
+  * \return true if the frame completed a bracket.
+  */
+  bool add(const sensor_msgs::Image& image, const uint32_t index, const uint32_t length, const float exposure_time);
+
+  bool hasSubscribers() const
+  {
+    return pub_.getNumSubscribers() > 0;
+  }
+
+  /*!
+  * \brief Merges frames of equal geometry, packed rows with 16 bit samples in little endian.
+  *
+  * \param frames Samples of each frame. \param exposure_times Microseconds, one for each frame.
+  * \param fused Its geometry and encoding must be set, filled with the fused samples.
+  */
+  static void fuse(const Method method, const std::vector<const uint8_t*>& frames,
+                   const std::vector<float>& exposure_times, const int bit_depth, sensor_msgs::Image* fused);
+
+private:
+  ros::Publisher pub_;
+  Method method_;
+
+  std::vector<std::vector<uint8_t> > pool_;  ///< Samples of the bracket so far, one frame per slot.
+  std::vector<float> exposure_times_;        ///< Of the frames in pool_.
+  uint32_t next_index_;                      ///< Index the next frame must have, 0 waits for a new bracket.
+  std_msgs::Header header_;                  ///< Of the first frame of the bracket.
+  std::string encoding_;
+  uint32_t width_;
+  uint32_t height_;
+};
+}  // namespace spinnaker_camera_driver
+#endif  // SPINNAKER_CAMERA_DRIVER_HDR_FUSION_H
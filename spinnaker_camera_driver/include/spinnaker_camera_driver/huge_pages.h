@@ -0,0 +1,178 @@
+/**
+Software License Agreement (BSD)
+
+\file      huge_pages.h
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef SPINNAKER_CAMERA_DRIVER_HUGE_PAGES_H
+#define SPINNAKER_CAMERA_DRIVER_HUGE_PAGES_H
+
+#include <boost/shared_ptr.hpp>
+#include <diagnostic_msgs/DiagnosticStatus.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//*******************************************
+// Frame memory backed by 2 MB pages: the
+// acquisition buffers handed to the SDK, the
+// storage of the published messages, which
+// is reused instead of allocated per frame,
+// and counters of the page faults and TLB
+// misses the acquisition thread takes.
+//*******************************************
+
+namespace spinnaker_camera_driver
+{
+/*!
+* \brief One contiguous region of 2 MB pages, prefaulted and optionally locked into memory.
+*
+* Explicit huge pages are used if the hugetlbfs pool has enough of them (vm.nr_hugepages), otherwise a 2 MB aligned
+* mapping is advised to use transparent huge pages.
+*/
+class HugePageBuffer
+{
+public:
+  /*!
+  * \param size Bytes, rounded up to a whole number of 2 MB pages.
+  * \param lock mlock the region, a failure e.g. beyond RLIMIT_MEMLOCK is logged and the region kept unlocked.
+  * \throws std::runtime_error if the memory cannot be mapped.
+  */
+  HugePageBuffer(const size_t size, const bool lock);
+  ~HugePageBuffer();
+
+  HugePageBuffer(const HugePageBuffer&) = delete;
+  HugePageBuffer& operator=(const HugePageBuffer&) = delete;
+
+  uint8_t* data() const
+  {
+    return data_;
+  }
+
+  size_t size() const
+  {
+    return size_;
+  }
+
+  /// Adds the size and page backing to status, keys prefixed with name.
+  void addToStatus(const std::string& name, diagnostic_msgs::DiagnosticStatus* status) const;
+
+private:
+  uint8_t* data_;
+  size_t size_;
+  bool hugetlb_;  ///< Explicit huge pages, otherwise transparent ones if the kernel grants them.
+  bool locked_;
+};
+
+/*!
+* \brief Grows the capacity of data to at least size, advising the new storage to use transparent huge pages.
+*
+* Does nothing if the capacity suffices, so storage that is reused keeps its pages.
+*/
+void reserveHugePages(std::vector<uint8_t>* data, const size_t size);
+
+/*!
+* \brief Recycles messages once every publisher and subscriber let go of them.
+*
+* Reused messages keep the capacity of their data, so a frame is copied into memory that is already mapped instead
+* of freshly allocated pages. Only the owning thread may call acquire().
+*/
+template <class M>
+class MessagePool
+{
+public:
+  /// \param size Messages kept for reuse, 0 to allocate every message.
+  explicit MessagePool(const size_t size) : size_(size), reused_(0), allocated_(0)
+  {
+  }
+
+  /// A message nobody else holds anymore, otherwise a new one. Reused messages keep the values of their last use.
+  boost::shared_ptr<M> acquire()
+  {
+    for (size_t i = 0; i < messages_.size(); ++i)
+    {
+      if (messages_[i].use_count() == 1)
+      {
+        ++reused_;
+        return messages_[i];
+      }
+    }
+    boost::shared_ptr<M> message(new M);
+    ++allocated_;
+    if (messages_.size() < size_)
+      messages_.push_back(message);
+    return message;
+  }
+
+  uint64_t getReused() const
+  {
+    return reused_;
+  }
+
+  uint64_t getAllocated() const
+  {
+    return allocated_;
+  }
+
+private:
+  size_t size_;
+  std::vector<boost::shared_ptr<M> > messages_;
+  uint64_t reused_;
+  uint64_t allocated_;
+};
+
+/*!
+* \brief Counts the page faults and data TLB misses of one thread.
+*
+* The TLB misses come from a perf counter, they are not reported if perf_event_open is not permitted
+* (kernel.perf_event_paranoid).
+*/
+class MemoryCounters
+{
+public:
+  MemoryCounters();
+  ~MemoryCounters();
+
+  MemoryCounters(const MemoryCounters&) = delete;
+  MemoryCounters& operator=(const MemoryCounters&) = delete;
+
+  /// Starts counting on the calling thread, the thread that calls getStatus afterwards.
+  void attach();
+
+  /*!
+  * \brief Adds the faults and TLB misses per frame since the previous call to status.
+  *
+  * \param frames Frames grabbed so far, the counts are divided by the frames since the previous call.
+  */
+  void getStatus(const uint64_t frames, diagnostic_msgs::DiagnosticStatus* status);
+
+private:
+  int tlb_fd_;  ///< perf counter of the attached thread, -1 if unavailable.
+  uint64_t last_frames_;
+  uint64_t last_minor_faults_;
+  uint64_t last_major_faults_;
+  uint64_t last_tlb_misses_;
+
+  /// Reads the counters of the attached thread, tlb_misses is left alone without a perf counter.
+  void read(uint64_t* minor_faults, uint64_t* major_faults, uint64_t* tlb_misses) const;
+};
+}  // namespace spinnaker_camera_driver
+#endif  // SPINNAKER_CAMERA_DRIVER_HUGE_PAGES_H
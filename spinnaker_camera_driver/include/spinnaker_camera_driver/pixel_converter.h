@@ -0,0 +1,100 @@
+/**
+Software License Agreement (BSD)
+
+\file      pixel_converter.h
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef SPINNAKER_CAMERA_DRIVER_PIXEL_CONVERTER_H
+#define SPINNAKER_CAMERA_DRIVER_PIXEL_CONVERTER_H
+
+#include <sensor_msgs/Image.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//*******************************************
+// Conversion of the pixel formats of the
+// camera to mono8, rgb8 or bgr8 in a single
+// pass from the buffer of the camera into
+// the image message. 12 and 16 bit formats
+// are narrowed to 8 bits first, only Bayer
+// frames need a scratch buffer for that.
+//*******************************************
+
+namespace spinnaker_camera_driver
+{
+class PixelConverter
+{
+public:
+  /// Converts to encoding, see isOutputEncoding.
+  explicit PixelConverter(const std::string& encoding);
+
+  /// True for the encodings frames can be converted to: mono8, rgb8 and bgr8.
+  static bool isOutputEncoding(const std::string& encoding);
+
+  const std::string& getEncoding() const
+  {
+    return encoding_;
+  }
+
+  /*!
+  * \brief Converts a frame of the camera straight into the data of image.
+  *
+  * Fills the geometry, encoding and data of image, not its header.
+  * \param pixel_format PixelFormat the camera sent the frame in, e.g. BayerRG8 or YUV422Packed.
+  * \param stride Bytes per row of data.
+  * \return false if pixel_format cannot be converted, image is left untouched.
+  */
+  bool convert(const std::string& pixel_format, const uint8_t* data, const uint32_t width, const uint32_t height,
+               const uint32_t stride, sensor_msgs::Image* image);
+
+  /*!
+  * \brief Converts a mono8/16, Bayer 8/16, rgb8 or bgr8 image into image, e.g. after the raw frame was corrected.
+  *
+  * Fills the geometry, encoding and data of image, not its header.
+  * \return false if the encoding of source cannot be converted, image is left untouched.
+  */
+  bool convert(const sensor_msgs::Image& source, sensor_msgs::Image* image);
+
+  /*!
+  * \brief OpenCV demosaicing codes of a Bayer mosaic.
+  *
+  * \param red Index of the red sample, see getBayerRedIndex.
+  * \return false if red is not a valid index.
+  */
+  static bool getBayerCodes(const int red, int* to_rgb, int* to_bgr, int* to_gray);
+
+  /// Keeps the most significant byte of count 16 bit samples.
+  static void narrow16(const uint16_t* source, const size_t count, uint8_t* destination);
+
+  /*!
+  * \brief Keeps the most significant byte of count 12 bit samples, two of them packed in three bytes.
+  *
+  * \param msb_first True for the GigE Vision Packed formats, false for the p formats of the PFNC.
+  */
+  static void narrow12(const uint8_t* source, const size_t count, const bool msb_first, uint8_t* destination);
+
+private:
+  std::string encoding_;
+  std::vector<uint8_t> narrowed_;  ///< 8 bit Bayer samples of 12 and 16 bit frames, demosaiced from here.
+};
+}  // namespace spinnaker_camera_driver
+#endif  // SPINNAKER_CAMERA_DRIVER_PIXEL_CONVERTER_H
@@ -0,0 +1,106 @@
+/**
+Software License Agreement (BSD)
+
+\file      raw_compressor.h
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef SPINNAKER_CAMERA_DRIVER_RAW_COMPRESSOR_H
+#define SPINNAKER_CAMERA_DRIVER_RAW_COMPRESSOR_H
+
+#include "spinnaker_camera_driver/worker_pool.h"
+
+#include <ros/ros.h>
+#include <sensor_msgs/CompressedImage.h>
+#include <sensor_msgs/Image.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+//*******************************************
+// Lossless compression of raw frames. Bayer
+// mosaics are split into their four color
+// planes, each plane is delta coded against
+// its left neighbour and packed with LZ4.
+// Frames are compressed on a worker pool and
+// published in order as CompressedImage with
+// the format "<encoding>; lz4 planar delta".
+//*******************************************
+
+namespace spinnaker_camera_driver
+{
+class RawCompressor
+{
+public:
+  /*!
+  * \brief Advertises compressed_raw and starts the workers.
+  *
+  * \param threads Number of frames compressed in parallel.
+  * \param queue_size Frames that may wait for a worker before new frames are dropped.
+  * \param acceleration LZ4 acceleration, 1 compresses best, larger values trade ratio for speed.
+  */
+  RawCompressor(ros::NodeHandle& nh, const size_t threads, const size_t queue_size, const int acceleration);
+  ~RawCompressor();
+
+  /*!
+  * \brief Queues the image for compression without copying it.
+  *
+  * The image must not be modified afterwards, the workers keep a reference until it is compressed.
+  * \return false if the frame was dropped because all workers are busy.
+  */
+  bool publish(const sensor_msgs::ImageConstPtr& image);
+
+  bool hasSubscribers() const
+  {
+    return pub_.getNumSubscribers() > 0;
+  }
+
+  size_t getDroppedFrames() const
+  {
+    return dropped_;
+  }
+
+  /// Compresses image. Returns false if the encoding is not supported.
+  static bool compress(const sensor_msgs::Image& image, const int acceleration,
+                       sensor_msgs::CompressedImage* compressed);
+
+  /// Restores an image published on compressed_raw. Returns false if the data is not a valid compressed frame.
+  static bool decompress(const sensor_msgs::CompressedImage& compressed, sensor_msgs::Image* image);
+
+private:
+  /// Publishes the compressed frame once all frames submitted before it are published. NULL skips the frame.
+  void finish(const uint64_t sequence, const sensor_msgs::CompressedImagePtr& compressed);
+
+  ros::Publisher pub_;
+  int acceleration_;
+
+  std::mutex order_mutex_;
+  std::condition_variable order_cv_;
+  uint64_t next_submit_;   ///< Sequence number of the next frame handed to the pool.
+  uint64_t next_publish_;  ///< Sequence number of the next frame to be published.
+  std::atomic<size_t> dropped_;
+
+  std::unique_ptr<WorkerPool> pool_;  ///< Destroyed first so no task runs on a partly destroyed compressor.
+};
+}  // namespace spinnaker_camera_driver
+#endif  // SPINNAKER_CAMERA_DRIVER_RAW_COMPRESSOR_H
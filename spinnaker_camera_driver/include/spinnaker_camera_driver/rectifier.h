@@ -0,0 +1,84 @@
+/**
+Software License Agreement (BSD)
+
+\file      rectifier.h
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef SPINNAKER_CAMERA_DRIVER_RECTIFIER_H
+#define SPINNAKER_CAMERA_DRIVER_RECTIFIER_H
+
+#include <ros/ros.h>
+#include <image_transport/image_transport.h>
+#include <sensor_msgs/CameraInfo.h>
+#include <sensor_msgs/Image.h>
+
+#include <opencv2/core/core.hpp>
+
+//*******************************************
+// Rectification of the grabbed frames in
+// the driver. Fixed point remap tables are
+// built from the calibration and rebuilt
+// only when the calibration, binning or ROI
+// changes. Publishes image_rect and, for
+// color cameras, image_rect_color, each
+// only while it has subscribers.
+//*******************************************
+
+namespace spinnaker_camera_driver
+{
+class Rectifier
+{
+public:
+  /// Advertises image_rect and image_rect_color.
+  explicit Rectifier(ros::NodeHandle& nh);
+
+  bool hasSubscribers() const
+  {
+    return mono_pub_.getNumSubscribers() > 0 || color_pub_.getNumSubscribers() > 0;
+  }
+
+  /*!
+  * \brief Rectifies the image straight from its buffer and publishes it.
+  *
+  * Bayer images are demosaiced first. Nothing is published while the camera is not calibrated.
+  * \param info Calibration of the full sensor, with the binning and the ROI of the image in the binned frame.
+  */
+  void publish(const sensor_msgs::Image& image, const sensor_msgs::CameraInfo& info);
+
+private:
+  /// Rebuilds the remap tables if the calibration or the geometry changed. Returns false if not calibrated.
+  bool updateMaps(const sensor_msgs::CameraInfo& info, const cv::Size& size);
+
+  /// Remaps source into a new image message with the header and encoding given.
+  sensor_msgs::ImagePtr remap(const cv::Mat& source, const std_msgs::Header& header, const std::string& encoding);
+
+  image_transport::ImageTransport it_;
+  image_transport::Publisher mono_pub_;
+  image_transport::Publisher color_pub_;
+
+  sensor_msgs::CameraInfo maps_info_;  ///< Calibration and geometry the tables were built for.
+  cv::Size maps_size_;
+  cv::Mat map_xy_;  ///< Integer source coordinates, CV_16SC2.
+  cv::Mat map_fraction_;  ///< Index into the interpolation weights of the fractional coordinates, CV_16UC1.
+  cv::Mat demosaiced_;  ///< Reused for Bayer images.
+  cv::Mat gray_;        ///< Reused for color images.
+};
+}  // namespace spinnaker_camera_driver
+#endif  // SPINNAKER_CAMERA_DRIVER_RECTIFIER_H
@@ -0,0 +1,102 @@
+/**
+Software License Agreement (BSD)
+
+\file      roi_streamer.h
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef SPINNAKER_CAMERA_DRIVER_ROI_STREAMER_H
+#define SPINNAKER_CAMERA_DRIVER_ROI_STREAMER_H
+
+#include <ros/ros.h>
+#include <image_transport/image_transport.h>
+#include <sensor_msgs/CameraInfo.h>
+#include <sensor_msgs/Image.h>
+#include <sensor_msgs/RegionOfInterest.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//*******************************************
+// Software regions of interest. Crops any
+// number of rectangles out of each grabbed
+// frame and publishes every crop on its own
+// camera topic, without touching the sensor
+// ROI or restarting acquisition.
+//*******************************************
+
+namespace spinnaker_camera_driver
+{
+class RoiStreamer
+{
+public:
+  /// A rectangle in pixels of the published image. A width or height of 0 extends the crop to the image border.
+  struct Roi
+  {
+    std::string name;
+    uint32_t x_offset;
+    uint32_t y_offset;
+    uint32_t width;
+    uint32_t height;
+    double rate;  ///< Maximum publishing rate in Hz, 0 publishes every frame.
+  };
+
+  /*!
+  * \brief Advertises roi/<name>/image_raw and roi/<name>/camera_info for every ROI.
+  *
+  * Each ROI can be moved at runtime by publishing a sensor_msgs/RegionOfInterest on roi/<name>/set_roi.
+  */
+  RoiStreamer(ros::NodeHandle& nh, const std::vector<Roi>& rois);
+
+  /*!
+  * \brief Reads a list of ROIs from the parameter server.
+  *
+  * Every entry is a struct with a name, x_offset, y_offset, width, height and an optional rate.
+  * \return false if the parameter is missing or malformed.
+  */
+  static bool loadRois(const ros::NodeHandle& pnh, const std::string& param, std::vector<Roi>* rois);
+
+  /*!
+  * \brief Publishes the crops of the image that have subscribers.
+  *
+  * \param info Camera info of the full image, the ROI of each crop is added to its ROI in the binned frame.
+  */
+  void publish(const sensor_msgs::Image& image, const sensor_msgs::CameraInfo& info);
+
+private:
+  struct Stream
+  {
+    Roi roi;
+    image_transport::CameraPublisher pub;
+    ros::Subscriber sub;
+    ros::Time last_publish;
+  };
+
+  void setRoiCb(const sensor_msgs::RegionOfInterestConstPtr& msg, const size_t index);
+  /// Clips the ROI to the image and aligns it to the Bayer pattern. Returns false if nothing is left.
+  static bool clip(const Roi& roi, const sensor_msgs::Image& image, Roi* clipped);
+
+  image_transport::ImageTransport it_;
+  std::mutex mutex_;  ///< Protects the ROI rectangles, which are changed from subscriber callbacks.
+  std::vector<Stream> streams_;
+};
+}  // namespace spinnaker_camera_driver
+#endif  // SPINNAKER_CAMERA_DRIVER_ROI_STREAMER_H
@@ -0,0 +1,152 @@
+/**
+Software License Agreement (BSD)
+
+\file      sensor_correction.h
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef SPINNAKER_CAMERA_DRIVER_SENSOR_CORRECTION_H
+#define SPINNAKER_CAMERA_DRIVER_SENSOR_CORRECTION_H
+
+#include <ros/ros.h>
+#include <sensor_msgs/Image.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//*******************************************
+// Correction of sensor defects on the raw
+// mono or Bayer samples: dark frame
+// subtraction, flat field gain in fixed
+// point and replacement of defective pixels
+// from their neighbours of the same color.
+// The maps are stored per camera serial as
+// <serial>_dark.pgm, <serial>_flat.pgm and
+// <serial>_defects.txt and can be built
+// from the live camera.
+//*******************************************
+
+namespace spinnaker_camera_driver
+{
+class SensorCorrection
+{
+public:
+  enum Map
+  {
+    DARK,  ///< Average of frames taken with the lens covered.
+    FLAT   ///< Average of frames of a uniform light source, stored as gains.
+  };
+
+  static const int GAIN_BITS = 12;                       ///< Fraction bits of the flat field gains.
+  static const uint16_t UNIT_GAIN = 1 << GAIN_BITS;      ///< A gain of 1.
+  static const uint16_t MAX_GAIN = (8 << GAIN_BITS) - 1;  ///< Keeps the products of 16 bit samples below 2^31.
+
+  /*!
+  * \param directory Where the maps are stored.
+  * \param serial Prefix of the map file names.
+  */
+  SensorCorrection(const std::string& directory, const std::string& serial);
+
+  /*!
+  * \brief Directory of the camera calibration file, where the maps are stored next to it.
+  *
+  * Resolves file:// and package:// URLs, anything else gives ~/.ros/camera_info like the camera_info_manager.
+  */
+  static std::string directoryOf(const std::string& camera_info_url);
+
+  /// Parses "dark" or "flat". Returns false for any other name.
+  static bool parseMap(const std::string& name, Map* map);
+
+  /*!
+  * \brief Loads the maps saved for the camera, a missing map is not applied.
+  *
+  * \return false if a map exists but could not be read.
+  */
+  bool load();
+
+  /*!
+  * \brief Corrects the image in place, called from the acquisition thread for every grabbed frame.
+  *
+  * The uncorrected frame is first added to a map being built. Images whose geometry or bit depth does not match
+  * the maps are left alone.
+  */
+  void process(sensor_msgs::Image* image);
+
+  /*!
+  * \brief Averages the next frames into a map, saves it and redetects the defective pixels from both maps.
+  *
+  * Blocks until enough frames have been processed. The new map is applied from the next frame on.
+  * \param frames Number of frames averaged. \param timeout Seconds to wait for the frames.
+  * \param defects Set to the number of defective pixels. \param message Set to why building failed.
+  */
+  bool build(const Map map, const uint32_t frames, const double timeout, uint32_t* defects, std::string* message);
+
+  /// Number of pixels replaced in every frame.
+  size_t getDefectCount();
+
+private:
+  struct FreeDeleter
+  {
+    void operator()(void* p) const
+    {
+      std::free(p);
+    }
+  };
+  typedef std::unique_ptr<uint16_t[], FreeDeleter> AlignedMap;
+
+  /// Allocates a map of count samples aligned for the vector kernels, filled with value.
+  static AlignedMap allocate(const size_t count, const uint16_t value);
+
+  /// Finds the pixels that stand out from their neighbours of the same color in the dark or flat map.
+  void detectDefects(const bool bayer);
+
+  /// Replaces the defective pixels of the image with the average of their non defective neighbours.
+  void replaceDefects(sensor_msgs::Image* image, const bool bayer) const;
+
+  bool save(const Map map, std::string* message) const;
+  std::string path(const std::string& suffix) const;
+
+  std::string directory_;
+  std::string serial_;
+
+  std::mutex mutex_;  ///< Guards the maps and the build state, the maps are replaced while streaming.
+  uint32_t width_;
+  uint32_t height_;
+  int bit_depth_;              ///< Of the samples the dark map was taken with.
+  bool has_dark_;
+  bool has_flat_;
+  AlignedMap dark_;            ///< Samples subtracted, zero without a dark map.
+  AlignedMap gain_;            ///< Fixed point gains with GAIN_BITS fraction bits, UNIT_GAIN without a flat map.
+  std::vector<uint32_t> defects_;  ///< Sorted sample indices of the defective pixels.
+
+  // Building a map:
+  std::condition_variable build_cv_;
+  bool building_;
+  uint32_t build_frames_;          ///< Frames still to be added.
+  std::vector<uint32_t> sums_;     ///< Sum of the samples of the frames added so far.
+  sensor_msgs::Image build_geometry_;  ///< Geometry and encoding of the first frame added, without data.
+  std::string build_error_;        ///< Set if a frame did not match the first one.
+};
+}  // namespace spinnaker_camera_driver
+#endif  // SPINNAKER_CAMERA_DRIVER_SENSOR_CORRECTION_H
@@ -29,6 +29,7 @@ ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSI
 #include "Spinnaker.h"
 #include "SpinGenApi/SpinnakerGenApi.h"
 
+#include <algorithm>
 #include <string>
 
 namespace spinnaker_camera_driver
@@ -225,6 +226,52 @@ inline bool setProperty(Spinnaker::GenApi::INodeMap* node_map, const std::string
   return false;
 }
 
+// The quiet setters below are for values changed while streaming, e.g. on every frame by the auto exposure. They
+// skip writes that would not change anything, do not read DeviceID and only log success at debug level.
+
+inline bool setPropertyQuiet(Spinnaker::GenApi::INodeMap* node_map, const std::string& property_name,
+                             const std::string& entry_name)
+{
+  Spinnaker::GenApi::CEnumerationPtr enumerationPtr = node_map->GetNode(property_name.c_str());
+  if (!Spinnaker::GenApi::IsAvailable(enumerationPtr))
+  {
+    ROS_WARN_STREAM_THROTTLE(10, "[SpinnakerCamera]: Enumeration " << property_name << " not available.");
+    return false;
+  }
+  Spinnaker::GenApi::CEnumEntryPtr entryPtr = enumerationPtr->GetEntryByName(entry_name.c_str());
+  if (!Spinnaker::GenApi::IsAvailable(entryPtr) || !Spinnaker::GenApi::IsReadable(entryPtr))
+  {
+    ROS_WARN_STREAM_THROTTLE(10, "[SpinnakerCamera]: Entry name " << entry_name << " of " << property_name
+                                                                  << " not available.");
+    return false;
+  }
+  if (Spinnaker::GenApi::IsReadable(enumerationPtr) && enumerationPtr->GetIntValue() == entryPtr->GetValue())
+    return true;
+  if (!Spinnaker::GenApi::IsWritable(enumerationPtr))
+  {
+    ROS_WARN_STREAM_THROTTLE(10, "[SpinnakerCamera]: Enumeration " << property_name << " not writable.");
+    return false;
+  }
+  enumerationPtr->SetIntValue(entryPtr->GetValue());
+  ROS_DEBUG_STREAM("[SpinnakerCamera]: " << property_name << " set to " << entry_name << ".");
+  return true;
+}
+
+inline bool setPropertyQuiet(Spinnaker::GenApi::INodeMap* node_map, const std::string& property_name,
+                             const float value)
+{
+  Spinnaker::GenApi::CFloatPtr floatPtr = node_map->GetNode(property_name.c_str());
+  if (!Spinnaker::GenApi::IsAvailable(floatPtr) || !Spinnaker::GenApi::IsWritable(floatPtr))
+  {
+    ROS_WARN_STREAM_THROTTLE(10, "[SpinnakerCamera]: Feature " << property_name << " not writable.");
+    return false;
+  }
+  const double clamped = std::min<double>(std::max<double>(value, floatPtr->GetMin()), floatPtr->GetMax());
+  floatPtr->SetValue(clamped);
+  ROS_DEBUG_STREAM("[SpinnakerCamera]: " << property_name << " set to " << clamped << ".");
+  return true;
+}
+
 inline bool setMaxInt(Spinnaker::GenApi::INodeMap* node_map, const std::string& property_name)
 {
   Spinnaker::GenApi::CIntegerPtr intPtr = node_map->GetNode(property_name.c_str());
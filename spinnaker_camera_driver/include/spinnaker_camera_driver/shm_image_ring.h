@@ -0,0 +1,137 @@
+/**
+Software License Agreement (BSD)
+
+\file      shm_image_ring.h
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef SPINNAKER_CAMERA_DRIVER_SHM_IMAGE_RING_H
+#define SPINNAKER_CAMERA_DRIVER_SHM_IMAGE_RING_H
+
+#include <sensor_msgs/Image.h>
+#include <spinnaker_camera_driver/SharedImageDescriptor.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+//*******************************************
+// Image transport through a POSIX shared
+// memory ring. The driver writes each image
+// once into a slot and publishes a small
+// SharedImageDescriptor, local consumers map
+// the segment and read the pixels in place.
+//
+// This header has no Spinnaker dependency so
+// that consumer packages can use the reader.
+//*******************************************
+
+namespace spinnaker_camera_driver
+{
+namespace shm
+{
+static const uint32_t MAGIC = 0x53504e4b;  // "SPNK"
+static const uint32_t VERSION = 1;
+
+struct RingHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t layout;
+  uint32_t slot_count;
+  uint64_t slot_size;
+  uint64_t data_offset;
+};
+
+struct SlotHeader
+{
+  /// Odd while the slot is written, 2 * (sequence + 1) once image `sequence` is complete.
+  std::atomic<uint64_t> generation;
+  uint8_t padding[56];  ///< Keep each slot header on its own cache line.
+};
+}  // namespace shm
+
+class ShmImagePublisher
+{
+public:
+  /*!
+  * \brief Prepares a ring of slot_count images in the shared memory segment name.
+  *
+  * The segment is created on the first write, once the image size is known, and recreated whenever a larger image
+  * arrives. It is unlinked when the publisher is destroyed. A segment of the same name left behind by a publisher
+  * that did not exit cleanly is replaced with a warning.
+  */
+  ShmImagePublisher(const std::string& name, const uint32_t slot_count);
+  ~ShmImagePublisher();
+
+  /*!
+  * \brief Copies the image into the next slot and fills in the descriptor pointing to it.
+  *
+  * \return false if the segment could not be created.
+  */
+  bool write(const sensor_msgs::Image& image, SharedImageDescriptor* descriptor);
+
+private:
+  bool create(const size_t image_size);
+  void destroy();
+
+  std::string name_;
+  uint32_t slot_count_;
+  uint32_t layout_;
+  uint64_t sequence_;
+
+  uint8_t* mapping_;
+  size_t mapping_size_;
+  shm::RingHeader* header_;
+  shm::SlotHeader* slots_;
+};
+
+class ShmImageReader
+{
+public:
+  ShmImageReader();
+  ~ShmImageReader();
+
+  /*!
+  * \brief Returns the pixels described by descriptor without copying them.
+  *
+  * The pointer stays mapped until the next call with a different segment or layout. The driver may overwrite the
+  * slot at any time, call isValid() after using the pixels to make sure they were not replaced meanwhile.
+  * \return NULL if the segment can not be mapped or the image was already overwritten.
+  */
+  const uint8_t* acquire(const SharedImageDescriptor& descriptor);
+
+  /// True as long as the slot still holds the image of the descriptor.
+  bool isValid(const SharedImageDescriptor& descriptor) const;
+
+  /// Copies the image into a regular message. Returns false if it was overwritten before the copy completed.
+  bool copyTo(const SharedImageDescriptor& descriptor, sensor_msgs::Image* image);
+
+private:
+  bool map(const SharedImageDescriptor& descriptor);
+  void unmap();
+
+  std::string name_;
+  const uint8_t* mapping_;
+  size_t mapping_size_;
+  const shm::RingHeader* header_;
+  const shm::SlotHeader* slots_;
+};
+}  // namespace spinnaker_camera_driver
+#endif  // SPINNAKER_CAMERA_DRIVER_SHM_IMAGE_RING_H
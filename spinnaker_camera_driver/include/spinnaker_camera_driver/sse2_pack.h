@@ -0,0 +1,52 @@
+/**
+Software License Agreement (BSD)
+
+\file      sse2_pack.h
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef SPINNAKER_CAMERA_DRIVER_SSE2_PACK_H
+#define SPINNAKER_CAMERA_DRIVER_SSE2_PACK_H
+
+//*******************************************
+// SSE2 helpers shared by the vectorised
+// per-pixel loops.
+//*******************************************
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+
+#include <cstdint>
+
+namespace spinnaker_camera_driver
+{
+/*!
+* \brief Packs two vectors of 32 bit samples to eight unsigned 16 bit samples, saturating at 0 and 0xFFFF.
+*
+* SSE2 only packs to signed 16 bit, so this packs around the middle of the range.
+*/
+inline __m128i packUnsigned16(const __m128i low, const __m128i high)
+{
+  const __m128i middle = _mm_set1_epi32(32768);
+  const __m128i packed = _mm_packs_epi32(_mm_sub_epi32(low, middle), _mm_sub_epi32(high, middle));
+  return _mm_xor_si128(packed, _mm_set1_epi16(static_cast<int16_t>(0x8000)));
+}
+}  // namespace spinnaker_camera_driver
+#endif
+#endif  // SPINNAKER_CAMERA_DRIVER_SSE2_PACK_H
@@ -0,0 +1,95 @@
+/**
+Software License Agreement (BSD)
+
+\file      startup_coordinator.h
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef SPINNAKER_CAMERA_DRIVER_STARTUP_COORDINATOR_H
+#define SPINNAKER_CAMERA_DRIVER_STARTUP_COORDINATOR_H
+
+#include <diagnostic_msgs/DiagnosticStatus.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//*******************************************
+// Coordinated startup of the cameras loaded
+// into one nodelet manager. Each camera is
+// initialized by its own acquisition thread,
+// all of them at once instead of one after
+// another while the manager loads them, and
+// acquisition starts when the whole group is
+// configured.
+//*******************************************
+
+namespace spinnaker_camera_driver
+{
+class StartupCoordinator
+{
+public:
+  /*!
+  * \brief Returns the coordinator of group, created by the first member to join.
+  *
+  * Members of one group have to live in the same process, usually one nodelet manager.
+  * \param size Number of cameras in the group, the same for every member.
+  */
+  static std::shared_ptr<StartupCoordinator> join(const std::string& group, const size_t size);
+
+  /// Reports that member finished initializing in init_time seconds, releases the group if it was the last one.
+  void arrive(const std::string& member, const double init_time);
+
+  /// Waits up to timeout seconds for the group to be released, returns true if it was.
+  bool wait(const double timeout);
+
+  /// Releases the group without waiting for the missing members, e.g. once a startup timeout expired.
+  void release();
+
+  /// Records when member started acquisition, for the start skew of the group.
+  void started(const std::string& member);
+
+  /// Adds the group progress, the init time of every member and the start skew to status.
+  void addToStatus(diagnostic_msgs::DiagnosticStatus* status) const;
+
+private:
+  StartupCoordinator(const std::string& group, const size_t size);
+
+  struct Member
+  {
+    std::string name;
+    double init_time;                                ///< Seconds from connecting to configured.
+    std::chrono::steady_clock::time_point started;   ///< Zero until the member started acquisition.
+  };
+
+  Member& member(const std::string& name);
+
+  const std::string group_;
+  const size_t size_;
+  mutable std::mutex mutex_;
+  std::condition_variable released_cv_;
+  bool released_;
+  bool complete_;  ///< Released because all members arrived rather than by timeout.
+  std::vector<Member> members_;
+};
+}  // namespace spinnaker_camera_driver
+#endif  // SPINNAKER_CAMERA_DRIVER_STARTUP_COORDINATOR_H
@@ -0,0 +1,123 @@
+/**
+Software License Agreement (BSD)
+
+\file      thread_tuning.h
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef SPINNAKER_CAMERA_DRIVER_THREAD_TUNING_H
+#define SPINNAKER_CAMERA_DRIVER_THREAD_TUNING_H
+
+#include <diagnostic_msgs/DiagnosticStatus.h>
+#include <ros/ros.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//*******************************************
+// Scheduling of the driver threads: CPU
+// affinity, SCHED_FIFO priority and the NUMA
+// node memory is allocated from. A thread
+// applies its own tuning when it starts, so
+// everything it allocates afterwards, frame
+// buffers included, follows the policy.
+//*******************************************
+
+namespace spinnaker_camera_driver
+{
+class ThreadTuning
+{
+public:
+  ThreadTuning();
+
+  /*!
+  * \brief Reads <prefix>_cpus, <prefix>_priority and <prefix>_numa_node from the private node handle.
+  *
+  * The CPUs are given as a list like "2,3" or "4-7". A priority from 1 to 99 selects SCHED_FIFO, 0 keeps the default
+  * scheduler. Without a numa_node parameter default_numa_node is used, -1 leaves memory placement alone.
+  */
+  void load(const ros::NodeHandle& pnh, const std::string& prefix, const int default_numa_node);
+
+  /*!
+  * \brief Applies the tuning to the calling thread.
+  *
+  * Without explicit CPUs the thread is restricted to the CPUs of its NUMA node. Failures, e.g. missing permission
+  * for real-time scheduling, are logged and the remaining settings still applied.
+  * \return false if any setting could not be applied.
+  */
+  bool apply(const std::string& name);
+
+  /// Adds the settings to status, keys prefixed with name. Raises the level to a warning if they failed to apply.
+  void addToStatus(const std::string& name, diagnostic_msgs::DiagnosticStatus* status) const;
+
+  std::vector<int> cpus;  ///< Empty to leave the affinity alone.
+  int priority;           ///< SCHED_FIFO priority, 0 for the default scheduler.
+  int numa_node;          ///< Preferred node for allocations, -1 for the default policy.
+
+private:
+  enum State
+  {
+    NOT_APPLIED,
+    APPLIED,
+    FAILED
+  };
+  std::atomic<int> state_;  ///< Set by the tuned thread, read by the diagnostics.
+};
+
+/*!
+* \brief Parses a Linux CPU list like "0-3,8,10-11".
+*
+* \return false on a malformed list.
+*/
+bool parseCpuList(const std::string& list, std::vector<int>* cpus);
+
+/*!
+* \brief Returns the NUMA node of a PCI device, or -1 if unknown.
+*
+* device is either a network interface name, a PCI address like "0000:03:00.0" or a sysfs device directory.
+*/
+int getDeviceNumaNode(const std::string& device);
+
+/*!
+* \brief Counts the cycles of a periodic thread that overran their deadline.
+*
+* Written by the monitored thread only, read from any thread.
+*/
+class DeadlineMonitor
+{
+public:
+  DeadlineMonitor();
+
+  /// Records one cycle that took work_time seconds, it is missed if longer than deadline seconds.
+  void record(const double work_time, const double deadline);
+
+  /// Fills status, which is a warning if deadlines were missed since the previous call.
+  void getStatus(diagnostic_msgs::DiagnosticStatus* status);
+
+private:
+  std::atomic<uint64_t> cycles_;
+  std::atomic<uint64_t> missed_;
+  std::atomic<double> worst_time_;  ///< Longest cycle since the previous status.
+  std::atomic<double> last_deadline_;
+  uint64_t reported_missed_;  ///< Missed count at the previous status.
+};
+}  // namespace spinnaker_camera_driver
+#endif  // SPINNAKER_CAMERA_DRIVER_THREAD_TUNING_H
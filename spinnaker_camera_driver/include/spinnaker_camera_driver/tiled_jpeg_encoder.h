@@ -0,0 +1,108 @@
+/**
+Software License Agreement (BSD)
+
+\file      tiled_jpeg_encoder.h
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef SPINNAKER_CAMERA_DRIVER_TILED_JPEG_ENCODER_H
+#define SPINNAKER_CAMERA_DRIVER_TILED_JPEG_ENCODER_H
+
+#include "spinnaker_camera_driver/worker_pool.h"
+
+#include <ros/ros.h>
+#include <sensor_msgs/CompressedImage.h>
+#include <sensor_msgs/Image.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+//*******************************************
+// JPEG preview encoder that splits every
+// frame into horizontal strips and encodes
+// them in parallel. Each strip is a complete
+// restart interval sequence, so the strips
+// are joined with restart markers into one
+// baseline JPEG. Bayer frames are previewed
+// at half resolution, one pixel per 2x2 quad.
+//*******************************************
+
+namespace spinnaker_camera_driver
+{
+class TiledJpegEncoder
+{
+public:
+  /*!
+  * \brief Advertises image_preview/compressed and starts one worker per strip.
+  *
+  * \param strips Number of strips, and threads, a frame is split into.
+  * \param quality JPEG quality from 1 to 100.
+  * \param max_rate Maximum number of frames per second encoded, 0 encodes as many as the workers keep up with.
+  */
+  TiledJpegEncoder(ros::NodeHandle& nh, const size_t strips, const int quality, const double max_rate);
+  ~TiledJpegEncoder();
+
+  /*!
+  * \brief Starts encoding the image unless the previous frame is still being encoded or the rate cap is reached.
+  *
+  * The image is shared with the workers and must not be modified afterwards.
+  * \return false if the frame was skipped.
+  */
+  bool publish(const sensor_msgs::ImageConstPtr& image);
+
+  bool hasSubscribers() const
+  {
+    return pub_.getNumSubscribers() > 0;
+  }
+
+  size_t getSkippedFrames() const
+  {
+    return skipped_;
+  }
+
+  /*!
+  * \brief Encodes image into a single JPEG using the given number of strips, on the calling thread.
+  *
+  * \return false if the encoding is not supported.
+  */
+  static bool encode(const sensor_msgs::Image& image, const size_t strips, const int quality,
+                     sensor_msgs::CompressedImage* compressed);
+
+private:
+  struct Frame;
+
+  /// Encodes one strip, the worker finishing the last strip joins them and publishes the frame.
+  void encodeStripTask(const std::shared_ptr<Frame>& frame, const size_t strip);
+
+  ros::Publisher pub_;
+  size_t strips_;
+  int quality_;
+  ros::Duration min_period_;
+  ros::Time last_frame_;
+
+  std::atomic<bool> busy_;  ///< A frame is being encoded, set by publish() and cleared by the last strip.
+  std::atomic<size_t> skipped_;
+
+  std::unique_ptr<WorkerPool> pool_;  ///< Destroyed first so no strip runs on a partly destroyed encoder.
+};
+}  // namespace spinnaker_camera_driver
+#endif  // SPINNAKER_CAMERA_DRIVER_TILED_JPEG_ENCODER_H
@@ -0,0 +1,115 @@
+/**
+Software License Agreement (BSD)
+
+\file      tone_mapper.h
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef SPINNAKER_CAMERA_DRIVER_TONE_MAPPER_H
+#define SPINNAKER_CAMERA_DRIVER_TONE_MAPPER_H
+
+#include <ros/ros.h>
+#include <image_transport/image_transport.h>
+#include <sensor_msgs/Image.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//*******************************************
+// 8 bit stream of 16 bit captures for live
+// consumers. Every sample is mapped through
+// a lookup table built from a tone curve
+// over an input window, fixed or following
+// percentiles of the frame. The table is
+// applied with vector gathers and only
+// while image_8bit has subscribers.
+//*******************************************
+
+namespace spinnaker_camera_driver
+{
+class ToneMapper
+{
+public:
+  enum Curve
+  {
+    LINEAR,  ///< Straight line over the window.
+    GAMMA,   ///< Power law over the window, brightens the shadows for gamma > 1.
+    LOG      ///< Logarithmic over the window, for scenes of high dynamic range.
+  };
+
+  struct Parameters
+  {
+    Curve curve;
+    double min;              ///< Input value mapped to 0 unless auto_percentile is set.
+    double max;              ///< Input value mapped to 255 unless auto_percentile is set.
+    double gamma;            ///< Output is the normalized input to the power of 1 / gamma, for GAMMA.
+    double log_gain;         ///< Steepness of LOG, larger values lift the shadows more.
+    bool auto_percentile;    ///< Take the window from the percentiles of each frame.
+    double low_percentile;   ///< Percent of the samples at or below the bottom of the window.
+    double high_percentile;  ///< Percent of the samples at or below the top of the window.
+    double damping;          ///< Fraction of the change of the window applied per frame, between 0 and 1.
+    int subsample;           ///< Histogram every n-th row and column, pairs of them for Bayer images.
+  };
+
+  /// Advertises image_8bit.
+  ToneMapper(ros::NodeHandle& nh, const Parameters& parameters);
+
+  /// Parses "linear", "gamma" or "log". Returns false for any other name.
+  static bool parseCurve(const std::string& name, Curve* curve);
+
+  bool hasSubscribers() const
+  {
+    return pub_.getNumSubscribers() > 0;
+  }
+
+  /*!
+  * \brief Maps a 16 bit mono or Bayer image to 8 bit and publishes it, other images are skipped.
+  *
+  * Bayer images keep their pattern.
+  */
+  void publish(const sensor_msgs::Image& image);
+
+  /*!
+  * \brief Maps count samples through the table.
+  *
+  * \param lut 65536 entries followed by 3 bytes of padding read by the 32 bit gathers.
+  */
+  static void apply(const uint16_t* source, const size_t count, const uint8_t* lut, uint8_t* destination);
+
+private:
+  /// Moves the window towards the percentiles of the image, returns true if it moved enough to rebuild the table.
+  bool updateWindow(const sensor_msgs::Image& image);
+
+  void buildLut();
+
+  image_transport::ImageTransport it_;
+  image_transport::Publisher pub_;
+  Parameters parameters_;
+
+  bool window_valid_;  ///< The window was taken from a frame, it jumps to the first one.
+  double low_;         ///< Current window.
+  double high_;
+  double lut_low_;  ///< Window the table was built for.
+  double lut_high_;
+  std::vector<uint8_t> lut_;
+  std::vector<uint32_t> histogram_;  ///< Reused by updateWindow.
+};
+}  // namespace spinnaker_camera_driver
+#endif  // SPINNAKER_CAMERA_DRIVER_TONE_MAPPER_H
@@ -0,0 +1,107 @@
+/**
+Software License Agreement (BSD)
+
+\file      trigger_queue.h
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef SPINNAKER_CAMERA_DRIVER_TRIGGER_QUEUE_H
+#define SPINNAKER_CAMERA_DRIVER_TRIGGER_QUEUE_H
+
+#include <sensor_msgs/Image.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//*******************************************
+// Capture on demand with the software trigger.
+// Requested shots are queued and fired one at
+// a time, the next one as soon as the frame
+// of the previous arrived, so that every frame
+// belongs to exactly one shot.
+//*******************************************
+
+namespace spinnaker_camera_driver
+{
+class TriggerQueue
+{
+public:
+  /// fire executes the trigger and throws std::runtime_error if it fails.
+  explicit TriggerQueue(const std::function<void()>& fire);
+
+  /*!
+  * \brief Captures count frames and blocks until they arrived.
+  *
+  * \param timeout Seconds to wait for all frames.
+  * \param latencies Filled with the seconds from firing each trigger to its frame being grabbed.
+  * \param message Set to the reason on failure.
+  * \return false if the trigger failed or not all frames arrived in time, images holds those that did.
+  */
+  bool capture(const size_t count, const double timeout, std::vector<sensor_msgs::Image>* images,
+               std::vector<double>* latencies, std::string* message);
+
+  /// Queues count shots whose frames are only published like any other frame.
+  void queue(const size_t count);
+
+  /*!
+  * \brief Hands a grabbed frame to the shot in flight and fires the next one, called by the acquisition thread.
+  *
+  * Also call it with a NULL image after a grab timed out, a shot without a frame for longer than stale_timeout
+  * seconds is given up.
+  */
+  void frameGrabbed(const sensor_msgs::Image* image, const std::chrono::steady_clock::time_point grabbed,
+                    const double stale_timeout);
+
+  /// Drops every queued shot, e.g. when acquisition stops, waiting captures fail.
+  void clear(const std::string& reason);
+
+private:
+  struct Request
+  {
+    size_t remaining;
+    bool failed;
+    std::string message;
+    std::vector<sensor_msgs::Image> images;
+    std::vector<double> latencies;
+  };
+
+  struct Shot
+  {
+    std::shared_ptr<Request> request;  ///< NULL for queued shots and for captures that gave up.
+    bool fired;
+    std::chrono::steady_clock::time_point fired_at;
+  };
+
+  /// Fires the front shot if it is not in flight yet, failing requests whose trigger cannot be fired.
+  void fireNext();
+  void fail(const std::shared_ptr<Request>& request, const std::string& message);
+
+  std::function<void()> fire_;
+  std::mutex mutex_;
+  std::condition_variable done_cv_;
+  std::deque<Shot> shots_;  ///< The front one is in flight once fired.
+};
+}  // namespace spinnaker_camera_driver
+#endif  // SPINNAKER_CAMERA_DRIVER_TRIGGER_QUEUE_H
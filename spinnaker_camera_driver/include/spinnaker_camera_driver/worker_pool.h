@@ -0,0 +1,83 @@
+/**
+Software License Agreement (BSD)
+
+\file      worker_pool.h
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef SPINNAKER_CAMERA_DRIVER_WORKER_POOL_H
+#define SPINNAKER_CAMERA_DRIVER_WORKER_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//*******************************************
+// Fixed set of threads working through a
+// bounded FIFO of tasks. Submitting never
+// blocks, a full queue rejects the task so
+// the acquisition thread can drop the frame
+// instead of falling behind.
+//*******************************************
+
+namespace spinnaker_camera_driver
+{
+class WorkerPool
+{
+public:
+  /*!
+  * \brief Starts thread_count threads.
+  *
+  * \param queue_size Number of tasks that may wait for a thread, further submissions are rejected.
+  * \param name Used in log messages.
+  */
+  WorkerPool(const size_t thread_count, const size_t queue_size, const std::string& name);
+  /// Runs the tasks still queued, then joins the threads.
+  ~WorkerPool();
+
+  /*!
+  * \brief Queues task to be run by the next free thread.
+  *
+  * Tasks start in submission order.
+  * \return false if the queue is full and the task was not queued.
+  */
+  bool trySubmit(const std::function<void()>& task);
+
+  size_t getThreadCount() const
+  {
+    return threads_.size();
+  }
+
+private:
+  void run();
+
+  size_t queue_size_;
+  std::string name_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::function<void()> > tasks_;
+  bool shutdown_;
+  std::vector<std::thread> threads_;
+};
+}  // namespace spinnaker_camera_driver
+#endif  // SPINNAKER_CAMERA_DRIVER_WORKER_POOL_H
@@ -42,6 +42,10 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "spinnaker_camera_driver/SpinnakerCamera.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 #include <sstream>
 #include <typeinfo>
@@ -60,6 +64,69 @@ int settingFrameRate = 30;
 
 namespace spinnaker_camera_driver
 {
+// Control changes queued for the acquisition thread. A full queue falls back to waiting for the grab lock.
+static const size_t CONTROL_QUEUE_SIZE = 64;
+
+namespace
+{
+// GigE cameras may count their clock in ticks of GevTimestampTickFrequency instead of nanoseconds
+int64_t ticksToNanoseconds(Spinnaker::GenApi::INodeMap* node_map, const int64_t ticks)
+{
+  Spinnaker::GenApi::CIntegerPtr frequency = node_map->GetNode("GevTimestampTickFrequency");
+  if (IsAvailable(frequency) && IsReadable(frequency) && frequency->GetValue() > 0 &&
+      frequency->GetValue() != 1000000000)
+    return static_cast<int64_t>(ticks * (1e9 / frequency->GetValue()));
+  return ticks;
+}
+
+// Hands the device events of a camera to a callback, called on the event thread of the SDK.
+class DeviceEventHandler : public Spinnaker::DeviceEvent
+{
+public:
+  DeviceEventHandler(Spinnaker::GenApi::INodeMap* node_map, const SpinnakerCamera::DeviceEventCallback& callback)
+    : node_map_(node_map), callback_(callback)
+  {
+  }
+
+  void OnDeviceEvent(Spinnaker::GenICam::gcstring event_name)
+  {
+    // The camera sends the data of an event along with it, e.g. EventExposureEndFrameID
+    const std::string name(event_name.c_str());
+    uint64_t stamp = readEventData(name + "Timestamp");
+    try
+    {
+      if (stamp != 0)
+        stamp = static_cast<uint64_t>(ticksToNanoseconds(node_map_, static_cast<int64_t>(stamp)));
+    }
+    catch (const Spinnaker::Exception& e)
+    {
+      ROS_DEBUG("[SpinnakerCamera]: Failed to read GevTimestampTickFrequency: %s", e.what());
+      stamp = 0;
+    }
+    callback_(name, readEventData(name + "FrameID"), stamp);
+  }
+
+private:
+  uint64_t readEventData(const std::string& node_name) const
+  {
+    try
+    {
+      Spinnaker::GenApi::CIntegerPtr value = node_map_->GetNode(node_name.c_str());
+      if (IsAvailable(value) && IsReadable(value))
+        return static_cast<uint64_t>(value->GetValue());
+    }
+    catch (const Spinnaker::Exception& e)
+    {
+      ROS_DEBUG("[SpinnakerCamera]: Failed to read %s: %s", node_name.c_str(), e.what());
+    }
+    return 0;
+  }
+
+  Spinnaker::GenApi::INodeMap* node_map_;
+  SpinnakerCamera::DeviceEventCallback callback_;
+};
+}  // namespace
+
 SpinnakerCamera::SpinnakerCamera()
   : serial_(0)
   , system_(Spinnaker::System::GetInstance())
@@ -68,7 +135,28 @@ SpinnakerCamera::SpinnakerCamera()
                                    // an int
   , camera_(static_cast<int>(NULL))
   , captureRunning_(false)
+  , controls_(CONTROL_QUEUE_SIZE)
+  , auto_packet_size_(true)
+  , packet_size_(1400)
+  , packet_delay_(4000)
+  , cameras_per_nic_(0)
+  , is_gige_(false)
+  , link_speed_(0.0)
+  , frame_rate_limit_(0.0f)
+  , link_throughput_limit_(0)
+  , incomplete_frames_(0)
+  , frame_delivery_(DELIVER_ALL)
+  , drain_queue_(false)
+  , have_frame_id_(false)
+  , last_frame_id_(0)
+  , dropped_frames_(0)
+  , first_frame_id_(0)
+  , sequence_index_(-1)
+  , sequence_length_(0)
+  , user_buffer_count_(0)
+  , lock_user_buffers_(false)
 {
+  pending_controls_.reserve(CONTROL_QUEUE_SIZE);
   unsigned int num_cameras = camList_.GetSize();
   ROS_INFO_STREAM_ONCE("[SpinnakerCamera]: Number of cameras detected: " << num_cameras);
 }
@@ -87,29 +175,280 @@ void SpinnakerCamera::setNewConfiguration(const spinnaker_camera_driver::Spinnak
     SpinnakerCamera::connect();
   }
 
+  if (level < LEVEL_RECONFIGURE_STOP)
+  {
+    ControlRequest request;
+    request.type = ControlRequest::CONFIGURATION;
+    request.config = config;
+    request.value = 0.0f;
+    request.blue = 0.0f;
+    submitControl(request);
+    return;
+  }
+
   // Activate mutex to prevent us from grabbing images during this time
   std::lock_guard<std::mutex> scopedLock(mutex_);
+  // Queued changes are older than this configuration
+  applyPendingControls();
+
+  ROS_DEBUG("SpinnakerCamera::setNewConfiguration: Reconfigure Stop.");
+  bool capture_was_running = captureRunning_;
+  start();  // For some reason some params only work after aquisition has be started once.
+  stop();
+  camera_->setNewConfiguration(config, level);
+  if (capture_was_running)
+    start();
+}  // end setNewConfiguration
 
-  if (level >= LEVEL_RECONFIGURE_STOP)
+void SpinnakerCamera::setGain(const float& gain)
+{
+  ControlRequest request;
+  request.type = ControlRequest::GAIN;
+  request.value = gain;
+  request.blue = 0.0f;
+  submitControl(request);
+}
+
+void SpinnakerCamera::setExposureTime(const float exposure_time)
+{
+  ControlRequest request;
+  request.type = ControlRequest::EXPOSURE_TIME;
+  request.value = exposure_time;
+  request.blue = 0.0f;
+  submitControl(request);
+}
+
+void SpinnakerCamera::setWhiteBalance(const float red, const float blue)
+{
+  ControlRequest request;
+  request.type = ControlRequest::WHITE_BALANCE;
+  request.value = red;
+  request.blue = blue;
+  submitControl(request);
+}
+
+void SpinnakerCamera::submitControl(const ControlRequest& request)
+{
+  if (captureRunning_)
   {
-    ROS_DEBUG("SpinnakerCamera::setNewConfiguration: Reconfigure Stop.");
-    bool capture_was_running = captureRunning_;
-    start();  // For some reason some params only work after aquisition has be started once.
-    stop();
-    camera_->setNewConfiguration(config, level);
-    if (capture_was_running)
-      start();
+    if (controls_.tryPush(request))
+      return;
+    ROS_WARN_THROTTLE(10, "[SpinnakerCamera]: Control queue is full, waiting for the acquisition thread.");
   }
+
+  std::lock_guard<std::mutex> scopedLock(mutex_);
+  applyPendingControls();
+  applyControl(request);
+}
+
+void SpinnakerCamera::applyPendingControls()
+{
+  pending_controls_.clear();
+  ControlRequest request;
+  while (pending_controls_.size() < CONTROL_QUEUE_SIZE && controls_.tryPop(&request))
+    pending_controls_.push_back(std::move(request));
+
+  for (size_t i = 0; i < pending_controls_.size(); ++i)
+  {
+    // Every request carries the complete state of its type, so only the newest one matters
+    bool replaced = false;
+    for (size_t j = i + 1; j < pending_controls_.size() && !replaced; ++j)
+      replaced = pending_controls_[j].type == pending_controls_[i].type;
+    if (replaced)
+      continue;
+
+    try
+    {
+      applyControl(pending_controls_[i]);
+    }
+    catch (const std::runtime_error& e)
+    {
+      // Not the fault of the frame that is grabbed next, so do not fail grabImage
+      ROS_ERROR("%s", e.what());
+    }
+  }
+}
+
+void SpinnakerCamera::applyControl(const ControlRequest& request)
+{
+  if (!camera_)
+    return;
+
+  switch (request.type)
+  {
+    case ControlRequest::CONFIGURATION:
+      camera_->setNewConfiguration(request.config, LEVEL_RECONFIGURE_RUNNING);
+      break;
+    case ControlRequest::GAIN:
+      camera_->setGain(request.value);
+      break;
+    case ControlRequest::EXPOSURE_TIME:
+      camera_->setExposureTime(request.value);
+      break;
+    case ControlRequest::WHITE_BALANCE:
+      camera_->setBRWhiteBalance(request.value, request.blue);
+      break;
+  }
+}
+
+void SpinnakerCamera::setFrameRateLimit(const float limit)
+{
+  std::lock_guard<std::mutex> scopedLock(mutex_);
+  frame_rate_limit_ = limit;
+  if (camera_)
+    camera_->setFrameRateLimit(limit);
+}
+
+void SpinnakerCamera::setOutputEncoding(const std::string& encoding)
+{
+  std::lock_guard<std::mutex> scopedLock(mutex_);
+  if (encoding.empty())
+    converter_.reset();
   else
+    converter_.reset(new PixelConverter(encoding));
+}
+
+void SpinnakerCamera::setLinkThroughputLimit(const int limit)
+{
+  std::lock_guard<std::mutex> scopedLock(mutex_);
+  link_throughput_limit_ = limit;
+  if (!pCam_)
+    return;
+
+  try
   {
-    camera_->setNewConfiguration(config, level);
+    Spinnaker::GenApi::CIntegerPtr limit_ptr = node_map_->GetNode("DeviceLinkThroughputLimit");
+    if (limit > 0 && IsAvailable(limit_ptr) && IsReadable(limit_ptr))
+    {
+      const int increment = std::max<int>(1, limit_ptr->GetInc());
+      setProperty(node_map_, "DeviceLinkThroughputLimit", limit / increment * increment);
+    }
+    else
+    {
+      setMaxInt(node_map_, "DeviceLinkThroughputLimit");
+    }
   }
-}  // end setNewConfiguration
+  catch (const Spinnaker::Exception& e)
+  {
+    throw std::runtime_error("[SpinnakerCamera::setLinkThroughputLimit] Failed to set throughput limit: " +
+                             std::string(e.what()));
+  }
+}
 
-void SpinnakerCamera::setGain(const float& gain)
+void SpinnakerCamera::setPixelFormat(const std::string& format)
 {
+  std::lock_guard<std::mutex> scopedLock(mutex_);
+  pixel_format_ = format;
   if (camera_)
-    camera_->setGain(gain);
+    camera_->setPixelFormat(format);
+}
+
+void SpinnakerCamera::setSequence(const std::vector<Camera::SequencerSet>& sets)
+{
+  std::lock_guard<std::mutex> scopedLock(mutex_);
+  sequence_ = sets;
+  if (!camera_)
+    return;
+
+  // The sequencer can only be programmed while the camera is not streaming
+  const bool capture_was_running = captureRunning_;
+  stop();
+  try
+  {
+    camera_->setSequence(sets);
+  }
+  catch (const std::runtime_error&)
+  {
+    sequence_.clear();
+    if (capture_was_running)
+      start();
+    throw;
+  }
+  if (capture_was_running)
+    start();
+}
+
+bool SpinnakerCamera::getSequenceSet(uint32_t* index, uint32_t* length, Camera::SequencerSet* set) const
+{
+  if (sequence_index_ < 0)
+    return false;
+  *index = static_cast<uint32_t>(sequence_index_);
+  *length = sequence_length_;
+  *set = sequence_set_;
+  return true;
+}
+
+void SpinnakerCamera::countFrameId(const uint64_t frame_id)
+{
+  // Frame IDs start at 0, so whether a frame was seen since start() is tracked apart from the ID
+  if (!have_frame_id_)
+  {
+    first_frame_id_ = frame_id;
+    have_frame_id_ = true;
+  }
+  // Frames dropped by the stream or by draining leave gaps in the IDs
+  else if (frame_id > last_frame_id_ + 1)
+  {
+    dropped_frames_ += frame_id - last_frame_id_ - 1;
+    if (metrics_)
+      metrics_->frames_dropped += frame_id - last_frame_id_ - 1;
+  }
+  last_frame_id_ = frame_id;
+}
+
+int SpinnakerCamera::readSequenceIndex(Spinnaker::ImagePtr image_ptr, const uint64_t frame_id) const
+{
+  try
+  {
+    const int64_t index = image_ptr->GetChunkData().GetSequencerSetActive();
+    if (index >= 0 && index < static_cast<int64_t>(sequence_.size()))
+      return static_cast<int>(index);
+  }
+  catch (const Spinnaker::Exception& e)
+  {
+    ROS_WARN_ONCE("[SpinnakerCamera::grabImage]: No SequencerSetActive chunk (%s), counting frames instead.",
+                  e.what());
+  }
+  // The sequence starts over with set 0 with every acquisition and advances with every frame, dropped or not
+  return static_cast<int>((frame_id - first_frame_id_) % sequence_.size());
+}
+
+bool SpinnakerCamera::getClockOffset(int64_t* offset)
+{
+  std::lock_guard<std::mutex> scopedLock(mutex_);
+  if (!pCam_)
+    return false;
+
+  try
+  {
+    // USB3 Vision and newer GigE firmware name the latch the SFNC way, older GigE cameras the GEV way
+    Spinnaker::GenApi::CCommandPtr latch = node_map_->GetNode("TimestampLatch");
+    Spinnaker::GenApi::CIntegerPtr value = node_map_->GetNode("TimestampLatchValue");
+    if (!IsAvailable(latch) || !IsWritable(latch))
+    {
+      latch = node_map_->GetNode("GevTimestampControlLatch");
+      value = node_map_->GetNode("GevTimestampValue");
+    }
+    if (!IsAvailable(latch) || !IsWritable(latch) || !IsAvailable(value) || !IsReadable(value))
+      return false;
+
+    const std::chrono::steady_clock::time_point before = std::chrono::steady_clock::now();
+    latch->Execute();
+    const std::chrono::steady_clock::time_point after = std::chrono::steady_clock::now();
+    const int64_t camera_time = ticksToNanoseconds(node_map_, value->GetValue());
+
+    // The latch happened somewhere between the two host readings
+    const int64_t host_time =
+        std::chrono::duration_cast<std::chrono::nanoseconds>((before + (after - before) / 2).time_since_epoch())
+            .count();
+    *offset = host_time - camera_time;
+    return true;
+  }
+  catch (const Spinnaker::Exception& e)
+  {
+    ROS_WARN("[SpinnakerCamera::getClockOffset] Failed to latch the camera clock: %s", e.what());
+    return false;
+  }
 }
 
 int SpinnakerCamera::getHeightMax()
@@ -252,9 +591,20 @@ void SpinnakerCamera::connect()
           {
             if (device_speed_ptr->GetCurrentEntry() != device_speed_ptr->GetEntryByName("SuperSpeed"))
               ROS_ERROR_STREAM("[SpinnakerCamera::connect]: U3V Device not running at Super-Speed. Check Cables! ");
+
+            // Signalling rate without the line coding overhead
+            const std::string speed(device_speed_ptr->ToString().c_str());
+            if (speed == "SuperSpeed")
+              link_speed_ = 5e9 * 8 / 10 / 8;
+            else if (speed == "HighSpeed")
+              link_speed_ = 480e6 / 8;
+            else if (speed == "FullSpeed")
+              link_speed_ = 12e6 / 8;
+            else
+              link_speed_ = 0.0;
           }
         }
-        // TODO(mhosmar): - check if interface is GigE and connect to GigE cam
+        is_gige_ = device_type_ptr->GetCurrentEntry() == device_type_ptr->GetEntryByName("GEV");
       }
     }
     catch (const Spinnaker::Exception& e)
@@ -285,9 +635,29 @@ void SpinnakerCamera::connect()
         camera_.reset(new Camera(node_map_));
         ROS_WARN("SpinnakerCamera::connect: Could not detect camera model name.");
       }
+      if (is_gige_)
+        configureGigE();
+
+      camera_->setFrameRateLimit(frame_rate_limit_);
+      camera_->setPixelFormat(pixel_format_);
+      if (!sequence_.empty())
+        camera_->setSequence(sequence_);
+      // Camera::init opened the throughput limit fully, restore a limit set before the reconnect
+      Spinnaker::GenApi::CIntegerPtr limit_ptr = node_map_->GetNode("DeviceLinkThroughputLimit");
+      if (link_throughput_limit_ > 0 && IsAvailable(limit_ptr) && IsReadable(limit_ptr))
+      {
+        const int increment = std::max<int>(1, limit_ptr->GetInc());
+        setProperty(node_map_, "DeviceLinkThroughputLimit", link_throughput_limit_ / increment * increment);
+      }
 
       // Configure chunk data - Enable Metadata
       // SpinnakerCamera::ConfigureChunkData(*node_map_);
+
+      if (!device_events_.empty())
+        enableDeviceEvents();
+
+      std::lock_guard<std::mutex> triggerLock(trigger_mutex_);
+      trigger_ptr_ = node_map_->GetNode("TriggerSoftware");
     }
     catch (const Spinnaker::Exception& e)
     {
@@ -310,6 +680,26 @@ void SpinnakerCamera::connect()
   */
 }
 
+void SpinnakerCamera::enableDeviceEvents()
+{
+  size_t enabled = 0;
+  for (const std::string& event : device_events_)
+  {
+    // EventSelector picks the event that EventNotification switches
+    if (setProperty(node_map_, "EventSelector", event) &&
+        setProperty(node_map_, "EventNotification", std::string("On")))
+      ++enabled;
+    else
+      ROS_WARN("[SpinnakerCamera::enableDeviceEvents]: Camera %u does not send %s events.", serial_, event.c_str());
+  }
+  if (enabled == 0)
+    return;
+
+  device_event_handler_ = std::make_shared<DeviceEventHandler>(node_map_, device_event_callback_);
+  pCam_->RegisterEvent(*device_event_handler_);
+  ROS_INFO("[SpinnakerCamera::enableDeviceEvents]: Enabled %zu device events.", enabled);
+}
+
 void SpinnakerCamera::disconnect()
 {
   std::lock_guard<std::mutex> scopedLock(mutex_);
@@ -319,6 +709,15 @@ void SpinnakerCamera::disconnect()
     // Check if camera is connected
     if (pCam_)
     {
+      {
+        std::lock_guard<std::mutex> triggerLock(trigger_mutex_);
+        trigger_ptr_ = Spinnaker::GenApi::CCommandPtr();
+      }
+      if (device_event_handler_)
+      {
+        pCam_->UnregisterEvent(*device_event_handler_);
+        device_event_handler_.reset();
+      }
       pCam_->DeInit();
       pCam_ = static_cast<int>(NULL);
       camList_.RemoveBySerial(std::to_string(serial_));
@@ -340,6 +739,9 @@ void SpinnakerCamera::start()
     // Check if camera is connected
     if (pCam_ && !captureRunning_)
     {
+      configureBufferHandling();
+      configureUserBuffers();
+
       // Start capturing images
       pCam_->BeginAcquisition();
       captureRunning_ = true;
@@ -351,6 +753,91 @@ void SpinnakerCamera::start()
   }
 }
 
+void SpinnakerCamera::fireSoftwareTrigger()
+{
+  std::lock_guard<std::mutex> triggerLock(trigger_mutex_);
+  if (!trigger_ptr_ || !IsAvailable(trigger_ptr_) || !IsWritable(trigger_ptr_))
+    throw std::runtime_error("[SpinnakerCamera::fireSoftwareTrigger] Software trigger is not available.");
+  try
+  {
+    trigger_ptr_->Execute();
+  }
+  catch (const Spinnaker::Exception& e)
+  {
+    throw std::runtime_error("[SpinnakerCamera::fireSoftwareTrigger] Failed to fire the trigger: " +
+                             std::string(e.what()));
+  }
+}
+
+void SpinnakerCamera::setFrameDelivery(const FrameDelivery delivery)
+{
+  std::lock_guard<std::mutex> scopedLock(mutex_);
+  frame_delivery_ = delivery;
+}
+
+void SpinnakerCamera::configureBufferHandling()
+{
+  // Frame IDs restart with the acquisition
+  have_frame_id_ = false;
+  drain_queue_ = false;
+
+  Spinnaker::GenApi::INodeMap& stream_node_map = pCam_->GetTLStreamNodeMap();
+  Spinnaker::GenApi::CEnumerationPtr handling_ptr = stream_node_map.GetNode("StreamBufferHandlingMode");
+  const char* mode = frame_delivery_ == DELIVER_NEWEST ? "NewestOnly" : "OldestFirst";
+  if (IsAvailable(handling_ptr) && IsWritable(handling_ptr))
+  {
+    Spinnaker::GenApi::CEnumEntryPtr mode_ptr = handling_ptr->GetEntryByName(mode);
+    if (IsAvailable(mode_ptr) && IsReadable(mode_ptr))
+    {
+      handling_ptr->SetIntValue(mode_ptr->GetValue());
+      return;
+    }
+  }
+  if (frame_delivery_ == DELIVER_NEWEST)
+  {
+    ROS_WARN_ONCE("[SpinnakerCamera::start]: NewestOnly buffer handling is not available, draining the queue "
+                  "instead.");
+    drain_queue_ = true;
+  }
+}
+
+void SpinnakerCamera::setUserBuffers(const size_t count, const bool lock)
+{
+  std::lock_guard<std::mutex> scopedLock(mutex_);
+  user_buffer_count_ = count;
+  lock_user_buffers_ = lock;
+}
+
+std::shared_ptr<const HugePageBuffer> SpinnakerCamera::getUserBuffers()
+{
+  std::lock_guard<std::mutex> scopedLock(mutex_);
+  return user_buffers_;
+}
+
+void SpinnakerCamera::configureUserBuffers()
+{
+  if (user_buffer_count_ == 0)
+    return;
+#if SPINNAKER_USER_BUFFERS
+  Spinnaker::GenApi::CIntegerPtr payload_ptr = node_map_->GetNode("PayloadSize");
+  if (!IsAvailable(payload_ptr) || !IsReadable(payload_ptr))
+  {
+    ROS_WARN_ONCE("[SpinnakerCamera::start]: PayloadSize is not available, the SDK allocates the buffers.");
+    return;
+  }
+  const size_t size = static_cast<size_t>(payload_ptr->GetValue()) * user_buffer_count_;
+  if (!user_buffers_ || user_buffers_->size() < size)
+  {
+    // Stopped, the SDK does not touch the previous buffers until they are replaced below
+    user_buffers_.reset();
+    user_buffers_ = std::make_shared<HugePageBuffer>(size, lock_user_buffers_);
+  }
+  pCam_->SetUserBuffers(user_buffers_->data(), user_buffers_->size());
+#else
+  ROS_WARN_ONCE("[SpinnakerCamera::start]: Built without SPINNAKER_USER_BUFFERS, the SDK allocates the buffers.");
+#endif
+}
+
 void SpinnakerCamera::stop()
 {
   if (pCam_ && captureRunning_)
@@ -368,6 +855,89 @@ void SpinnakerCamera::stop()
   }
 }
 
+std::string SpinnakerCamera::getImageEncoding(const size_t bits_per_pixel)
+{
+  std::string imageEncoding = sensor_msgs::image_encodings::MONO8;
+
+  Spinnaker::GenApi::CEnumerationPtr color_filter_ptr =
+      static_cast<Spinnaker::GenApi::CEnumerationPtr>(node_map_->GetNode("PixelColorFilter"));
+
+  Spinnaker::GenICam::gcstring color_filter_str = color_filter_ptr->ToString();
+  Spinnaker::GenICam::gcstring bayer_rg_str = "BayerRG";
+  Spinnaker::GenICam::gcstring bayer_gr_str = "BayerGR";
+  Spinnaker::GenICam::gcstring bayer_gb_str = "BayerGB";
+  Spinnaker::GenICam::gcstring bayer_bg_str = "BayerBG";
+
+  // if(isColor_ && bayer_format != NONE)
+  if (color_filter_ptr->GetCurrentEntry() != color_filter_ptr->GetEntryByName("None"))
+  {
+    if (bits_per_pixel == 16)
+    {
+      // 16 Bits per Pixel
+      if (color_filter_str.compare(bayer_rg_str) == 0)
+      {
+        imageEncoding = sensor_msgs::image_encodings::BAYER_RGGB16;
+      }
+      else if (color_filter_str.compare(bayer_gr_str) == 0)
+      {
+        imageEncoding = sensor_msgs::image_encodings::BAYER_GRBG16;
+      }
+      else if (color_filter_str.compare(bayer_gb_str) == 0)
+      {
+        imageEncoding = sensor_msgs::image_encodings::BAYER_GBRG16;
+      }
+      else if (color_filter_str.compare(bayer_bg_str) == 0)
+      {
+        imageEncoding = sensor_msgs::image_encodings::BAYER_BGGR16;
+      }
+      else
+      {
+        throw std::runtime_error("[SpinnakerCamera::getImageEncoding] Bayer format not recognized for 16-bit format.");
+      }
+    }
+    else
+    {
+      // 8 Bits per Pixel
+      if (color_filter_str.compare(bayer_rg_str) == 0)
+      {
+        imageEncoding = sensor_msgs::image_encodings::BAYER_RGGB8;
+      }
+      else if (color_filter_str.compare(bayer_gr_str) == 0)
+      {
+        imageEncoding = sensor_msgs::image_encodings::BAYER_GRBG8;
+      }
+      else if (color_filter_str.compare(bayer_gb_str) == 0)
+      {
+        imageEncoding = sensor_msgs::image_encodings::BAYER_GBRG8;
+      }
+      else if (color_filter_str.compare(bayer_bg_str) == 0)
+      {
+        imageEncoding = sensor_msgs::image_encodings::BAYER_BGGR8;
+      }
+      else
+      {
+        throw std::runtime_error("[SpinnakerCamera::getImageEncoding] Bayer format not recognized for 8-bit format.");
+      }
+    }
+  }
+  else  // Mono camera or in pixel binned mode.
+  {
+    if (bits_per_pixel == 16)
+    {
+      imageEncoding = sensor_msgs::image_encodings::MONO16;
+    }
+    else if (bits_per_pixel == 24)
+    {
+      imageEncoding = sensor_msgs::image_encodings::RGB8;
+    }
+    else
+    {
+      imageEncoding = sensor_msgs::image_encodings::MONO8;
+    }
+  }
+  return imageEncoding;
+}
+
 void SpinnakerCamera::grabImage(sensor_msgs::Image* image, const std::string& frame_id)
 {
   std::lock_guard<std::mutex> scopedLock(mutex_);
@@ -375,169 +945,117 @@ void SpinnakerCamera::grabImage(sensor_msgs::Image* image, const std::string& fr
   // Check if Camera is connected and Running
   if (pCam_ && captureRunning_)
   {
+    // Apply control changes between frames, this is the only place they wait for while streaming
+    applyPendingControls();
+
     // Handle "Image Retrieval" Exception
     try
     {
+      const std::chrono::steady_clock::time_point retrieve_start = std::chrono::steady_clock::now();
       Spinnaker::ImagePtr image_ptr = pCam_->GetNextImage(timeout_);
+
+      // Skip to the newest frame already received, the older ones are returned to the stream right away
+      while (drain_queue_)
+      {
+        Spinnaker::ImagePtr newer_ptr;
+        try
+        {
+          newer_ptr = pCam_->GetNextImage(0);
+        }
+        catch (const Spinnaker::Exception&)
+        {
+          break;
+        }
+        image_ptr->Release();
+        image_ptr = newer_ptr;
+      }
+
+      const uint64_t frame_id = image_ptr->GetFrameID();
+      countFrameId(frame_id);
+
+      // Tag the frame with the sequencer set it was exposed with
+      sequence_index_ = sequence_.empty() ? -1 : readSequenceIndex(image_ptr, frame_id);
+      if (sequence_index_ >= 0)
+      {
+        sequence_length_ = static_cast<uint32_t>(sequence_.size());
+        sequence_set_ = sequence_[sequence_index_];
+      }
+
+      const std::chrono::steady_clock::time_point convert_start = std::chrono::steady_clock::now();
+      if (metrics_)
+      {
+        metrics_->recordStage(CaptureMetrics::STAGE_RETRIEVE,
+                              std::chrono::duration<double>(convert_start - retrieve_start).count());
+        ++metrics_->frames_grabbed;
+        metrics_->bytes += image_ptr->GetImageSize();
+        if (image_ptr->IsIncomplete())
+          ++metrics_->frames_incomplete;
+      }
       //std::string format(image_ptr->GetPixelFormatName());
       //std::printf("\033[100m format: %s \n", format.c_str());
 
       //if (image_ptr->IsIncomplete())
     
+      if (image_ptr->IsIncomplete())
+        ++incomplete_frames_;
       if (image_ptr->IsIncomplete() && enableFrameChecking)
       {
+        image_ptr->Release();
         throw std::runtime_error("[SpinnakerCamera::grabImage] Image received from camera " + std::to_string(serial_) + " is incomplete.");
       }
       else
       {
         // Set Image Time Stamp
-        image->header.stamp.sec = image_ptr->GetTimeStamp() * 1e-9;
-        image->header.stamp.nsec = image_ptr->GetTimeStamp();
+        image->header.stamp.fromNSec(image_ptr->GetTimeStamp());
 
         // Check the bits per pixel.
         size_t bitsPerPixel = image_ptr->GetBitsPerPixel();
 
-        // --------------------------------------------------
-        // Set the image encoding
-        std::string imageEncoding = sensor_msgs::image_encodings::MONO8;
-
-        Spinnaker::GenApi::CEnumerationPtr color_filter_ptr =
-            static_cast<Spinnaker::GenApi::CEnumerationPtr>(node_map_->GetNode("PixelColorFilter"));
-
-        Spinnaker::GenICam::gcstring color_filter_str = color_filter_ptr->ToString();
-        Spinnaker::GenICam::gcstring bayer_rg_str = "BayerRG";
-        Spinnaker::GenICam::gcstring bayer_gr_str = "BayerGR";
-        Spinnaker::GenICam::gcstring bayer_gb_str = "BayerGB";
-        Spinnaker::GenICam::gcstring bayer_bg_str = "BayerBG";
-
-        // if(isColor_ && bayer_format != NONE)
-        if (color_filter_ptr->GetCurrentEntry() != color_filter_ptr->GetEntryByName("None"))
-        {
-          if (bitsPerPixel == 16)
-          {
-            // 16 Bits per Pixel
-            if (color_filter_str.compare(bayer_rg_str) == 0)
-            {
-              imageEncoding = sensor_msgs::image_encodings::BAYER_RGGB16;
-            }
-            else if (color_filter_str.compare(bayer_gr_str) == 0)
-            {
-              imageEncoding = sensor_msgs::image_encodings::BAYER_GRBG16;
-            }
-            else if (color_filter_str.compare(bayer_gb_str) == 0)
-            {
-              imageEncoding = sensor_msgs::image_encodings::BAYER_GBRG16;
-            }
-            else if (color_filter_str.compare(bayer_bg_str) == 0)
-            {
-              imageEncoding = sensor_msgs::image_encodings::BAYER_BGGR16;
-            }
-            else
-            {
-              throw std::runtime_error("[SpinnakerCamera::grabImage] Bayer format not recognized for 16-bit format.");
-            }
-          }
-          else
-          {
-            // 8 Bits per Pixel
-            if (color_filter_str.compare(bayer_rg_str) == 0)
-            {
-              imageEncoding = sensor_msgs::image_encodings::BAYER_RGGB8;        //BAYER_RGGB8;//sensor_msgs::image_encodings::BAYER_RGGB8
-		//ROS_INFO("Image ENCODINGS: BAYER_RGGB8");
-            }
-            else if (color_filter_str.compare(bayer_gr_str) == 0)
-            {
-              imageEncoding = sensor_msgs::image_encodings::BAYER_GRBG8;
-            }
-            else if (color_filter_str.compare(bayer_gb_str) == 0)
-            {
-              imageEncoding = sensor_msgs::image_encodings::BAYER_GBRG8;
-            }
-            else if (color_filter_str.compare(bayer_bg_str) == 0)
-            {
-              imageEncoding = sensor_msgs::image_encodings::BAYER_BGGR8;
-            }
-            else
-            {
-              throw std::runtime_error("[SpinnakerCamera::grabImage] Bayer format not recognized for 8-bit format.");
-            }
-          }
-        }
-        else  // Mono camera or in pixel binned mode.
-        {
-          if (bitsPerPixel == 16)
-          {
-            imageEncoding = sensor_msgs::image_encodings::MONO16;
-          }
-          else if (bitsPerPixel == 24)
-          {
-            imageEncoding = sensor_msgs::image_encodings::RGB8;
-          }
-          else
-          {
-            imageEncoding = sensor_msgs::image_encodings::MONO8;
-          }
-        }
+        const std::string imageEncoding = getImageEncoding(bitsPerPixel);
 
         int width = image_ptr->GetWidth();
         int height = image_ptr->GetHeight();
         int stride = image_ptr->GetStride();
 
         //ROS_INFO("\033[93m wxh: (%d, %d), stride: %d \n", width, height, stride);
-        fillImage(*image, imageEncoding, height, width, stride, image_ptr->GetData());
-
-//TRY CV_COPY
-/*
-    "mono8"
-    "bgr8"
-    "bgra8"
-    "rgb8"
-    "rgba8"
-    "mono16"
-*/
-
-//https://answers.ros.org/question/225782/convert-cv_bridge-image-to-cvmat-image/
-/*   cv_bridge::CvImagePtr cv_img_raw = cv_bridge::toCvCopy(*image);
-     double min = 0;
-     double max = 1000;
-	cv::Mat img_scaled_8u;
-	cv::Mat img_out;
-	cv::Mat(cv_img_raw->image).convertTo(img_scaled_8u, CV_8UC3, 255. / (max - min));
-	//cv::cvtColor(img_scaled_8u, img_out, CV_GRAY2RGB);
-cv::imshow("img_scaled_8u", img_scaled_8u);
-cv::waitKey(1);
-*/
-/*
-	if (color_filter_str.compare(bayer_rg_str) == 0)
-	{
-		ROS_INFO("Image Byer_RG8 conversion: Start -- IN img enc: %s", image->encoding );
-
-		//try to convert again
-		cv_bridge::CvImagePtr cv_ptr;
-		cv_ptr = cv_bridge::toCvCopy(*image, sensor_msgs::image_encodings::RGB8);
-		//NOT: BGR8, RGB8
-
-		ROS_INFO("Image Byer_RG8 conversion: Convert to ... finished!");
+        if (!converter_ || !converter_->convert(std::string(image_ptr->GetPixelFormatName().c_str()),
+                                                static_cast<const uint8_t*>(image_ptr->GetData()), width, height,
+                                                stride, image))
+        {
+          if (converter_)
+            ROS_WARN_ONCE("[SpinnakerCamera::grabImage] No conversion from %s to %s, publishing %s.",
+                          image_ptr->GetPixelFormatName().c_str(), converter_->getEncoding().c_str(),
+                          imageEncoding.c_str());
+          fillImage(*image, imageEncoding, height, width, stride, image_ptr->GetData());
+        }
 
-		//copy back to img
-		cv_ptr->toImageMsg(*image);
-		ROS_INFO("Image Byer_RG8 conversion: Copy back to *image finished!");
+        // Keep a copy of the raw frame for event-triggered dumps
+        if (frame_ring_)
+        {
+          frame_ring_->push(static_cast<const uint8_t*>(image_ptr->GetData()), width, height, stride, imageEncoding,
+                            ros::Time::now());
+        }
 
-		//CONVERSION RGB - XXX
-		cv_bridge::CvImagePtr cv_ptr2;
-		cv_ptr2 = cv_bridge::toCvCopy(*image, sensor_msgs::image_encodings::BGR8);
-
-		//copy back to img
-		cv_ptr2->toImageMsg(*image);
-		ROS_INFO("Image Byer_RG8 conversion: Second CONV finished!");
-	}
-*/
+        // Back to the stream, with user buffers the acquisition stalls once all of them are held
+        image_ptr->Release();
 
         image->header.frame_id = frame_id;
+
+        if (metrics_)
+          metrics_->recordStage(CaptureMetrics::STAGE_CONVERT,
+                                std::chrono::duration<double>(std::chrono::steady_clock::now() - convert_start).count());
       }  // end else
     }
     catch (const Spinnaker::Exception& e)
     {
+      // No frame within the timeout is expected e.g. while waiting for a trigger, it does not need a reconnect
+      if (e.GetError() == Spinnaker::SPINNAKER_ERR_TIMEOUT)
+      {
+        if (metrics_)
+          ++metrics_->timeouts;
+        throw CameraTimeoutException("[SpinnakerCamera::grabImage] No image within " + std::to_string(timeout_) +
+                                     " ms: " + std::string(e.what()));
+      }
       throw std::runtime_error("[SpinnakerCamera::grabImage] Failed to retrieve buffer with error: " +
                                std::string(e.what()));
     }
@@ -553,6 +1071,81 @@ cv::waitKey(1);
   }
 }  // end grabImage
 
+uint32_t SpinnakerCamera::grabBurst(BurstCapture* burst, const uint32_t frame_count)
+{
+  std::lock_guard<std::mutex> scopedLock(mutex_);
+
+  if (!pCam_)
+    throw std::runtime_error("[SpinnakerCamera::grabBurst] Not connected to the camera.");
+  if (!captureRunning_)
+    throw CameraNotRunningException("[SpinnakerCamera::grabBurst] Camera is currently not running.  Please start "
+                                    "capturing frames first.");
+
+  // Controls are applied between bursts only, so that all frames of a burst have the same settings
+  applyPendingControls();
+
+  uint32_t received = 0;
+  bool buffered = false;
+  size_t frame_size = 0;
+  try
+  {
+    for (; received < frame_count; ++received)
+    {
+      Spinnaker::ImagePtr image_ptr;
+      try
+      {
+        image_ptr = pCam_->GetNextImage(timeout_);
+      }
+      catch (const Spinnaker::Exception& e)
+      {
+        if (e.GetError() != Spinnaker::SPINNAKER_ERR_TIMEOUT)
+          throw;
+        if (metrics_)
+          ++metrics_->timeouts;
+        // Waiting for the trigger is no error, the camera sending fewer frames than the burst length is
+        if (received == 0)
+          throw CameraTimeoutException("[SpinnakerCamera::grabBurst] No burst within " + std::to_string(timeout_) +
+                                       " ms: " + std::string(e.what()));
+        ROS_WARN("[SpinnakerCamera::grabBurst] Burst ended after %u of %u frames.", received, frame_count);
+        break;
+      }
+
+      const uint64_t frame_id = image_ptr->GetFrameID();
+      countFrameId(frame_id);
+
+      if (metrics_)
+      {
+        ++metrics_->frames_grabbed;
+        metrics_->bytes += image_ptr->GetImageSize();
+        if (image_ptr->IsIncomplete())
+          ++metrics_->frames_incomplete;
+      }
+      if (image_ptr->IsIncomplete())
+        ++incomplete_frames_;
+
+      // Only copied, the frames are converted to messages by the burst thread once the burst is drained
+      if (received == 0)
+      {
+        frame_size = image_ptr->GetStride() * image_ptr->GetHeight();
+        buffered = burst->begin(frame_count, image_ptr->GetWidth(), image_ptr->GetHeight(), image_ptr->GetStride(),
+                                getImageEncoding(image_ptr->GetBitsPerPixel()));
+      }
+      if (buffered && image_ptr->GetStride() * image_ptr->GetHeight() == frame_size)
+      {
+        std::memcpy(burst->nextFrame(), image_ptr->GetData(), frame_size);
+        burst->frameReceived(BurstCapture::FrameInfo{ image_ptr->GetTimeStamp(), image_ptr->IsIncomplete() });
+      }
+      image_ptr->Release();
+    }
+  }
+  catch (const Spinnaker::Exception& e)
+  {
+    throw std::runtime_error("[SpinnakerCamera::grabBurst] Failed to retrieve buffer with error: " +
+                             std::string(e.what()));
+  }
+  return received;
+}
+
 void SpinnakerCamera::setTimeout(const double& timeout)
 {
   timeout_ = static_cast<uint64_t>(std::round(timeout * 1000));
@@ -562,6 +1155,109 @@ void SpinnakerCamera::setDesiredCamera(const uint32_t& id)
   serial_ = id;
 }
 
+void SpinnakerCamera::setGigEParameters(const bool auto_packet_size, const unsigned int packet_size,
+                                        const unsigned int packet_delay, const unsigned int cameras_per_nic)
+{
+  auto_packet_size_ = auto_packet_size;
+  packet_size_ = packet_size;
+  packet_delay_ = packet_delay;
+  cameras_per_nic_ = cameras_per_nic;
+}
+
+void SpinnakerCamera::configureGigE()
+{
+  // Ethernet, IP, UDP and GVSP headers and the Ethernet preamble and gap that come with every stream packet.
+  static const double PACKET_OVERHEAD = 78.0;
+
+  unsigned int packet_size = packet_size_;
+  if (auto_packet_size_)
+  {
+    // Sends test packets of decreasing size to find the largest one that arrives unfragmented.
+    packet_size = pCam_->DiscoverMaxPacketSize();
+    ROS_INFO("[SpinnakerCamera::configureGigE]: Discovered packet size %u.", packet_size);
+  }
+
+  Spinnaker::GenApi::CIntegerPtr link_speed_ptr = node_map_->GetNode("GevLinkSpeed");
+  const double link_bits =
+      IsAvailable(link_speed_ptr) && IsReadable(link_speed_ptr) ? link_speed_ptr->GetValue() * 1e6 : 1e9;
+  link_speed_ = link_bits / 8;
+
+  unsigned int packet_delay = packet_delay_;
+  if (cameras_per_nic_ > 0)
+  {
+    // Leave room on the wire for one packet of every other camera between two of our packets.
+    Spinnaker::GenApi::CIntegerPtr tick_frequency_ptr = node_map_->GetNode("GevTimestampTickFrequency");
+    const double tick_frequency = IsAvailable(tick_frequency_ptr) && IsReadable(tick_frequency_ptr) ?
+                                      static_cast<double>(tick_frequency_ptr->GetValue()) :
+                                      1e9;
+    const double packet_time = (packet_size + PACKET_OVERHEAD) * 8 / link_bits;
+    packet_delay = static_cast<unsigned int>(std::round((cameras_per_nic_ - 1) * packet_time * tick_frequency));
+    ROS_INFO("[SpinnakerCamera::configureGigE]: Packet delay of %u ticks for %u cameras at %.0f Mbit/s.", packet_delay,
+             cameras_per_nic_, link_bits * 1e-6);
+  }
+  camera_->setGigEParameters(packet_size, packet_delay);
+
+  // Let the host ask for packets lost on the way instead of dropping the whole frame.
+  Spinnaker::GenApi::INodeMap& stream_node_map = pCam_->GetTLStreamNodeMap();
+  Spinnaker::GenApi::CBooleanPtr resend_ptr = stream_node_map.GetNode("StreamPacketResendEnable");
+  Spinnaker::GenApi::CEnumerationPtr resend_mode_ptr = stream_node_map.GetNode("GevPacketResendMode");
+  if (IsAvailable(resend_ptr) && IsWritable(resend_ptr))
+  {
+    resend_ptr->SetValue(true);
+  }
+  else if (IsAvailable(resend_mode_ptr) && IsWritable(resend_mode_ptr))
+  {
+    // Name of the node before Spinnaker 2
+    Spinnaker::GenApi::CEnumEntryPtr resend_on_ptr = resend_mode_ptr->GetEntryByName("On");
+    if (IsAvailable(resend_on_ptr) && IsReadable(resend_on_ptr))
+      resend_mode_ptr->SetIntValue(resend_on_ptr->GetValue());
+  }
+  else
+  {
+    ROS_WARN("[SpinnakerCamera::configureGigE]: Packet resend is not available.");
+  }
+}
+
+bool SpinnakerCamera::getStreamStatistics(std::vector<std::pair<std::string, int64_t> >* statistics)
+{
+  // Spinnaker 2 names first, then the GigE specific names of earlier versions.
+  static const char* const COUNTERS[] = { "StreamReceivedFrameCount",
+                                          "StreamLostFrameCount",
+                                          "StreamDroppedFrameCount",
+                                          "StreamIncompleteFrameCount",
+                                          "StreamReceivedPacketCount",
+                                          "StreamMissedPacketCount",
+                                          "StreamPacketResendRequestCount",
+                                          "StreamPacketResendReceivedPacketCount",
+                                          "GevTotalPacketCount",
+                                          "GevFailedPacketCount",
+                                          "GevResendPacketCount",
+                                          "GevResendRequestCount" };
+
+  statistics->clear();
+  std::lock_guard<std::mutex> scopedLock(mutex_);
+  if (!pCam_)
+    return true;
+
+  try
+  {
+    Spinnaker::GenApi::INodeMap& stream_node_map = pCam_->GetTLStreamNodeMap();
+    for (const char* counter : COUNTERS)
+    {
+      Spinnaker::GenApi::CIntegerPtr counter_ptr = stream_node_map.GetNode(counter);
+      if (IsAvailable(counter_ptr) && IsReadable(counter_ptr))
+        statistics->push_back(std::make_pair(std::string(counter), static_cast<int64_t>(counter_ptr->GetValue())));
+    }
+  }
+  catch (const Spinnaker::Exception& e)
+  {
+    ROS_WARN_THROTTLE(10, "[SpinnakerCamera::getStreamStatistics] Failed to read stream counters: %s", e.what());
+    statistics->clear();
+    return false;
+  }
+  return true;
+}
+
 void SpinnakerCamera::ConfigureChunkData(const Spinnaker::GenApi::INodeMap& nodeMap)
 {
   ROS_INFO_STREAM("*** CONFIGURING CHUNK DATA ***");
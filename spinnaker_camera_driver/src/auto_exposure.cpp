@@ -0,0 +1,415 @@
+/**
+Software License Agreement (BSD)
+
+\file      auto_exposure.cpp
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "spinnaker_camera_driver/auto_exposure.h"
+#include "spinnaker_camera_driver/bayer_pattern.h"
+#include "spinnaker_camera_driver/diagnostic_values.h"
+
+#include <sensor_msgs/image_encodings.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace spinnaker_camera_driver
+{
+namespace
+{
+const int SATURATED_BIN = 250;        ///< Histogram bins from here up count as saturated.
+const double EXPOSURE_DEADBAND = 0.1;  ///< Stops off target that are not corrected.
+const double HIGHLIGHT_STEP = -0.25;   ///< Stops to reduce at least while too many pixels saturate.
+const double BALANCE_DEADBAND = 0.02;  ///< Relative white balance error that is not corrected.
+const double MIN_BALANCE_RATIO = 0.25;
+const double MAX_BALANCE_RATIO = 4.0;
+
+enum Layout
+{
+  MONO,
+  BAYER,
+  RGB,
+  BGR
+};
+
+/// Copies the most significant byte of count 16 bit samples.
+void highBytes(const uint8_t* in, const size_t count, const bool big_endian, uint8_t* out)
+{
+  size_t i = 0;
+#if defined(__SSE2__)
+  const __m128i low_mask = _mm_set1_epi16(0x00FF);
+  for (; i + 8 <= count; i += 8)
+  {
+    const __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 2 * i));
+    const __m128i high = big_endian ? _mm_and_si128(samples, low_mask) : _mm_srli_epi16(samples, 8);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(high, high));
+  }
+#endif
+  for (; i < count; ++i)
+    out[i] = in[2 * i + (big_endian ? 0 : 1)];
+}
+
+/// Averages each 2x2 quad of two Bayer rows into luma and adds the four quad samples to sums, in row major order.
+void meterQuads(const uint8_t* row0, const uint8_t* row1, const size_t quads, uint8_t* luma, uint64_t sums[4])
+{
+  size_t i = 0;
+#if defined(__SSE2__)
+  const __m128i low_mask = _mm_set1_epi16(0x00FF);
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i round = _mm_set1_epi16(2);
+  __m128i accumulators[4] = { zero, zero, zero, zero };
+  for (; i + 8 <= quads; i += 8)
+  {
+    const __m128i top = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 2 * i));
+    const __m128i bottom = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 2 * i));
+    const __m128i samples[4] = { _mm_and_si128(top, low_mask), _mm_srli_epi16(top, 8),
+                                 _mm_and_si128(bottom, low_mask), _mm_srli_epi16(bottom, 8) };
+    __m128i sum = _mm_add_epi16(_mm_add_epi16(samples[0], samples[1]), _mm_add_epi16(samples[2], samples[3]));
+    sum = _mm_srli_epi16(_mm_add_epi16(sum, round), 2);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(luma + i), _mm_packus_epi16(sum, sum));
+    // The high byte of every 16 bit lane is zero, so the byte sums are the sample sums
+    for (int k = 0; k < 4; ++k)
+      accumulators[k] = _mm_add_epi64(accumulators[k], _mm_sad_epu8(samples[k], zero));
+  }
+  for (int k = 0; k < 4; ++k)
+  {
+    uint64_t halves[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(halves), accumulators[k]);
+    sums[k] += halves[0] + halves[1];
+  }
+#endif
+  for (; i < quads; ++i)
+  {
+    const uint8_t samples[4] = { row0[2 * i], row0[2 * i + 1], row1[2 * i], row1[2 * i + 1] };
+    luma[i] = static_cast<uint8_t>((samples[0] + samples[1] + samples[2] + samples[3] + 2) / 4);
+    for (int k = 0; k < 4; ++k)
+      sums[k] += samples[k];
+  }
+}
+
+/// Converts RGB pixels to luma and adds the channels to sums.
+void meterRgb(const uint8_t* row, const size_t pixels, const size_t pixel_bytes, uint8_t* luma, uint64_t sums[3])
+{
+  for (size_t i = 0; i < pixels; ++i)
+  {
+    const uint8_t* pixel = row + i * pixel_bytes;
+    luma[i] = static_cast<uint8_t>((pixel[0] + 2 * pixel[1] + pixel[2] + 2) / 4);
+    for (int k = 0; k < 3; ++k)
+      sums[k] += pixel[k];
+  }
+}
+
+bool readNumber(XmlRpc::XmlRpcValue& entry, const std::string& key, double* value)
+{
+  if (!entry.hasMember(key))
+    return false;
+  if (entry[key].getType() == XmlRpc::XmlRpcValue::TypeDouble)
+    *value = static_cast<double>(entry[key]);
+  else if (entry[key].getType() == XmlRpc::XmlRpcValue::TypeInt)
+    *value = static_cast<int>(entry[key]);
+  else
+    return false;
+  return true;
+}
+}  // namespace
+
+AutoExposure::AutoExposure(const Parameters& parameters, const std::vector<MeteringRegion>& regions)
+  : parameters_(parameters)
+  , settling_(0)
+  , exposure_time_(parameters.min_exposure)
+  , gain_(parameters.min_gain)
+  , red_ratio_(1.0)
+  , blue_ratio_(1.0)
+  , has_white_balance_(false)
+  , brightness_(0.0)
+  , saturated_(0.0)
+{
+  parameters_.damping = std::min(1.0, std::max(0.05, parameters_.damping));
+  parameters_.subsample = std::max(1, parameters_.subsample);
+  parameters_.settle_frames = std::max(0, parameters_.settle_frames);
+
+  std::fill(mask_, mask_ + GRID_SIZE * GRID_SIZE, 1);
+  for (const MeteringRegion& region : regions)
+  {
+    const uint8_t weight = static_cast<uint8_t>(std::min(255, std::max(0, region.weight)));
+    for (int gy = 0; gy < GRID_SIZE; ++gy)
+    {
+      for (int gx = 0; gx < GRID_SIZE; ++gx)
+      {
+        const double cx = (gx + 0.5) / GRID_SIZE;
+        const double cy = (gy + 0.5) / GRID_SIZE;
+        if (cx >= region.x && cx < region.x + region.width && cy >= region.y && cy < region.y + region.height)
+          mask_[gy * GRID_SIZE + gx] = weight;
+      }
+    }
+  }
+}
+
+bool AutoExposure::loadRegions(const ros::NodeHandle& pnh, const std::string& param,
+                               std::vector<MeteringRegion>* regions)
+{
+  regions->clear();
+  XmlRpc::XmlRpcValue list;
+  if (!pnh.getParam(param, list))
+    return true;
+  if (list.getType() != XmlRpc::XmlRpcValue::TypeArray)
+    return false;
+
+  for (int i = 0; i < list.size(); ++i)
+  {
+    XmlRpc::XmlRpcValue& entry = list[i];
+    MeteringRegion region;
+    double weight = 0.0;
+    if (entry.getType() != XmlRpc::XmlRpcValue::TypeStruct || !readNumber(entry, "x", &region.x) ||
+        !readNumber(entry, "y", &region.y) || !readNumber(entry, "width", &region.width) ||
+        !readNumber(entry, "height", &region.height) || !readNumber(entry, "weight", &weight))
+    {
+      ROS_ERROR("[AutoExposure]: Entry %d of %s needs x, y, width, height and weight.", i, param.c_str());
+      return false;
+    }
+    region.weight = static_cast<int>(weight);
+    regions->push_back(region);
+  }
+  return true;
+}
+
+void AutoExposure::reset(const double exposure_time, const double gain)
+{
+  exposure_time_ = std::min(parameters_.max_exposure, std::max(parameters_.min_exposure, exposure_time));
+  gain_ = std::min(parameters_.max_gain, std::max(parameters_.min_gain, gain));
+  has_white_balance_ = false;
+  red_ratio_ = 1.0;
+  blue_ratio_ = 1.0;
+  settling_ = 0;
+}
+
+bool AutoExposure::meter(const sensor_msgs::Image& image, Histogram* histogram) const
+{
+  namespace enc = sensor_msgs::image_encodings;
+  std::memset(histogram, 0, sizeof(*histogram));
+
+  const int depth = enc::bitDepth(image.encoding);
+  if (depth != 8 && depth != 16)
+    return false;
+
+  Layout layout;
+  int red = 0;
+  if (enc::isBayer(image.encoding))
+  {
+    red = getBayerRedIndex(image.encoding);
+    if (red < 0)
+      return false;
+    layout = BAYER;
+  }
+  else if (enc::isMono(image.encoding))
+  {
+    layout = MONO;
+  }
+  else if (image.encoding == enc::RGB8 || image.encoding == enc::RGBA8)
+  {
+    layout = RGB;
+  }
+  else if (image.encoding == enc::BGR8 || image.encoding == enc::BGRA8)
+  {
+    layout = BGR;
+  }
+  else
+  {
+    return false;
+  }
+
+  const bool sixteen_bit = depth == 16;
+  const size_t width = layout == BAYER ? image.width / 2 : image.width;    // Metered pixels per row
+  const size_t height = layout == BAYER ? image.height / 2 : image.height;
+  const size_t samples = layout == BAYER ? 2 * width : width;              // Samples per image row
+  const size_t pixel_bytes = enc::numChannels(image.encoding);
+  if (width == 0 || height == 0 || image.data.size() < static_cast<size_t>(image.step) * image.height ||
+      (sixteen_bit && layout != MONO && layout != BAYER))
+    return false;
+
+  std::vector<uint8_t> luma(width);
+  std::vector<uint8_t> converted[2];
+  if (sixteen_bit)
+  {
+    converted[0].resize(samples);
+    converted[1].resize(samples);
+  }
+
+  for (size_t y = 0; y < height; y += parameters_.subsample)
+  {
+    const int gy = static_cast<int>(y * GRID_SIZE / height);
+    const uint8_t* rows[2];
+    for (int r = 0; r < (layout == BAYER ? 2 : 1); ++r)
+    {
+      rows[r] = image.data.data() + (layout == BAYER ? 2 * y + r : y) * image.step;
+      if (sixteen_bit)
+      {
+        highBytes(rows[r], samples, image.is_bigendian, converted[r].data());
+        rows[r] = converted[r].data();
+      }
+    }
+
+    for (int gx = 0; gx < GRID_SIZE; ++gx)
+    {
+      const uint8_t weight = mask_[gy * GRID_SIZE + gx];
+      const size_t x0 = gx * width / GRID_SIZE;
+      const size_t x1 = (gx + 1) * width / GRID_SIZE;
+      if (weight == 0 || x1 <= x0)
+        continue;
+
+      const uint8_t* span = luma.data() + x0;
+      uint64_t sums[4] = { 0, 0, 0, 0 };
+      if (layout == BAYER)
+      {
+        meterQuads(rows[0] + 2 * x0, rows[1] + 2 * x0, x1 - x0, luma.data() + x0, sums);
+        histogram->channels[0] += weight * sums[red];
+        histogram->channels[1] += weight * ((sums[red ^ 1] + sums[red ^ 2] + 1) / 2);
+        histogram->channels[2] += weight * sums[3 - red];
+      }
+      else if (layout == MONO)
+      {
+        span = rows[0] + x0;
+      }
+      else
+      {
+        meterRgb(rows[0] + x0 * pixel_bytes, x1 - x0, pixel_bytes, luma.data() + x0, sums);
+        histogram->channels[0] += weight * sums[layout == RGB ? 0 : 2];
+        histogram->channels[1] += weight * sums[1];
+        histogram->channels[2] += weight * sums[layout == RGB ? 2 : 0];
+      }
+
+      for (size_t x = 0; x < x1 - x0; ++x)
+        histogram->bins[span[x]] += weight;
+      histogram->weight += weight * (x1 - x0);
+    }
+  }
+  return true;
+}
+
+bool AutoExposure::process(const sensor_msgs::Image& image)
+{
+  if (settling_ > 0)
+  {
+    --settling_;
+    return false;
+  }
+
+  Histogram histogram;
+  if (!meter(image, &histogram) || histogram.weight == 0)
+    return false;
+
+  uint64_t total = 0;
+  uint64_t saturated = 0;
+  for (int bin = 0; bin < 256; ++bin)
+  {
+    total += bin * histogram.bins[bin];
+    if (bin >= SATURATED_BIN)
+      saturated += histogram.bins[bin];
+  }
+  const double brightness = static_cast<double>(total) / histogram.weight / 255.0;
+  const double saturated_fraction = static_cast<double>(saturated) / histogram.weight;
+  brightness_ = brightness;
+  saturated_ = saturated_fraction;
+
+  bool changed = false;
+
+  // Correct in stops of total exposure, exposure time before gain
+  double stops = std::log2(parameters_.target / std::max(brightness, 1.0 / 255.0));
+  if (saturated_fraction > parameters_.max_saturated)
+    stops = std::min(stops, HIGHLIGHT_STEP);
+  if (std::abs(stops) > EXPOSURE_DEADBAND)
+  {
+    const double exposure_time = exposure_time_;
+    const double gain = gain_;
+    const double target = exposure_time * std::pow(10.0, gain / 20.0) * std::pow(2.0, parameters_.damping * stops);
+    const double new_exposure_time = std::min(parameters_.max_exposure, std::max(parameters_.min_exposure, target));
+    const double new_gain = std::min(parameters_.max_gain,
+                                     std::max(parameters_.min_gain, 20.0 * std::log10(target / new_exposure_time)));
+    if (new_exposure_time != exposure_time || new_gain != gain)
+    {
+      exposure_time_ = new_exposure_time;
+      gain_ = new_gain;
+      changed = true;
+    }
+  }
+
+  // Gray world: scale red and blue so that their means match green
+  const uint64_t* channels = histogram.channels;
+  if (parameters_.white_balance && channels[0] > 0 && channels[1] > 0 && channels[2] > 0)
+  {
+    const double red_correction = std::pow(static_cast<double>(channels[1]) / channels[0], parameters_.damping);
+    const double blue_correction = std::pow(static_cast<double>(channels[1]) / channels[2], parameters_.damping);
+    if (!has_white_balance_ || std::abs(red_correction - 1.0) > BALANCE_DEADBAND ||
+        std::abs(blue_correction - 1.0) > BALANCE_DEADBAND)
+    {
+      red_ratio_ = std::min(MAX_BALANCE_RATIO, std::max(MIN_BALANCE_RATIO, red_ratio_ * red_correction));
+      blue_ratio_ = std::min(MAX_BALANCE_RATIO, std::max(MIN_BALANCE_RATIO, blue_ratio_ * blue_correction));
+      has_white_balance_ = true;
+      changed = true;
+    }
+  }
+
+  if (changed)
+    settling_ = parameters_.settle_frames;
+  return changed;
+}
+
+diagnostic_msgs::DiagnosticStatus AutoExposure::getStatus(const std::string& name) const
+{
+  diagnostic_msgs::DiagnosticStatus status;
+  status.name = name;
+
+  const double brightness = brightness_;
+  const double stops = std::log2(parameters_.target / std::max(brightness, 1.0 / 255.0));
+  const bool at_max = exposure_time_ >= parameters_.max_exposure && gain_ >= parameters_.max_gain;
+  const bool at_min = exposure_time_ <= parameters_.min_exposure && gain_ <= parameters_.min_gain;
+  if ((stops > 0.5 && at_max) || (stops < -0.5 && at_min))
+  {
+    status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+    status.message = stops > 0 ? "Underexposed at the exposure and gain limits" :
+                                 "Overexposed at the exposure and gain limits";
+  }
+  else
+  {
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    status.message = "Tracking the target brightness";
+  }
+
+  addValue(&status, "Brightness", brightness);
+  addValue(&status, "Target brightness", parameters_.target);
+  addValue(&status, "Saturated fraction", saturated_);
+  addValue(&status, "Exposure time us", exposure_time_);
+  addValue(&status, "Gain dB", gain_);
+  if (has_white_balance_)
+  {
+    addValue(&status, "Red balance ratio", red_ratio_);
+    addValue(&status, "Blue balance ratio", blue_ratio_);
+  }
+  return status;
+}
+}  // namespace spinnaker_camera_driver
@@ -0,0 +1,157 @@
+/**
+Software License Agreement (BSD)
+
+\file      bandwidth_governor.cpp
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "spinnaker_camera_driver/bandwidth_governor.h"
+#include "spinnaker_camera_driver/diagnostic_values.h"
+
+#include <ros/ros.h>
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <string>
+
+namespace spinnaker_camera_driver
+{
+// Sensor ROI increments accepted by the supported cameras, offsets also keep the Bayer phase.
+static const int WIDTH_ALIGNMENT = 16;
+static const int HEIGHT_ALIGNMENT = 8;
+static const int OFFSET_ALIGNMENT = 8;
+
+static int alignOffset(const int value)
+{
+  return std::max(0, value / OFFSET_ALIGNMENT * OFFSET_ALIGNMENT);
+}
+
+/// Rounds a size down to the increment, keeping at least one increment.
+static int alignSize(const int value, const int alignment)
+{
+  return std::max(alignment, value / alignment * alignment);
+}
+
+BandwidthGovernor::BandwidthGovernor(const double budget, const double min_frame_rate, const int max_binning)
+  : budget_(budget), min_frame_rate_(min_frame_rate), max_binning_(std::max(1, max_binning)), effective_budget_(0)
+{
+  requested_ = chosen_ = OperatingPoint{ 1, 0, 0, 0, 0, 0.0, 0.0, 0.0 };
+}
+
+BandwidthGovernor::OperatingPoint BandwidthGovernor::choose(const OperatingPoint& requested, const int sensor_width,
+                                                            const int sensor_height, const double bits_per_pixel,
+                                                            const double link_limit)
+{
+  effective_budget_ = link_limit > 0.0 ? std::min(budget_, link_limit) : budget_;
+  const double bytes_per_pixel = bits_per_pixel / 8.0;
+  const int requested_binning = std::max(1, requested.binning);
+
+  // A zero width or height selects the full sensor like the ROI configuration does.
+  requested_ = requested;
+  requested_.binning = requested_binning;
+  if (requested_.width <= 0 || requested_.width > sensor_width / requested_binning)
+    requested_.width = sensor_width / requested_binning;
+  if (requested_.height <= 0 || requested_.height > sensor_height / requested_binning)
+    requested_.height = sensor_height / requested_binning;
+  requested_.bytes_per_second = requested_.width * requested_.height * bytes_per_pixel * requested_.frame_rate;
+  requested_.max_frame_rate = effective_budget_ / (requested_.width * requested_.height * bytes_per_pixel);
+
+  const double min_frame_rate = std::min(min_frame_rate_, requested_.frame_rate);
+
+  OperatingPoint point = requested_;
+  for (int binning = requested_binning; binning <= std::max(requested_binning, max_binning_); binning *= 2)
+  {
+    // The requested ROI covers the same part of the sensor at every binning factor.
+    const double scale = static_cast<double>(requested_binning) / binning;
+    point.binning = binning;
+    point.width = alignSize(static_cast<int>(requested_.width * scale), WIDTH_ALIGNMENT);
+    point.height = alignSize(static_cast<int>(requested_.height * scale), HEIGHT_ALIGNMENT);
+    point.x_offset = alignOffset(static_cast<int>(requested_.x_offset * scale));
+    point.y_offset = alignOffset(static_cast<int>(requested_.y_offset * scale));
+    if (binning == requested_binning)
+    {
+      point.width = requested_.width;
+      point.height = requested_.height;
+      point.x_offset = requested_.x_offset;
+      point.y_offset = requested_.y_offset;
+    }
+
+    const double frame_bytes = point.width * point.height * bytes_per_pixel;
+    point.max_frame_rate = effective_budget_ / frame_bytes;
+    point.frame_rate = std::min(requested_.frame_rate, point.max_frame_rate);
+    if (point.frame_rate >= min_frame_rate)
+    {
+      point.bytes_per_second = frame_bytes * point.frame_rate;
+      chosen_ = point;
+      return chosen_;
+    }
+  }
+
+  // Out of binning as well, shrink the ROI around its center until it fits at the minimum frame rate.
+  const double area_scale =
+      std::sqrt(effective_budget_ / (point.width * point.height * bytes_per_pixel * min_frame_rate));
+  const int width = alignSize(static_cast<int>(point.width * area_scale), WIDTH_ALIGNMENT);
+  const int height = alignSize(static_cast<int>(point.height * area_scale), HEIGHT_ALIGNMENT);
+  point.x_offset = alignOffset(point.x_offset + (point.width - width) / 2);
+  point.y_offset = alignOffset(point.y_offset + (point.height - height) / 2);
+  point.width = width;
+  point.height = height;
+  point.frame_rate = min_frame_rate;
+  point.max_frame_rate = effective_budget_ / (point.width * point.height * bytes_per_pixel);
+  point.bytes_per_second = point.width * point.height * bytes_per_pixel * point.frame_rate;
+  chosen_ = point;
+  return chosen_;
+}
+
+diagnostic_msgs::DiagnosticStatus BandwidthGovernor::getStatus(const std::string& name,
+                                                               const std::string& hardware_id) const
+{
+  diagnostic_msgs::DiagnosticStatus status;
+  status.name = name;
+  status.hardware_id = hardware_id;
+
+  if (!isFormatReduced() && chosen_.frame_rate >= requested_.frame_rate)
+  {
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    status.message = "Requested stream fits the bandwidth budget";
+  }
+  else
+  {
+    std::ostringstream message;
+    message << "Reduced to " << chosen_.width << "x" << chosen_.height << " binning " << chosen_.binning << " at "
+            << chosen_.frame_rate << " fps to fit the bandwidth budget";
+    status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+    status.message = message.str();
+  }
+
+  addValue(&status, "Budget MB/s", budget_ * 1e-6);
+  addValue(&status, "Effective budget MB/s", effective_budget_ * 1e-6);
+  addValue(&status, "Requested MB/s", requested_.bytes_per_second * 1e-6);
+  addValue(&status, "Chosen MB/s", chosen_.bytes_per_second * 1e-6);
+  addValue(&status, "Frame rate", chosen_.frame_rate);
+  addValue(&status, "Frame rate limit", chosen_.max_frame_rate);
+  addValue(&status, "Binning", chosen_.binning);
+  addValue(&status, "Width", chosen_.width);
+  addValue(&status, "Height", chosen_.height);
+  addValue(&status, "X offset", chosen_.x_offset);
+  addValue(&status, "Y offset", chosen_.y_offset);
+  return status;
+}
+}  // namespace spinnaker_camera_driver
@@ -0,0 +1,226 @@
+/**
+Software License Agreement (BSD)
+
+\file      burst_capture.cpp
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "spinnaker_camera_driver/burst_capture.h"
+
+#include <rosbag/bag.h>
+#include <sensor_msgs/fill_image.h>
+#include <spinnaker_camera_driver/BurstStatistics.h>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <algorithm>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace spinnaker_camera_driver
+{
+// Alignment of the frames in the pool, a frame starts on its own cache line.
+static const size_t FRAME_ALIGNMENT = 64;
+
+BurstCapture::BurstCapture(ros::NodeHandle& nh, const size_t buffer_count, const std::string& record_directory,
+                           const std::string& prefix, const std::string& frame_id)
+  : it_(nh)
+  , pub_(it_.advertiseCamera("burst/image_raw", 5))
+  , statistics_pub_(nh.advertise<BurstStatistics>("burst_statistics", 10))
+  , record_directory_(record_directory)
+  , prefix_(prefix)
+  , frame_id_(frame_id)
+  , buffer_count_(std::max<size_t>(1, buffer_count))
+  , busy_(new std::atomic<bool>[buffer_count_])
+  , frame_count_(0)
+  , frame_size_(0)
+  , bursts_(0)
+  , bursts_skipped_(0)
+  , worker_(1, buffer_count_, "burst")
+{
+  for (size_t i = 0; i < buffer_count_; ++i)
+    busy_[i] = false;
+}
+
+bool BurstCapture::begin(const uint32_t frame_count, const uint32_t width, const uint32_t height,
+                         const uint32_t step, const std::string& encoding)
+{
+  burst_.reset();
+
+  const size_t frame_size = (static_cast<size_t>(step) * height + FRAME_ALIGNMENT - 1) / FRAME_ALIGNMENT *
+                            FRAME_ALIGNMENT;
+  const bool layout_changed = frame_count != frame_count_ || frame_size != frame_size_;
+  size_t free_buffer = buffer_count_;
+  size_t busy_count = 0;
+  for (size_t i = 0; i < buffer_count_; ++i)
+  {
+    if (busy_[i].load(std::memory_order_acquire))
+      ++busy_count;
+    else if (free_buffer == buffer_count_)
+      free_buffer = i;
+  }
+
+  // The pool can only be repartitioned once the bursts still in it are published
+  if (free_buffer == buffer_count_ || (layout_changed && busy_count > 0))
+  {
+    ++bursts_skipped_;
+    ROS_WARN_THROTTLE(1.0, "[BurstCapture]: All burst buffers are in use, skipping the burst.");
+    return false;
+  }
+
+  if (layout_changed)
+  {
+    // Allocated in one piece and touched now, draining a burst never waits for the allocator or a page fault
+    pool_.reset();
+    frame_count_ = 0;
+    frame_size_ = 0;
+    void* memory = NULL;
+    const size_t pool_size = buffer_count_ * frame_count * frame_size;
+    if (pool_size > 0 && posix_memalign(&memory, FRAME_ALIGNMENT, pool_size) != 0)
+      throw std::bad_alloc();
+    pool_.reset(static_cast<uint8_t*>(memory));
+    std::fill(pool_.get(), pool_.get() + pool_size, 0);
+    frame_count_ = frame_count;
+    frame_size_ = frame_size;
+    ROS_INFO("[BurstCapture]: Allocated %zu bursts of %u frames, %.1f MB.", buffer_count_, frame_count_,
+             pool_size / 1048576.0);
+  }
+
+  burst_.reset(new Burst);
+  burst_->buffer = free_buffer;
+  burst_->frames.reserve(frame_count_);
+  burst_->width = width;
+  burst_->height = height;
+  burst_->step = step;
+  burst_->encoding = encoding;
+  burst_->stamp = ros::Time::now();
+  drain_start_ = std::chrono::steady_clock::now();
+  return true;
+}
+
+void BurstCapture::frameReceived(const FrameInfo& info)
+{
+  burst_->frames.push_back(info);
+}
+
+void BurstCapture::end(const sensor_msgs::CameraInfo& info)
+{
+  if (!burst_)
+    return;
+
+  std::shared_ptr<Burst> burst(std::move(burst_));
+  burst->drain_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - drain_start_).count();
+  burst->info = info;
+  ++bursts_;
+
+  busy_[burst->buffer].store(true, std::memory_order_release);
+  if (!worker_.trySubmit([this, burst] { publish(burst); }))
+  {
+    // Cannot happen with one queue entry per buffer, but never leave a buffer marked busy
+    busy_[burst->buffer].store(false, std::memory_order_release);
+    ++bursts_skipped_;
+  }
+}
+
+void BurstCapture::publish(const std::shared_ptr<Burst>& burst)
+{
+  const std::chrono::steady_clock::time_point publish_start = std::chrono::steady_clock::now();
+  const std::vector<FrameInfo>& frames = burst->frames;
+
+  BurstStatisticsPtr statistics(new BurstStatistics);
+  statistics->header.stamp = burst->stamp;
+  statistics->header.frame_id = frame_id_;
+  statistics->frames_expected = frame_count_;
+  statistics->frames_received = static_cast<uint32_t>(frames.size());
+  statistics->frames_incomplete = 0;
+  statistics->interval_max = 0.0;
+  for (size_t i = 0; i < frames.size(); ++i)
+  {
+    if (frames[i].incomplete)
+      ++statistics->frames_incomplete;
+    if (i > 0)
+      statistics->interval_max =
+          std::max(statistics->interval_max, (frames[i].device_stamp - frames[i - 1].device_stamp) * 1e-9);
+  }
+  statistics->duration = frames.size() > 1 ? (frames.back().device_stamp - frames.front().device_stamp) * 1e-9 : 0.0;
+  statistics->interval_mean = frames.size() > 1 ? statistics->duration / (frames.size() - 1) : 0.0;
+  statistics->drain_time = burst->drain_time;
+
+  // The camera clock keeps the spacing of the frames, the host only saw when the burst started arriving
+  const bool publish = pub_.getNumSubscribers() > 0;
+  std::vector<sensor_msgs::ImagePtr> images;
+  images.reserve(frames.size());
+  const uint8_t* data = pool_.get() + burst->buffer * frame_count_ * frame_size_;
+  for (size_t i = 0; i < frames.size(); ++i, data += frame_size_)
+  {
+    sensor_msgs::ImagePtr image(new sensor_msgs::Image);
+    image->header.stamp = burst->stamp + ros::Duration().fromNSec(frames[i].device_stamp - frames[0].device_stamp);
+    image->header.frame_id = frame_id_;
+    sensor_msgs::fillImage(*image, burst->encoding, burst->height, burst->width, burst->step, data);
+    if (publish)
+    {
+      sensor_msgs::CameraInfoPtr info(new sensor_msgs::CameraInfo(burst->info));
+      info->header = image->header;
+      pub_.publish(image, info);
+    }
+    images.push_back(image);
+  }
+  // The frames are copied out, the buffer may take the next burst
+  busy_[burst->buffer].store(false, std::memory_order_release);
+
+  if (!record_directory_.empty())
+    record(*burst, images);
+
+  statistics->publish_time =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - publish_start).count();
+  statistics->bursts = bursts_;
+  statistics->bursts_skipped = bursts_skipped_;
+  statistics_pub_.publish(statistics);
+  ROS_DEBUG("[BurstCapture]: Burst of %u/%u frames over %.3f ms, drained in %.3f ms, published in %.3f ms.",
+            statistics->frames_received, statistics->frames_expected, statistics->duration * 1e3,
+            statistics->drain_time * 1e3, statistics->publish_time * 1e3);
+}
+
+void BurstCapture::record(const Burst& burst, const std::vector<sensor_msgs::ImagePtr>& images) const
+{
+  std::ostringstream path;
+  path << record_directory_ << "/" << prefix_ << "_burst_" << boost::posix_time::to_iso_string(burst.stamp.toBoost())
+       << ".bag";
+
+  rosbag::Bag bag;
+  try
+  {
+    bag.open(path.str(), rosbag::bagmode::Write);
+    for (size_t i = 0; i < images.size(); ++i)
+    {
+      sensor_msgs::CameraInfo info(burst.info);
+      info.header = images[i]->header;
+      bag.write("image_raw", images[i]->header.stamp, *images[i]);
+      bag.write("camera_info", images[i]->header.stamp, info);
+    }
+    bag.close();
+  }
+  catch (const rosbag::BagException& e)
+  {
+    ROS_ERROR("[BurstCapture]: Failed to write %s: %s", path.str().c_str(), e.what());
+  }
+}
+}  // namespace spinnaker_camera_driver
@@ -72,9 +72,12 @@ void Camera::setFrameRate(const float frame_rate)
   ROS_DEBUG_STREAM("Maximum Frame rate: \t " << ptrAcquisitionFrameRate->GetMax());
 
   // Finally Set the Frame Rate
-  setProperty(node_map_, "AcquisitionFrameRate", frame_rate);
+  const float limited_frame_rate = limitFrameRate(frame_rate);
+  setProperty(node_map_, "AcquisitionFrameRate", limited_frame_rate);
 
-  ROS_WARN("Minimum Frame Rate: %f Maximum Frame rate: %f Current Frame rate: %f  set frame rate: %f", ptrAcquisitionFrameRate->GetMin(), ptrAcquisitionFrameRate->GetMax(), ptrAcquisitionFrameRate->GetValue(), frame_rate);
+  if (limited_frame_rate < frame_rate)
+    ROS_WARN("[SpinnakerCamera]: Frame rate %f limited to %f by the bandwidth budget.", frame_rate,
+             limited_frame_rate);
 
   ROS_DEBUG_STREAM("Current Frame rate: \t " << ptrAcquisitionFrameRate->GetValue());
 }
@@ -83,12 +86,18 @@ void Camera::setNewConfiguration(const SpinnakerConfig& config, const uint32_t&
 {
   try
   {
+    // The sequencer locks the features its sets hold, it is reprogrammed once the configuration is written
+    const bool sequencing = !sequence_.empty();
+    if (level >= LEVEL_RECONFIGURE_STOP && sequencing)
+      setProperty(node_map_, "SequencerMode", std::string("Off"));
+
     if (level >= LEVEL_RECONFIGURE_STOP)
       setImageControlFormats(config);
 
     setFrameRate(static_cast<float>(config.acquisition_frame_rate));
-    // Set enable after frame rate encase its false
-    setProperty(node_map_, "AcquisitionFrameRateEnable", config.acquisition_frame_rate_enable);
+    // Set enable after frame rate encase its false, a frame rate limit only holds with manual control
+    setProperty(node_map_, "AcquisitionFrameRateEnable",
+                config.acquisition_frame_rate_enable || frame_rate_limit_ > 0.0f);
 
     // Set Trigger and Strobe Settings
     // NOTE: The trigger must be disabled (i.e. TriggerMode = "Off") in order to configure whether the source is
@@ -98,6 +107,9 @@ void Camera::setNewConfiguration(const SpinnakerConfig& config, const uint32_t&
     setProperty(node_map_, "TriggerSelector", config.trigger_selector);
     setProperty(node_map_, "TriggerActivation", config.trigger_activation_mode);
     setProperty(node_map_, "TriggerMode", config.enable_trigger);
+    // Frames captured for each FrameBurstStart trigger, only writable while not acquiring
+    if (level >= LEVEL_RECONFIGURE_STOP && IsAvailable(node_map_->GetNode("AcquisitionBurstFrameCount")))
+      setProperty(node_map_, "AcquisitionBurstFrameCount", config.acquisition_burst_frame_count);
 
     setProperty(node_map_, "LineSelector", config.line_selector);
     setProperty(node_map_, "LineMode", config.line_mode);
@@ -105,7 +117,8 @@ void Camera::setNewConfiguration(const SpinnakerConfig& config, const uint32_t&
 
     // Set auto exposure
     setProperty(node_map_, "ExposureMode", config.exposure_mode);
-    setProperty(node_map_, "ExposureAuto", config.exposure_auto);
+    if (!sequencing)
+      setProperty(node_map_, "ExposureAuto", config.exposure_auto);
 
     // Set sharpness
     if (IsAvailable(node_map_->GetNode("SharpeningEnable")))
@@ -129,12 +142,12 @@ void Camera::setNewConfiguration(const SpinnakerConfig& config, const uint32_t&
       }
     }
 
-    // Set shutter time/speed
-    if (config.exposure_auto.compare(std::string("Off")) == 0)
+    // Set shutter time/speed, the sequencer sets hold it while sequencing
+    if (!sequencing && config.exposure_auto.compare(std::string("Off")) == 0)
     {
       setProperty(node_map_, "ExposureTime", static_cast<float>(config.exposure_time));
     }
-    else
+    else if (!sequencing)
     {
       setProperty(node_map_, "AutoExposureExposureTimeUpperLimit",
                   static_cast<float>(config.auto_exposure_time_upper_limit));
@@ -142,8 +155,9 @@ void Camera::setNewConfiguration(const SpinnakerConfig& config, const uint32_t&
 
     // Set gain
     setProperty(node_map_, "GainSelector", config.gain_selector);
-    setProperty(node_map_, "GainAuto", config.auto_gain);
-    if (config.auto_gain.compare(std::string("Off")) == 0)
+    if (!sequencing)
+      setProperty(node_map_, "GainAuto", config.auto_gain);
+    if (!sequencing && config.auto_gain.compare(std::string("Off")) == 0)
     {
       setProperty(node_map_, "Gain", static_cast<float>(config.gain));
     }
@@ -246,9 +260,9 @@ void Camera::setNewConfiguration(const SpinnakerConfig& config, const uint32_t&
       //setProperty(node_map_, "BalanceWhiteAuto", config.auto_white_balance);
       if (config.auto_white_balance.compare(std::string("Off")) == 0)
       {
-        setProperty(node_map_, "BalanceRatioSelector", "Blue");
+        setProperty(node_map_, "BalanceRatioSelector", std::string("Blue"));
         setProperty(node_map_, "BalanceRatio", static_cast<float>(config.white_balance_blue_ratio));
-        setProperty(node_map_, "BalanceRatioSelector", "Red");
+        setProperty(node_map_, "BalanceRatioSelector", std::string("Red"));
         setProperty(node_map_, "BalanceRatio", static_cast<float>(config.white_balance_red_ratio));
       }
     }
@@ -259,6 +273,9 @@ void Camera::setNewConfiguration(const SpinnakerConfig& config, const uint32_t&
 	{
 		setFrameRate(static_cast<float>(settingFrameRate));
 	}
+
+    if (level >= LEVEL_RECONFIGURE_STOP && sequencing)
+      applySequence();
   }
   catch (const Spinnaker::Exception& e)
   {
@@ -311,7 +328,7 @@ void Camera::setImageControlFormats(const spinnaker_camera_driver::SpinnakerConf
   setProperty(node_map_, "OffsetY", config.image_format_y_offset);
 
   // Set Pixel Format
-  setProperty(node_map_, "PixelFormat", setDefaultPixFormat);
+  setProperty(node_map_, "PixelFormat", pixel_format_.empty() ? setDefaultPixFormat : pixel_format_);
   //setProperty(node_map_, "PixelFormat", config.image_format_color_coding);
   //std::cout <<"Camera format: "<<config.image_format_color_coding << std::endl;
 	
@@ -319,29 +336,126 @@ void Camera::setImageControlFormats(const spinnaker_camera_driver::SpinnakerConf
 
 void Camera::setGain(const float& gain)
 {
-  setProperty(node_map_, "GainAuto", "Off");
-  setProperty(node_map_, "Gain", static_cast<float>(gain));
+  setPropertyQuiet(node_map_, "GainAuto", std::string("Off"));
+  setPropertyQuiet(node_map_, "Gain", static_cast<float>(gain));
 }
 
-/*
-void Camera::setGigEParameters(bool auto_packet_size, unsigned int packet_size, unsigned int packet_delay)
+void Camera::setExposureTime(const float exposure_time)
 {
+  setPropertyQuiet(node_map_, "ExposureAuto", std::string("Off"));
+  setPropertyQuiet(node_map_, "ExposureTime", exposure_time);
 }
 
-void Camera::setupGigEPacketSize(PGRGuid & guid)
+void Camera::setBRWhiteBalance(const float red, const float blue)
 {
+  if (!IsAvailable(node_map_->GetNode("BalanceWhiteAuto")))
+    return;
+  // Ratios the camera cannot take are rejected rather than clamped, the result of a clamp is an arbitrary color
+  Spinnaker::GenApi::CFloatPtr ratio = node_map_->GetNode("BalanceRatio");
+  if (IsAvailable(ratio) && IsReadable(ratio))
+  {
+    const double min = ratio->GetMin();
+    const double max = ratio->GetMax();
+    if (red < min || red > max || blue < min || blue > max)
+    {
+      ROS_WARN_THROTTLE(10, "[SpinnakerCamera]: Ignoring white balance ratios %.3f, %.3f outside [%.3f, %.3f].", red,
+                        blue, min, max);
+      return;
+    }
+  }
+  setPropertyQuiet(node_map_, "BalanceWhiteAuto", std::string("Off"));
+  setPropertyQuiet(node_map_, "BalanceRatioSelector", std::string("Red"));
+  setPropertyQuiet(node_map_, "BalanceRatio", red);
+  setPropertyQuiet(node_map_, "BalanceRatioSelector", std::string("Blue"));
+  setPropertyQuiet(node_map_, "BalanceRatio", blue);
 }
 
-void Camera::setupGigEPacketSize(PGRGuid & guid, unsigned int packet_size)
+void Camera::setGigEParameters(const unsigned int packet_size, const unsigned int packet_delay)
 {
-
+  try
+  {
+    setProperty(node_map_, "GevSCPSPacketSize", static_cast<int>(packet_size));
+    setProperty(node_map_, "GevSCPD", static_cast<int>(packet_delay));
+  }
+  catch (const Spinnaker::Exception& e)
+  {
+    throw std::runtime_error("[Camera::setGigEParameters] Failed to set stream channel parameters: " +
+                             std::string(e.what()));
+  }
 }
 
-void Camera::setupGigEPacketDelay(PGRGuid & guid, unsigned int packet_delay)
+void Camera::setSequence(const std::vector<SequencerSet>& sets)
 {
+  sequence_ = sets;
+  try
+  {
+    applySequence();
+  }
+  catch (const Spinnaker::Exception& e)
+  {
+    sequence_.clear();
+    throw std::runtime_error("[Camera::setSequence] Failed to program the sequencer: " + std::string(e.what()));
+  }
+  catch (const std::runtime_error&)
+  {
+    sequence_.clear();
+    throw;
+  }
 }
 
-*/
+void Camera::applySequence()
+{
+  if (!IsAvailable(node_map_->GetNode("SequencerMode")))
+  {
+    if (sequence_.empty())
+      return;
+    throw std::runtime_error("[Camera::applySequence] The camera has no sequencer.");
+  }
+
+  // The sequencer can only be configured while it is off
+  setProperty(node_map_, "SequencerMode", std::string("Off"));
+  if (sequence_.empty())
+  {
+    setProperty(node_map_, "ChunkSelector", std::string("SequencerSetActive"));
+    setProperty(node_map_, "ChunkEnable", false);
+    return;
+  }
+
+  // Sets store the values in effect when they are saved, automatic control would overwrite them
+  setProperty(node_map_, "ExposureAuto", std::string("Off"));
+  setProperty(node_map_, "GainAuto", std::string("Off"));
+  setProperty(node_map_, "SequencerConfigurationMode", std::string("On"));
+  Spinnaker::GenApi::CIntegerPtr selector_ptr = node_map_->GetNode("SequencerSetSelector");
+  if (!IsAvailable(selector_ptr) || static_cast<int64_t>(sequence_.size()) > selector_ptr->GetMax() + 1)
+  {
+    const int64_t max_sets = IsAvailable(selector_ptr) ? selector_ptr->GetMax() + 1 : 0;
+    setProperty(node_map_, "SequencerConfigurationMode", std::string("Off"));
+    throw std::runtime_error("[Camera::applySequence] The sequencer holds at most " + std::to_string(max_sets) +
+                             " sets.");
+  }
+  Spinnaker::GenApi::CCommandPtr save_ptr = node_map_->GetNode("SequencerSetSave");
+  for (size_t i = 0; i < sequence_.size(); ++i)
+  {
+    setProperty(node_map_, "SequencerSetSelector", static_cast<int>(i));
+    setProperty(node_map_, "ExposureTime", sequence_[i].exposure_time);
+    setProperty(node_map_, "Gain", sequence_[i].gain);
+    // Advance to the next set, wrapping around, at the start of every frame
+    setProperty(node_map_, "SequencerPathSelector", 0);
+    setProperty(node_map_, "SequencerSetNext", static_cast<int>((i + 1) % sequence_.size()));
+    setProperty(node_map_, "SequencerTriggerSource", std::string("FrameStart"));
+    if (!IsAvailable(save_ptr) || !IsWritable(save_ptr))
+      throw std::runtime_error("[Camera::applySequence] Unable to save sequencer set " + std::to_string(i));
+    save_ptr->Execute();
+  }
+  setProperty(node_map_, "SequencerSetStart", 0);
+  setProperty(node_map_, "SequencerConfigurationMode", std::string("Off"));
+  setProperty(node_map_, "SequencerMode", std::string("On"));
+
+  // Tag every frame with the set it was exposed with
+  setProperty(node_map_, "ChunkModeActive", true);
+  setProperty(node_map_, "ChunkSelector", std::string("SequencerSetActive"));
+  setProperty(node_map_, "ChunkEnable", true);
+}
 
 int Camera::getHeightMax()
 {
@@ -400,7 +514,7 @@ Spinnaker::GenApi::CNodePtr Camera::readProperty(const Spinnaker::GenICam::gcstr
   return ptr;
 }
 
-Camera::Camera(Spinnaker::GenApi::INodeMap* node_map)
+Camera::Camera(Spinnaker::GenApi::INodeMap* node_map) : frame_rate_limit_(0.0f)
 {
   node_map_ = node_map;
   init();
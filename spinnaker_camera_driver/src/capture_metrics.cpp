@@ -0,0 +1,196 @@
+/**
+Software License Agreement (BSD)
+
+\file      capture_metrics.cpp
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "spinnaker_camera_driver/capture_metrics.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace spinnaker_camera_driver
+{
+namespace
+{
+const char* const STAGE_NAMES[CaptureMetrics::STAGE_COUNT] = { "retrieve", "convert", "publish" };
+
+const double FIRST_BOUND_US = 10.0;
+
+void writeCounter(std::ostream& out, const char* name, const char* help, const std::string& labels,
+                  const uint64_t value)
+{
+  out << "# HELP spinnaker_" << name << "_total " << help << "\n";
+  out << "# TYPE spinnaker_" << name << "_total counter\n";
+  out << "spinnaker_" << name << "_total{" << labels << "} " << value << "\n";
+}
+
+/// Label values may not contain quotes, backslashes or newlines unescaped.
+std::string escapeLabel(const std::string& value)
+{
+  std::string escaped;
+  for (const char c : value)
+  {
+    if (c == '\n')
+    {
+      escaped += "\\n";
+      continue;
+    }
+    if (c == '"' || c == '\\')
+      escaped += '\\';
+    escaped += c;
+  }
+  return escaped;
+}
+}  // namespace
+
+DurationHistogram::DurationHistogram() : count_(0), sum_us_(0)
+{
+  for (std::atomic<uint64_t>& bucket : buckets_)
+    bucket = 0;
+}
+
+void DurationHistogram::record(const double seconds)
+{
+  const uint64_t us = seconds > 0.0 ? static_cast<uint64_t>(seconds * 1e6 + 0.5) : 0;
+  // Bucket i holds (10 us * 2^(i-1), 10 us * 2^i], found from the highest bit of the scaled duration
+  const uint64_t scaled = (us + static_cast<uint64_t>(FIRST_BOUND_US) - 1) / static_cast<uint64_t>(FIRST_BOUND_US);
+  size_t bucket = scaled <= 1 ? 0 : 64 - __builtin_clzll(scaled - 1);
+  if (bucket > BUCKETS)
+    bucket = BUCKETS;
+  buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+  sum_us_.fetch_add(us, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+}
+
+double DurationHistogram::upperBound(const size_t bucket)
+{
+  return FIRST_BOUND_US * static_cast<double>(1ull << bucket) * 1e-6;
+}
+
+CaptureMetrics::CaptureMetrics()
+  : frames_grabbed(0)
+  , frames_incomplete(0)
+  , frames_dropped(0)
+  , frames_published(0)
+  , timeouts(0)
+  , errors(0)
+  , reconnects(0)
+  , bytes(0)
+  , last_fill_(std::chrono::steady_clock::now())
+  , last_frames_(0)
+  , last_bytes_(0)
+{
+}
+
+void CaptureMetrics::fillMessage(const std::string& serial, CameraMetrics* message)
+{
+  message->serial = serial;
+  message->frames_grabbed = frames_grabbed;
+  message->frames_incomplete = frames_incomplete;
+  message->frames_dropped = frames_dropped;
+  message->frames_published = frames_published;
+  message->timeouts = timeouts;
+  message->errors = errors;
+  message->reconnects = reconnects;
+  message->bytes = bytes;
+
+  const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  const double elapsed = std::chrono::duration<double>(now - last_fill_).count();
+  if (elapsed > 0.0)
+  {
+    message->frames_per_second = (message->frames_grabbed - last_frames_) / elapsed;
+    message->bytes_per_second = (message->bytes - last_bytes_) / elapsed;
+  }
+  last_fill_ = now;
+  last_frames_ = message->frames_grabbed;
+  last_bytes_ = message->bytes;
+
+  message->stages.resize(STAGE_COUNT);
+  for (size_t stage = 0; stage < STAGE_COUNT; ++stage)
+  {
+    spinnaker_camera_driver::LatencyHistogram& histogram = message->stages[stage];
+    histogram.stage = STAGE_NAMES[stage];
+    histogram.upper_bounds.resize(DurationHistogram::BUCKETS);
+    histogram.counts.resize(DurationHistogram::BUCKETS + 1);
+    for (size_t bucket = 0; bucket <= DurationHistogram::BUCKETS; ++bucket)
+    {
+      if (bucket < DurationHistogram::BUCKETS)
+        histogram.upper_bounds[bucket] = DurationHistogram::upperBound(bucket);
+      histogram.counts[bucket] = stages_[stage].count(bucket);
+    }
+    histogram.count = stages_[stage].count();
+    histogram.sum = stages_[stage].sum();
+  }
+}
+
+void CaptureMetrics::writePrometheus(std::ostream& out, const std::string& camera, const std::string& serial) const
+{
+  const std::string labels = "camera=\"" + escapeLabel(camera) + "\",serial=\"" + escapeLabel(serial) + "\"";
+  writeCounter(out, "frames_grabbed", "Images returned by the camera, incomplete ones included.", labels,
+               frames_grabbed);
+  writeCounter(out, "frames_incomplete", "Images with missing data.", labels, frames_incomplete);
+  writeCounter(out, "frames_dropped", "Images sent by the camera but never returned.", labels, frames_dropped);
+  writeCounter(out, "frames_published", "Images published by the driver.", labels, frames_published);
+  writeCounter(out, "timeouts", "Grabs without an image within the timeout.", labels, timeouts);
+  writeCounter(out, "errors", "Failures that made the driver reconnect.", labels, errors);
+  writeCounter(out, "reconnects", "Reconnects after the first connect.", labels, reconnects);
+  writeCounter(out, "bytes", "Image payload grabbed in bytes.", labels, bytes);
+
+  out << "# HELP spinnaker_stage_latency_seconds Duration of the capture stages.\n";
+  out << "# TYPE spinnaker_stage_latency_seconds histogram\n";
+  for (size_t stage = 0; stage < STAGE_COUNT; ++stage)
+  {
+    const std::string stage_labels = labels + ",stage=\"" + STAGE_NAMES[stage] + "\"";
+    // Prometheus buckets are cumulative
+    uint64_t cumulative = 0;
+    for (size_t bucket = 0; bucket < DurationHistogram::BUCKETS; ++bucket)
+    {
+      cumulative += stages_[stage].count(bucket);
+      out << "spinnaker_stage_latency_seconds_bucket{" << stage_labels << ",le=\""
+          << DurationHistogram::upperBound(bucket) << "\"} " << cumulative << "\n";
+    }
+    // Read after the buckets, so that +Inf is never below a bucket recorded in the meantime
+    const uint64_t count = stages_[stage].count();
+    out << "spinnaker_stage_latency_seconds_bucket{" << stage_labels << ",le=\"+Inf\"} "
+        << std::max(count, cumulative) << "\n";
+    out << "spinnaker_stage_latency_seconds_sum{" << stage_labels << "} " << stages_[stage].sum() << "\n";
+    out << "spinnaker_stage_latency_seconds_count{" << stage_labels << "} " << std::max(count, cumulative) << "\n";
+  }
+}
+
+bool CaptureMetrics::writePrometheusFile(const std::string& path, const std::string& camera,
+                                         const std::string& serial) const
+{
+  std::ostringstream text;
+  writePrometheus(text, camera, serial);
+
+  const std::string temporary = path + ".tmp";
+  {
+    std::ofstream file(temporary.c_str());
+    file << text.str();
+    if (!file.flush())
+      return false;
+  }
+  return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+}  // namespace spinnaker_camera_driver
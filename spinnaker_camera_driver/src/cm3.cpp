@@ -54,7 +54,7 @@ void Cm3::setFrameRate(const float frame_rate)
   ROS_DEBUG_STREAM("Maximum Frame rate: \t " << ptrAcquisitionFrameRate->GetMax());
 
   // Finally Set the Frame Rate
-  setProperty(node_map_, "AcquisitionFrameRate", frame_rate);
+  setProperty(node_map_, "AcquisitionFrameRate", limitFrameRate(frame_rate));
 
   ROS_DEBUG_STREAM("Current Frame rate: \t " << ptrAcquisitionFrameRate->GetValue());
 }
@@ -68,7 +68,7 @@ void Cm3::setNewConfiguration(const SpinnakerConfig& config, const uint32_t& lev
 
     setFrameRate(static_cast<float>(config.acquisition_frame_rate));
     setProperty(node_map_, "AcquisitionFrameRateEnabled",
-                config.acquisition_frame_rate_enable);  // Set enable after frame rate encase its false
+                config.acquisition_frame_rate_enable || frame_rate_limit_ > 0.0f);  // Set enable after frame rate encase its false
 
     // Set Trigger and Strobe Settings
     // NOTE: The trigger must be disabled (i.e. TriggerMode = "Off") in order to configure whether the source is
@@ -202,6 +202,6 @@ void Cm3::setImageControlFormats(const spinnaker_camera_driver::SpinnakerConfig&
   setProperty(node_map_, "OffsetY", config.image_format_y_offset);
 
   // Set Pixel Format
-  setProperty(node_map_, "PixelFormat", config.image_format_color_coding);
+  setProperty(node_map_, "PixelFormat", pixel_format_.empty() ? config.image_format_color_coding : pixel_format_);
 }
 }  // namespace spinnaker_camera_driver
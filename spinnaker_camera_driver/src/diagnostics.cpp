@@ -72,6 +72,14 @@ void DiagnosticsManager::addDiagnostic(const Spinnaker::GenICam::gcstring name,
   float_params_.push_back(param);
 }
 
+void DiagnosticsManager::updateStatus(const diagnostic_msgs::DiagnosticStatus& status)
+{
+  std::lock_guard<std::mutex> lock(driver_status_mutex_);
+  diagnostic_msgs::DiagnosticStatus& stored = driver_status_[status.name];
+  stored = status;
+  stored.hardware_id = serial_number_;
+}
+
 template <typename T>
 diagnostic_msgs::DiagnosticStatus DiagnosticsManager::getDiagStatus(const diagnostic_params<T>& param, const T value)
 {
@@ -149,6 +157,54 @@ void DiagnosticsManager::processDiagnostics(SpinnakerCamera* spinnaker)
     diag_array.status.push_back(diag_status);
   }
 
+  // Transport layer stream counters
+  std::vector<std::pair<std::string, int64_t>> stream_statistics;
+  if (!spinnaker->getStreamStatistics(&stream_statistics))
+  {
+    diagnostic_msgs::DiagnosticStatus diag_stream;
+    diag_stream.name = "Spinnaker " + camera_name_ + " Stream";
+    diag_stream.hardware_id = serial_number_;
+    diag_stream.level = 2;
+    diag_stream.message = "Failed to read the stream counters";
+    diag_array.status.push_back(diag_stream);
+  }
+  else if (!stream_statistics.empty())
+  {
+    diagnostic_msgs::DiagnosticStatus diag_stream;
+    diag_stream.name = "Spinnaker " + camera_name_ + " Stream";
+    diag_stream.hardware_id = serial_number_;
+    diag_stream.level = 0;
+    diag_stream.message = "OK";
+    for (const std::pair<std::string, int64_t>& counter : stream_statistics)
+    {
+      diagnostic_msgs::KeyValue kv;
+      kv.key = counter.first;
+      kv.value = std::to_string(counter.second);
+      diag_stream.values.push_back(kv);
+
+      // Any new lost, missed, failed or dropped frame or packet since the last update is worth a warning
+      const bool is_loss = counter.first.find("Lost") != std::string::npos ||
+                           counter.first.find("Missed") != std::string::npos ||
+                           counter.first.find("Failed") != std::string::npos ||
+                           counter.first.find("Dropped") != std::string::npos;
+      const auto previous = previous_stream_statistics_.find(counter.first);
+      if (is_loss && previous != previous_stream_statistics_.end() && counter.second > previous->second)
+      {
+        diag_stream.level = 1;
+        diag_stream.message = "WARNING";
+      }
+      previous_stream_statistics_[counter.first] = counter.second;
+    }
+    diag_array.status.push_back(diag_stream);
+  }
+
+  // Statuses reported by the driver
+  {
+    std::lock_guard<std::mutex> lock(driver_status_mutex_);
+    for (const auto& status : driver_status_)
+      diag_array.status.push_back(status.second);
+  }
+
   diagnostics_pub_->publish(diag_array);
 }
 }  // namespace spinnaker_camera_driver
@@ -0,0 +1,252 @@
+/**
+Software License Agreement (BSD)
+
+\file      frame_ring.cpp
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "spinnaker_camera_driver/frame_ring.h"
+
+#include <rosbag/bag.h>
+#include <sensor_msgs/Image.h>
+#include <sensor_msgs/fill_image.h>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace spinnaker_camera_driver
+{
+// How long the dump thread waits for post-trigger frames beyond the requested window before giving up.
+static const double DUMP_TIMEOUT = 2.0;
+
+FrameRing::FrameRing(const size_t capacity_bytes, const std::string& output_directory, const std::string& prefix,
+                     const std::string& frame_id)
+  : capacity_(capacity_bytes)
+  , output_directory_(output_directory)
+  , prefix_(prefix)
+  , frame_id_(frame_id)
+  , storage_(new uint8_t[capacity_bytes])
+  , slot_count_(0)
+  , slot_size_(0)
+  , head_(0)
+  , layout_start_(0)
+  , dumping_(false)
+  , shutdown_(false)
+{
+  // Touch every page now so the acquisition thread never takes a page fault on the ring.
+  std::memset(storage_.get(), 0, capacity_);
+  dump_thread_ = std::thread(&FrameRing::dumpThread, this);
+}
+
+FrameRing::~FrameRing()
+{
+  {
+    std::lock_guard<std::mutex> lock(job_mutex_);
+    shutdown_ = true;
+  }
+  job_cv_.notify_all();
+  if (dump_thread_.joinable())
+    dump_thread_.join();
+}
+
+void FrameRing::repartition(const size_t frame_size)
+{
+  std::lock_guard<std::mutex> lock(layout_mutex_);
+  slot_size_ = frame_size;
+  slot_count_ = capacity_ / frame_size;
+  slots_.reset(new Slot[slot_count_]);
+  for (size_t i = 0; i < slot_count_; ++i)
+  {
+    slots_[i].sequence.store(0, std::memory_order_relaxed);
+    slots_[i].data = storage_.get() + i * slot_size_;
+  }
+  // Frames pushed with the previous layout are gone.
+  layout_start_ = head_.load(std::memory_order_relaxed);
+  ROS_INFO("[FrameRing]: Holding the last %zu frames of %zu bytes.", slot_count_, slot_size_);
+}
+
+void FrameRing::push(const uint8_t* data, const uint32_t width, const uint32_t height, const uint32_t step,
+                     const std::string& encoding, const ros::Time& stamp)
+{
+  const size_t size = static_cast<size_t>(step) * height;
+  if (size == 0 || size > capacity_)
+  {
+    ROS_WARN_THROTTLE(10, "[FrameRing]: Frame of %zu bytes does not fit into a ring of %zu bytes.", size, capacity_);
+    return;
+  }
+
+  // Only the producer changes the layout, so slot_size_ can be read without the lock.
+  if (size > slot_size_ || size < slot_size_ / 2)
+    repartition(size);
+
+  const uint64_t index = head_.load(std::memory_order_relaxed);
+  Slot& slot = slots_[index % slot_count_];
+
+  slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  slot.header.stamp = stamp;
+  slot.header.width = width;
+  slot.header.height = height;
+  slot.header.step = step;
+  std::strncpy(slot.header.encoding, encoding.c_str(), sizeof(slot.header.encoding) - 1);
+  slot.header.encoding[sizeof(slot.header.encoding) - 1] = '\0';
+  std::memcpy(slot.data, data, size);
+
+  slot.sequence.store(2 * (index + 1), std::memory_order_release);
+  head_.store(index + 1, std::memory_order_release);
+}
+
+uint64_t FrameRing::oldestIndex(const uint64_t head)
+{
+  std::lock_guard<std::mutex> lock(layout_mutex_);
+  return std::max(layout_start_, head > slot_count_ ? head - slot_count_ : 0);
+}
+
+bool FrameRing::readFrame(const uint64_t index, FrameHeader* header, std::vector<uint8_t>* buffer)
+{
+  std::lock_guard<std::mutex> lock(layout_mutex_);
+  if (!slots_ || index < layout_start_)
+    return false;
+
+  const Slot& slot = slots_[index % slot_count_];
+  const uint64_t expected = 2 * (index + 1);
+  if (slot.sequence.load(std::memory_order_acquire) != expected)
+    return false;
+
+  *header = slot.header;
+  const size_t size = std::min(static_cast<size_t>(header->step) * header->height, slot_size_);
+  buffer->resize(size);
+  std::memcpy(buffer->data(), slot.data, size);
+
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return slot.sequence.load(std::memory_order_relaxed) == expected;
+}
+
+bool FrameRing::requestDump(const ros::Time& trigger_time, const ros::Duration& pre, const ros::Duration& post,
+                            std::string* path)
+{
+  std::lock_guard<std::mutex> lock(job_mutex_);
+  if (dumping_)
+    return false;
+
+  std::ostringstream name;
+  name << output_directory_ << "/" << prefix_ << "_" << boost::posix_time::to_iso_string(trigger_time.toBoost())
+       << ".bag";
+
+  job_.reset(new DumpJob{ trigger_time - pre, trigger_time + post, name.str() });
+  dumping_ = true;
+  *path = job_->path;
+  job_cv_.notify_one();
+  return true;
+}
+
+void FrameRing::dumpThread()
+{
+  std::unique_lock<std::mutex> lock(job_mutex_);
+  while (!shutdown_)
+  {
+    job_cv_.wait(lock, [this] { return shutdown_ || job_; });
+    if (shutdown_)
+      break;
+
+    std::unique_ptr<DumpJob> job(std::move(job_));
+    lock.unlock();
+    writeDump(*job);
+    dumping_ = false;
+    lock.lock();
+  }
+}
+
+void FrameRing::writeDump(const DumpJob& job)
+{
+  rosbag::Bag bag;
+  try
+  {
+    bag.open(job.path, rosbag::bagmode::Write);
+  }
+  catch (const rosbag::BagException& e)
+  {
+    ROS_ERROR("[FrameRing]: Unable to open %s: %s", job.path.c_str(), e.what());
+    return;
+  }
+
+  FrameHeader header;
+  std::vector<uint8_t> buffer;
+  size_t written = 0;
+  size_t lost = 0;
+
+  // Start at the oldest frame still in the ring and skip everything older than the window.
+  uint64_t head = head_.load(std::memory_order_acquire);
+  uint64_t index = oldestIndex(head);
+  const ros::Time deadline = job.end + ros::Duration(DUMP_TIMEOUT);
+
+  while (!shutdown_)
+  {
+    head = head_.load(std::memory_order_acquire);
+    if (index >= head)
+    {
+      // Waiting for post-trigger frames. Stop if the camera is not delivering any more.
+      if (ros::Time::now() > deadline)
+        break;
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+      continue;
+    }
+
+    if (!readFrame(index, &header, &buffer))
+    {
+      // The producer lapped the dump, continue with the oldest frame that is still available.
+      const uint64_t next = std::max(index + 1, oldestIndex(head_.load(std::memory_order_acquire)));
+      lost += next - index;
+      index = next;
+      continue;
+    }
+    ++index;
+
+    if (header.stamp > job.end)
+      break;
+    if (header.stamp < job.start)
+      continue;
+
+    sensor_msgs::Image image;
+    image.header.stamp = header.stamp;
+    image.header.frame_id = frame_id_;
+    sensor_msgs::fillImage(image, header.encoding, header.height, header.width, header.step, buffer.data());
+    try
+    {
+      bag.write("image_raw", header.stamp, image);
+      ++written;
+    }
+    catch (const rosbag::BagException& e)
+    {
+      ROS_ERROR("[FrameRing]: Failed to write %s: %s", job.path.c_str(), e.what());
+      break;
+    }
+  }
+
+  bag.close();
+  ROS_INFO("[FrameRing]: Wrote %zu frames to %s (%zu lost while dumping).", written, job.path.c_str(), lost);
+}
+}  // namespace spinnaker_camera_driver
@@ -0,0 +1,287 @@
+/**
+Software License Agreement (BSD)
+
+\file      hdr_fusion.cpp
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "spinnaker_camera_driver/hdr_fusion.h"
+#include "spinnaker_camera_driver/sse2_pack.h"
+
+#include <sensor_msgs/image_encodings.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace spinnaker_camera_driver
+{
+namespace
+{
+/// Per frame constants of a fusion.
+struct FusionParameters
+{
+  bool hat;                 ///< Triangular radiance weights, otherwise well exposedness weights.
+  float inverse_max;        ///< Normalizes input samples to [0, 1].
+  float output_scale;       ///< Applied to the fused value.
+  float output_max;         ///< Largest output sample.
+  size_t shortest;          ///< Frame with the shortest exposure.
+  std::vector<float> gains;  ///< Brings the samples of each frame to the exposure of the shortest one.
+};
+
+/// Weight of a sample normalized to [0, 1], 0 for black and saturated samples which carry no information.
+inline float weight(const float x, const bool hat)
+{
+  if (hat)
+    return std::min(x, 1.0f - x);
+  // Polynomial stand-in for the Gaussian around mid gray of Mertens et al.
+  const float d = 1.0f - 4.0f * (x - 0.5f) * (x - 0.5f);
+  return d * d;
+}
+
+#if defined(__SSE2__)
+inline __m128 load4(const uint8_t* in)
+{
+  int32_t bits;
+  std::memcpy(&bits, in, sizeof(bits));
+  const __m128i zero = _mm_setzero_si128();
+  return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bits), zero), zero));
+}
+
+inline __m128 load4(const uint16_t* in)
+{
+  const __m128i samples = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in));
+  return _mm_cvtepi32_ps(_mm_unpacklo_epi16(samples, _mm_setzero_si128()));
+}
+
+inline void store4(const __m128 values, uint8_t* out)
+{
+  __m128i samples = _mm_cvtps_epi32(values);
+  samples = _mm_packs_epi32(samples, samples);
+  const int32_t bits = _mm_cvtsi128_si32(_mm_packus_epi16(samples, samples));
+  std::memcpy(out, &bits, sizeof(bits));
+}
+
+inline void store4(const __m128 values, uint16_t* out)
+{
+  const __m128i samples = _mm_cvtps_epi32(values);
+  _mm_storel_epi64(reinterpret_cast<__m128i*>(out), packUnsigned16(samples, samples));
+}
+#endif
+
+template <typename In, typename Out>
+void fuseSamples(const std::vector<const In*>& frames, const FusionParameters& p, const size_t count, Out* out)
+{
+  const size_t frame_count = frames.size();
+  size_t i = 0;
+#if defined(__SSE2__)
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 half = _mm_set1_ps(0.5f);
+  const __m128 four = _mm_set1_ps(4.0f);
+  const __m128 inverse_max = _mm_set1_ps(p.inverse_max);
+  const __m128 output_scale = _mm_set1_ps(p.output_scale);
+  const __m128 output_max = _mm_set1_ps(p.output_max);
+  for (; i + 4 <= count; i += 4)
+  {
+    __m128 numerator = zero;
+    __m128 denominator = zero;
+    for (size_t f = 0; f < frame_count; ++f)
+    {
+      const __m128 samples = load4(frames[f] + i);
+      const __m128 x = _mm_mul_ps(samples, inverse_max);
+      __m128 w;
+      if (p.hat)
+      {
+        w = _mm_min_ps(x, _mm_sub_ps(one, x));
+      }
+      else
+      {
+        const __m128 centered = _mm_sub_ps(x, half);
+        const __m128 d = _mm_sub_ps(one, _mm_mul_ps(four, _mm_mul_ps(centered, centered)));
+        w = _mm_mul_ps(d, d);
+      }
+      numerator = _mm_add_ps(numerator, _mm_mul_ps(w, _mm_mul_ps(samples, _mm_set1_ps(p.gains[f]))));
+      denominator = _mm_add_ps(denominator, w);
+    }
+    // Samples black or saturated in every frame keep the value of the shortest exposure
+    const __m128 unweighted = _mm_cmpeq_ps(denominator, zero);
+    const __m128 fallback = _mm_mul_ps(load4(frames[p.shortest] + i), _mm_set1_ps(p.gains[p.shortest]));
+    const __m128 fused = _mm_div_ps(numerator, _mm_or_ps(denominator, _mm_and_ps(unweighted, one)));
+    __m128 values = _mm_or_ps(_mm_andnot_ps(unweighted, fused), _mm_and_ps(unweighted, fallback));
+    values = _mm_min_ps(_mm_max_ps(_mm_mul_ps(values, output_scale), zero), output_max);
+    store4(values, out + i);
+  }
+#endif
+  for (; i < count; ++i)
+  {
+    float numerator = 0.0f;
+    float denominator = 0.0f;
+    for (size_t f = 0; f < frame_count; ++f)
+    {
+      const float sample = static_cast<float>(frames[f][i]);
+      const float w = weight(sample * p.inverse_max, p.hat);
+      numerator += w * sample * p.gains[f];
+      denominator += w;
+    }
+    const float value = denominator > 0.0f ? numerator / denominator :
+                                             static_cast<float>(frames[p.shortest][i]) * p.gains[p.shortest];
+    out[i] = static_cast<Out>(std::min(std::max(value * p.output_scale, 0.0f), p.output_max) + 0.5f);
+  }
+}
+
+template <typename In, typename Out>
+void fuseFrames(const std::vector<const uint8_t*>& frames, const FusionParameters& p, const size_t count,
+                uint8_t* out)
+{
+  std::vector<const In*> samples(frames.size());
+  for (size_t f = 0; f < frames.size(); ++f)
+    samples[f] = reinterpret_cast<const In*>(frames[f]);
+  fuseSamples<In, Out>(samples, p, count, reinterpret_cast<Out*>(out));
+}
+}  // namespace
+
+HdrFusion::HdrFusion(ros::NodeHandle& nh, const Method method)
+  : pub_(nh.advertise<sensor_msgs::Image>("image_hdr", 5)), method_(method), next_index_(0), width_(0), height_(0)
+{
+}
+
+bool HdrFusion::parseMethod(const std::string& name, Method* method)
+{
+  if (name == "radiance")
+    *method = RADIANCE;
+  else if (name == "exposure_fusion")
+    *method = EXPOSURE_FUSION;
+  else
+    return false;
+  return true;
+}
+
+bool HdrFusion::add(const sensor_msgs::Image& image, const uint32_t index, const uint32_t length,
+                    const float exposure_time)
+{
+  namespace enc = sensor_msgs::image_encodings;
+  if (!enc::isMono(image.encoding) && !enc::isBayer(image.encoding))
+  {
+    ROS_WARN_ONCE("[HdrFusion]: Encoding %s is not supported, only mono and Bayer images are fused.",
+                  image.encoding.c_str());
+    return false;
+  }
+  const int bit_depth = enc::bitDepth(image.encoding);
+  const size_t sample_size = bit_depth / 8;
+  const size_t row_size = image.width * sample_size;
+  if ((bit_depth != 8 && bit_depth != 16) || length < 2 || image.step < row_size ||
+      image.data.size() < image.step * image.height)
+    return false;
+
+  // Start over with every bracket, the pool only grows when the geometry or the bracket length does
+  if (index == 0)
+  {
+    next_index_ = 0;
+    header_ = image.header;
+    encoding_ = image.encoding;
+    width_ = image.width;
+    height_ = image.height;
+    pool_.resize(length);
+    exposure_times_.resize(length);
+  }
+  if (index != next_index_ || length != pool_.size() || image.encoding != encoding_ || image.width != width_ ||
+      image.height != height_)
+  {
+    next_index_ = 0;
+    return false;
+  }
+
+  // Pack the rows with 16 bit samples in little endian
+  std::vector<uint8_t>& slot = pool_[index];
+  slot.resize(row_size * image.height);
+  const bool swap = sample_size == 2 && image.is_bigendian;
+  for (uint32_t row = 0; row < image.height; ++row)
+  {
+    const uint8_t* in = &image.data[row * image.step];
+    uint8_t* out = &slot[row * row_size];
+    if (!swap)
+    {
+      std::memcpy(out, in, row_size);
+      continue;
+    }
+    for (size_t i = 0; i < row_size; i += 2)
+    {
+      out[i] = in[i + 1];
+      out[i + 1] = in[i];
+    }
+  }
+  exposure_times_[index] = exposure_time;
+  if (++next_index_ < length)
+    return false;
+  next_index_ = 0;
+
+  if (!hasSubscribers())
+    return true;
+  sensor_msgs::ImagePtr fused(new sensor_msgs::Image);
+  fused->header = header_;
+  fused->height = height_;
+  fused->width = width_;
+  fused->encoding = encoding_;
+  // Radiance needs the headroom of 16 bit samples
+  if (method_ == RADIANCE && bit_depth == 8)
+    fused->encoding = encoding_.substr(0, encoding_.size() - 1) + "16";
+  std::vector<const uint8_t*> frames(pool_.size());
+  for (size_t f = 0; f < pool_.size(); ++f)
+    frames[f] = pool_[f].data();
+  fuse(method_, frames, exposure_times_, bit_depth, fused.get());
+  pub_.publish(fused);
+  return true;
+}
+
+void HdrFusion::fuse(const Method method, const std::vector<const uint8_t*>& frames,
+                     const std::vector<float>& exposure_times, const int bit_depth, sensor_msgs::Image* fused)
+{
+  const float input_max = bit_depth == 8 ? 255.0f : 65535.0f;
+  const int output_depth = sensor_msgs::image_encodings::bitDepth(fused->encoding);
+  FusionParameters p;
+  p.hat = method == RADIANCE;
+  p.inverse_max = 1.0f / input_max;
+  p.output_max = output_depth == 8 ? 255.0f : 65535.0f;
+  p.output_scale = p.output_max / input_max;
+  p.shortest = std::min_element(exposure_times.begin(), exposure_times.end()) - exposure_times.begin();
+  p.gains.resize(frames.size(), 1.0f);
+  if (method == RADIANCE)
+  {
+    for (size_t f = 0; f < frames.size(); ++f)
+      p.gains[f] = exposure_times[f] > 0.0f ? exposure_times[p.shortest] / exposure_times[f] : 0.0f;
+  }
+
+  fused->is_bigendian = false;
+  fused->step = fused->width * (output_depth / 8);
+  fused->data.resize(fused->step * fused->height);
+  const size_t count = static_cast<size_t>(fused->width) * fused->height;
+  if (bit_depth == 8 && output_depth == 8)
+    fuseFrames<uint8_t, uint8_t>(frames, p, count, fused->data.data());
+  else if (bit_depth == 8)
+    fuseFrames<uint8_t, uint16_t>(frames, p, count, fused->data.data());
+  else
+    fuseFrames<uint16_t, uint16_t>(frames, p, count, fused->data.data());
+}
+}  // namespace spinnaker_camera_driver
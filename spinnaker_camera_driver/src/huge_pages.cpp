@@ -0,0 +1,185 @@
+/**
+Software License Agreement (BSD)
+
+\file      huge_pages.cpp
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "spinnaker_camera_driver/huge_pages.h"
+#include "spinnaker_camera_driver/diagnostic_values.h"
+
+#include <linux/perf_event.h>
+#include <ros/ros.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace spinnaker_camera_driver
+{
+static const size_t HUGE_PAGE_SIZE = 2 << 20;
+
+/// Advises the whole pages within [data, data + size) to use transparent huge pages.
+static void adviseHugePages(void* data, const size_t size)
+{
+#ifdef MADV_HUGEPAGE
+  const uintptr_t page_size = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+  const uintptr_t begin = (reinterpret_cast<uintptr_t>(data) + page_size - 1) & ~(page_size - 1);
+  const uintptr_t end = (reinterpret_cast<uintptr_t>(data) + size) & ~(page_size - 1);
+  if (end > begin)
+    madvise(reinterpret_cast<void*>(begin), end - begin, MADV_HUGEPAGE);
+#else
+  (void)data;
+  (void)size;
+#endif
+}
+
+HugePageBuffer::HugePageBuffer(const size_t size, const bool lock)
+  : data_(NULL), size_((size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE), hugetlb_(true), locked_(false)
+{
+  void* data = mmap(NULL, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (data == MAP_FAILED)
+  {
+    // Not enough pages in the hugetlbfs pool, align a regular mapping so that transparent huge pages can back it
+    hugetlb_ = false;
+    data = mmap(NULL, size_ + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED)
+      throw std::runtime_error("[HugePageBuffer]: Could not map " + std::to_string(size_) +
+                               " bytes: " + std::strerror(errno));
+    const uintptr_t mapped = reinterpret_cast<uintptr_t>(data);
+    const uintptr_t aligned = (mapped + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    if (aligned > mapped)
+      munmap(data, aligned - mapped);
+    if (mapped + HUGE_PAGE_SIZE > aligned)
+      munmap(reinterpret_cast<void*>(aligned + size_), mapped + HUGE_PAGE_SIZE - aligned);
+    data = reinterpret_cast<void*>(aligned);
+    adviseHugePages(data, size_);
+  }
+  data_ = static_cast<uint8_t*>(data);
+
+  // Fault every page in now rather than on the first frames
+  std::memset(data_, 0, size_);
+  if (lock)
+  {
+    locked_ = mlock(data_, size_) == 0;
+    if (!locked_)
+      ROS_WARN("[HugePageBuffer]: Could not lock %zu bytes: %s", size_, std::strerror(errno));
+  }
+}
+
+HugePageBuffer::~HugePageBuffer()
+{
+  if (locked_)
+    munlock(data_, size_);
+  munmap(data_, size_);
+}
+
+void HugePageBuffer::addToStatus(const std::string& name, diagnostic_msgs::DiagnosticStatus* status) const
+{
+  std::ostringstream value;
+  value << (size_ >> 20) << " MB, " << (hugetlb_ ? "hugetlbfs" : "transparent huge pages")
+        << (locked_ ? ", locked" : "");
+  addValue(status, name, value.str());
+}
+
+void reserveHugePages(std::vector<uint8_t>* data, const size_t size)
+{
+  if (data->capacity() >= size)
+    return;
+  data->reserve(size);
+  // The new storage is not touched yet, so its first faults already get huge pages
+  adviseHugePages(data->data(), data->capacity());
+}
+
+MemoryCounters::MemoryCounters()
+  : tlb_fd_(-1), last_frames_(0), last_minor_faults_(0), last_major_faults_(0), last_tlb_misses_(0)
+{
+}
+
+MemoryCounters::~MemoryCounters()
+{
+  if (tlb_fd_ >= 0)
+    close(tlb_fd_);
+}
+
+void MemoryCounters::attach()
+{
+  if (tlb_fd_ >= 0)
+    close(tlb_fd_);
+
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HW_CACHE;
+  attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  tlb_fd_ = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+  if (tlb_fd_ < 0)
+    ROS_INFO("[MemoryCounters]: No dTLB miss counter: %s", std::strerror(errno));
+
+  read(&last_minor_faults_, &last_major_faults_, &last_tlb_misses_);
+}
+
+void MemoryCounters::read(uint64_t* minor_faults, uint64_t* major_faults, uint64_t* tlb_misses) const
+{
+  rusage usage;
+  if (getrusage(RUSAGE_THREAD, &usage) == 0)
+  {
+    *minor_faults = static_cast<uint64_t>(usage.ru_minflt);
+    *major_faults = static_cast<uint64_t>(usage.ru_majflt);
+  }
+  uint64_t count;
+  if (tlb_fd_ >= 0 && ::read(tlb_fd_, &count, sizeof(count)) == sizeof(count))
+    *tlb_misses = count;
+}
+
+void MemoryCounters::getStatus(const uint64_t frames, diagnostic_msgs::DiagnosticStatus* status)
+{
+  uint64_t minor_faults = last_minor_faults_;
+  uint64_t major_faults = last_major_faults_;
+  uint64_t tlb_misses = last_tlb_misses_;
+  read(&minor_faults, &major_faults, &tlb_misses);
+
+  const double new_frames = static_cast<double>(std::max<uint64_t>(1, frames - last_frames_));
+  addValue(status, "Minor page faults per frame", std::to_string((minor_faults - last_minor_faults_) / new_frames));
+  addValue(status, "Major page faults per frame", std::to_string((major_faults - last_major_faults_) / new_frames));
+  addValue(status, "dTLB misses per frame",
+           tlb_fd_ >= 0 ? std::to_string((tlb_misses - last_tlb_misses_) / new_frames) : "unavailable");
+  if (major_faults > last_major_faults_)
+  {
+    status->level = std::max<uint8_t>(status->level, diagnostic_msgs::DiagnosticStatus::WARN);
+    status->message += (status->message.empty() ? "" : ", ") + std::string("Major page faults while capturing");
+  }
+
+  last_frames_ = frames;
+  last_minor_faults_ = minor_faults;
+  last_major_faults_ = major_faults;
+  last_tlb_misses_ = tlb_misses;
+}
+}  // namespace spinnaker_camera_driver
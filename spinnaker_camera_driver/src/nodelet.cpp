@@ -52,7 +52,30 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <nodelet/nodelet.h>
 
 #include "spinnaker_camera_driver/SpinnakerCamera.h"  // The actual standalone library for the Spinnakers
+#include "spinnaker_camera_driver/auto_exposure.h"
 #include "spinnaker_camera_driver/diagnostics.h"
+#include "spinnaker_camera_driver/diagnostic_values.h"
+#include "spinnaker_camera_driver/bandwidth_governor.h"
+#include "spinnaker_camera_driver/burst_capture.h"
+#include "spinnaker_camera_driver/capture_metrics.h"
+#include "spinnaker_camera_driver/frame_ring.h"
+#include "spinnaker_camera_driver/hdr_fusion.h"
+#include "spinnaker_camera_driver/huge_pages.h"
+#include "spinnaker_camera_driver/pixel_converter.h"
+#include "spinnaker_camera_driver/raw_compressor.h"
+#include "spinnaker_camera_driver/rectifier.h"
+#include "spinnaker_camera_driver/roi_streamer.h"
+#include "spinnaker_camera_driver/sensor_correction.h"
+#include "spinnaker_camera_driver/shm_image_ring.h"
+#include "spinnaker_camera_driver/startup_coordinator.h"
+#include "spinnaker_camera_driver/thread_tuning.h"
+#include "spinnaker_camera_driver/tiled_jpeg_encoder.h"
+#include "spinnaker_camera_driver/tone_mapper.h"
+#include "spinnaker_camera_driver/trigger_queue.h"
+#include <spinnaker_camera_driver/BuildCorrection.h>
+#include <spinnaker_camera_driver/Capture.h>
+#include <spinnaker_camera_driver/DeviceEvent.h>
+#include <spinnaker_camera_driver/SequenceTag.h>
 
 #include <image_transport/image_transport.h>          // ROS library that allows sending compressed images
 #include <camera_info_manager/camera_info_manager.h>  // ROS library that publishes CameraInfo topics
@@ -60,6 +83,10 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <wfov_camera_msgs/WFOVImage.h>
 #include <image_exposure_msgs/ExposureSequence.h>  // Message type for configuring gain and white balance.
+#include <std_msgs/Header.h>
+#include <std_msgs/UInt32.h>
+#include <std_msgs/UInt64.h>
+#include <std_srvs/Trigger.h>
 
 #include <diagnostic_updater/diagnostic_updater.h>  // Headers for publishing diagnostic messages.
 #include <diagnostic_updater/publisher.h>
@@ -68,8 +95,14 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <dynamic_reconfigure/server.h>  // Needed for the dynamic_reconfigure gui service to run
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
 #include <fstream>
 #include <string>
+#include <thread>
+#include <vector>
 
 namespace spinnaker_camera_driver
 {
@@ -77,6 +110,24 @@ class SpinnakerCameraNodelet : public nodelet::Nodelet
 {
 public:
   SpinnakerCameraNodelet()
+    : sequencing_(false)
+    , min_publish_period_(0)
+    , reported_dropped_frames_(0)
+    , software_trigger_active_(false)
+    , acquiring_(false)
+    , grab_timeout_(1.0)
+    , metrics_(std::make_shared<CaptureMetrics>())
+    , follow_frame_rate_(false)
+    , startup_timeout_(30.0)
+    , startup_released_(false)
+    , configuration_deferred_(false)
+    , init_time_(0.0)
+    , hdr_fusion_only_(false)
+    , burst_trigger_active_(false)
+    , burst_frame_count_(0)
+    , device_clock_valid_(false)
+    , device_clock_offset_(0)
+    , frame_size_(0)
   {
   }
 
@@ -120,51 +171,213 @@ private:
   * \param level driver_base reconfiguration level.  See driver_base/SensorLevels.h for more information.
   */
 
-  void paramCallback(const spinnaker_camera_driver::SpinnakerConfig& config, uint32_t level)
+  void paramCallback(const spinnaker_camera_driver::SpinnakerConfig& requested_config, uint32_t level)
   {
-    config_ = config;
+    config_ = requested_config;
+    // The acquisition thread reads these instead of the strings of config_, which are reassigned here
+    burst_trigger_active_ =
+        requested_config.enable_trigger == "On" && requested_config.trigger_selector == "FrameBurstStart";
+    burst_frame_count_ = static_cast<uint32_t>(std::max(1, requested_config.acquisition_burst_frame_count));
+    software_trigger_active_ = requested_config.enable_trigger == "On" && requested_config.trigger_source == "Software";
+
+    // In a startup group the acquisition thread applies config_ once connected, concurrently with the other cameras
+    if (configuration_deferred_)
+      return;
 
     try
     {
-      NODELET_DEBUG_ONCE("Dynamic reconfigure callback with level: %u", level);
-      spinnaker_.setNewConfiguration(config, level);
-
-      // Store needed parameters for the metadata message
-      gain_ = config.gain;
-      wb_blue_ = config.white_balance_blue_ratio;
-      wb_red_ = config.white_balance_red_ratio;
-
-      // No separate param in CameraInfo for binning/decimation
-      binning_x_ = config.image_format_x_binning * config.image_format_x_decimation;
-      binning_y_ = config.image_format_y_binning * config.image_format_y_decimation;
-
-      // Store CameraInfo RegionOfInterest information
-      // TODO(mhosmar): Not compliant with CameraInfo message: "A particular ROI always denotes the
-      //                same window of pixels on the camera sensor, regardless of binning settings."
-      //                These values are in the post binned frame.
-      if ((config.image_format_roi_width + config.image_format_roi_height) > 0 &&
-          (config.image_format_roi_width < spinnaker_.getWidthMax() ||
-           config.image_format_roi_height < spinnaker_.getHeightMax()))
+      applyConfiguration(requested_config, level);
+    }
+    catch (std::runtime_error& e)
+    {
+      NODELET_ERROR("Reconfigure Callback failed with error: %s", e.what());
+    }
+  }
+
+  /*!
+  * \brief Applies requested_config after the bandwidth budget and the software auto exposure adjusted it.
+  *
+  * Throws std::runtime_error if the camera rejects the configuration.
+  */
+  void applyConfiguration(const spinnaker_camera_driver::SpinnakerConfig& requested_config, uint32_t level)
+  {
+    NODELET_DEBUG_ONCE("Dynamic reconfigure callback with level: %u", level);
+    spinnaker_camera_driver::SpinnakerConfig config = requested_config;
+    if (bandwidth_governor_)
+      applyBandwidthBudget(&config, &level);
+    if (auto_exposure_)
+    {
+      // Keep the exposure of the software controller instead of the camera auto modes
+      config.exposure_auto = "Off";
+      config.auto_gain = "Off";
+      config.exposure_time = auto_exposure_->getExposureTime();
+      config.gain = auto_exposure_->getGain();
+      if (auto_exposure_->hasWhiteBalance())
       {
-        roi_x_offset_ = config.image_format_x_offset;
-        roi_y_offset_ = config.image_format_y_offset;
-        roi_width_ = config.image_format_roi_width;
-        roi_height_ = config.image_format_roi_height;
-        do_rectify_ = true;  // Set to true if an ROI is used.
+        config.auto_white_balance = "Off";
+        config.white_balance_red_ratio = auto_exposure_->getRedRatio();
+        config.white_balance_blue_ratio = auto_exposure_->getBlueRatio();
       }
-      else
+    }
+    spinnaker_.setNewConfiguration(config, level);
+
+    followFrameRate(config);
+
+    // Store needed parameters for the metadata message
+    gain_ = config.gain;
+    wb_blue_ = config.white_balance_blue_ratio;
+    wb_red_ = config.white_balance_red_ratio;
+
+    // No separate param in CameraInfo for binning/decimation
+    binning_x_ = config.image_format_x_binning * config.image_format_x_decimation;
+    binning_y_ = config.image_format_y_binning * config.image_format_y_decimation;
+
+    // Store CameraInfo RegionOfInterest information
+    // TODO(mhosmar): Not compliant with CameraInfo message: "A particular ROI always denotes the
+    //                same window of pixels on the camera sensor, regardless of binning settings."
+    //                These values are in the post binned frame.
+    if ((config.image_format_roi_width + config.image_format_roi_height) > 0 &&
+        (config.image_format_roi_width < spinnaker_.getWidthMax() ||
+         config.image_format_roi_height < spinnaker_.getHeightMax()))
+    {
+      roi_x_offset_ = config.image_format_x_offset;
+      roi_y_offset_ = config.image_format_y_offset;
+      roi_width_ = config.image_format_roi_width;
+      roi_height_ = config.image_format_roi_height;
+      do_rectify_ = true;  // Set to true if an ROI is used.
+    }
+    else
+    {
+      // Zeros mean the full resolution was captured.
+      roi_x_offset_ = 0;
+      roi_y_offset_ = 0;
+      roi_height_ = 0;
+      roi_width_ = 0;
+      do_rectify_ = false;  // Set to false if the whole image is captured.
+    }
+  }
+
+  /// Sets the frequency expected by the diagnosed publisher to the frame rate of config if it is fixed.
+  void followFrameRate(const spinnaker_camera_driver::SpinnakerConfig& config)
+  {
+    if (follow_frame_rate_ && config.acquisition_frame_rate_enable && config.acquisition_frame_rate > 0.0)
+    {
+      min_freq_ = config.acquisition_frame_rate;
+      max_freq_ = config.acquisition_frame_rate;
+    }
+  }
+
+  /*!
+  * \brief Reduces frame rate, binning and sensor ROI of config until the camera fits its bandwidth budget.
+  *
+  * The frame rate is capped through SpinnakerCamera::setFrameRateLimit so that it also holds for the frame rate from
+  * the parameter file. The chosen operating point is reported in the diagnostics.
+  * \param level Raised to LEVEL_RECONFIGURE_STOP if the image format has to change.
+  */
+  void applyBandwidthBudget(spinnaker_camera_driver::SpinnakerConfig* config, uint32_t* level)
+  {
+    std::lock_guard<std::mutex> scopedLock(bandwidth_mutex_);
+    BandwidthGovernor::OperatingPoint point;
+    try
+    {
+      // The sensor and link properties are only known once connected, older cameras lack some of them
+      spinnaker_.connect();
+      const Spinnaker::GenApi::CIntegerPtr width_ptr = readOptionalProperty("SensorWidth");
+      const Spinnaker::GenApi::CIntegerPtr height_ptr = readOptionalProperty("SensorHeight");
+      if (!Spinnaker::GenApi::IsReadable(width_ptr) || !Spinnaker::GenApi::IsReadable(height_ptr))
+        throw std::runtime_error("SensorWidth or SensorHeight is not readable");
+      const int sensor_width = static_cast<int>(width_ptr->GetValue());
+      const int sensor_height = static_cast<int>(height_ptr->GetValue());
+      // PixelSize is reported as "Bpp8", "Bpp12", ...
+      int bits_per_pixel = 8;
+      const Spinnaker::GenApi::CEnumerationPtr pixel_size_ptr = readOptionalProperty("PixelSize");
+      if (Spinnaker::GenApi::IsReadable(pixel_size_ptr))
       {
-        // Zeros mean the full resolution was captured.
-        roi_x_offset_ = 0;
-        roi_y_offset_ = 0;
-        roi_height_ = 0;
-        roi_width_ = 0;
-        do_rectify_ = false;  // Set to false if the whole image is captured.
+        const std::string pixel_size(pixel_size_ptr->ToString().c_str());
+        if (pixel_size.size() > 3)
+          bits_per_pixel = std::atoi(pixel_size.c_str() + 3);
       }
+
+      // Without DeviceLinkThroughputLimit the link speed alone limits the budget
+      double link_limit = spinnaker_.getLinkSpeed();
+      const Spinnaker::GenApi::CIntegerPtr throughput_ptr = readOptionalProperty("DeviceLinkThroughputLimit");
+      if (Spinnaker::GenApi::IsReadable(throughput_ptr))
+      {
+        const double throughput_max = static_cast<double>(throughput_ptr->GetMax());
+        link_limit = link_limit > 0.0 ? std::min(link_limit, throughput_max) : throughput_max;
+      }
+      if (link_limit <= 0.0)
+        throw std::runtime_error("neither the link speed nor DeviceLinkThroughputLimit is known");
+
+      BandwidthGovernor::OperatingPoint requested;
+      requested.binning = std::max(config->image_format_x_binning, config->image_format_y_binning);
+      requested.width = config->image_format_roi_width;
+      requested.height = config->image_format_roi_height;
+      requested.x_offset = config->image_format_x_offset;
+      requested.y_offset = config->image_format_y_offset;
+      requested.frame_rate = config->acquisition_frame_rate;
+      if (!config->acquisition_frame_rate_enable)
+      {
+        // A free running camera runs as fast as the exposure and format allow
+        const Spinnaker::GenApi::CFloatPtr rate_ptr = readOptionalProperty("AcquisitionFrameRate");
+        const Spinnaker::GenApi::CFloatPtr resulting_ptr = readOptionalProperty("AcquisitionResultingFrameRate");
+        if (Spinnaker::GenApi::IsReadable(rate_ptr))
+          requested.frame_rate = rate_ptr->GetMax();
+        else if (Spinnaker::GenApi::IsReadable(resulting_ptr))
+          requested.frame_rate = resulting_ptr->GetValue();
+      }
+      point = bandwidth_governor_->choose(requested, sensor_width, sensor_height, bits_per_pixel, link_limit);
+
+      spinnaker_.setLinkThroughputLimit(static_cast<int>(bandwidth_governor_->getEffectiveBudget()));
+      spinnaker_.setFrameRateLimit(static_cast<float>(point.max_frame_rate));
     }
-    catch (std::runtime_error& e)
+    catch (const std::runtime_error& e)
     {
-      NODELET_ERROR("Reconfigure Callback failed with error: %s", e.what());
+      NODELET_WARN("Unable to apply the bandwidth budget: %s", e.what());
+      return;
+    }
+    catch (const Spinnaker::Exception& e)
+    {
+      NODELET_WARN("Unable to apply the bandwidth budget: %s", e.what());
+      return;
+    }
+
+    // Only touch the image format if the governor had to reduce it
+    if (bandwidth_governor_->isFormatReduced())
+    {
+      config->image_format_x_binning = point.binning;
+      config->image_format_y_binning = point.binning;
+      config->image_format_roi_width = point.width;
+      config->image_format_roi_height = point.height;
+      config->image_format_x_offset = point.x_offset;
+      config->image_format_y_offset = point.y_offset;
+    }
+
+    if (point.binning != governed_point_.binning || point.width != governed_point_.width ||
+        point.height != governed_point_.height || point.x_offset != governed_point_.x_offset ||
+        point.y_offset != governed_point_.y_offset)
+    {
+      *level = std::max<uint32_t>(*level, SpinnakerCamera::LEVEL_RECONFIGURE_STOP);
+    }
+    governed_point_ = point;
+
+    NODELET_INFO("Bandwidth budget %.1f MB/s: %dx%d, binning %d, at most %.1f fps (%.1f MB/s at %.1f fps).",
+                 bandwidth_governor_->getEffectiveBudget() * 1e-6, point.width, point.height, point.binning,
+                 point.max_frame_rate, point.bytes_per_second * 1e-6, point.frame_rate);
+    if (diag_man)
+      diag_man->updateStatus(bandwidth_governor_->getStatus("Spinnaker " + frame_id_ + " Bandwidth", ""));
+  }
+
+  /// A property of the connected camera, a NULL pointer if the camera does not have it.
+  Spinnaker::GenApi::CNodePtr readOptionalProperty(const char* name)
+  {
+    try
+    {
+      return spinnaker_.readProperty(name);
+    }
+    catch (const std::runtime_error&)
+    {
+      return 0;
     }
   }
 
@@ -300,15 +513,310 @@ private:
     pnh.param<int>("packet_size", packet_size_, 1400);
     pnh.param<bool>("auto_packet_size", auto_packet_size_, true);
     pnh.param<int>("packet_delay", packet_delay_, 4000);
-
-    // TODO(mhosmar):  Set GigE parameters:
-    // spinnaker_.setGigEParameters(auto_packet_size_, packet_size_, packet_delay_);
+    // Cameras sharing one network interface, if set the packet delay is computed instead of using packet_delay
+    int gige_cameras_per_nic;
+    pnh.param<int>("gige_cameras_per_nic", gige_cameras_per_nic, 0);
+
+    // Set GigE parameters:
+    spinnaker_.setGigEParameters(auto_packet_size_, packet_size_, packet_delay_, std::max(0, gige_cameras_per_nic));
+
+    // Scheduling of the acquisition and diagnostics threads. The acquisition thread allocates the frame buffers, so
+    // by default its memory comes from the NUMA node of the USB or network controller given by numa_device.
+    std::string numa_device;
+    pnh.param<std::string>("numa_device", numa_device, "");
+    const int device_numa_node = numa_device.empty() ? -1 : getDeviceNumaNode(numa_device);
+    if (!numa_device.empty() && device_numa_node < 0)
+      NODELET_WARN("No NUMA node found for %s, not placing the frame buffers.", numa_device.c_str());
+    acquisition_tuning_.load(pnh, "acquisition_thread", device_numa_node);
+    diagnostics_tuning_.load(pnh, "diagnostics_thread", -1);
+
+    // Cameras of one startup group connect as soon as they are loaded instead of on the first subscriber, configure
+    // concurrently and start acquisition together. startup_group_size is the number of nodelets in the group.
+    std::string startup_group;
+    int startup_group_size;
+    pnh.param<std::string>("startup_group", startup_group, "");
+    pnh.param<int>("startup_group_size", startup_group_size, 0);
+    pnh.param<double>("startup_timeout", startup_timeout_, 30.0);
+    if (!startup_group.empty())
+    {
+      if (startup_group_size > 0)
+      {
+        startup_coordinator_ = StartupCoordinator::join(startup_group, static_cast<size_t>(startup_group_size));
+        configuration_deferred_ = true;
+      }
+      else
+      {
+        NODELET_ERROR("startup_group %s needs a startup_group_size, starting on its own.", startup_group.c_str());
+      }
+    }
 
     // Get the location of our camera config yaml
     std::string camera_info_url;
     pnh.param<std::string>("camera_info_url", camera_info_url, "");
+    // Dark frame, flat field and defective pixel correction with maps stored next to the calibration
+    bool sensor_correction;
+    pnh.param<bool>("sensor_correction", sensor_correction, false);
+    if (sensor_correction)
+    {
+      std::string correction_directory;
+      pnh.param<std::string>("correction_directory", correction_directory,
+                             SensorCorrection::directoryOf(camera_info_url));
+      sensor_correction_.reset(new SensorCorrection(correction_directory, std::to_string(serial)));
+      sensor_correction_->load();
+      build_correction_srv_ =
+          pnh.advertiseService("build_correction", &SpinnakerCameraNodelet::buildCorrectionCb, this);
+    }
     // Get the desired frame_id, set to 'camera' if not found
     pnh.param<std::string>("frame_id", frame_id_, "camera");
+
+    // "lossless" publishes every frame in order, "freshest" only the newest frame at the time of publishing, e.g. for
+    // teleoperation where latency matters more than completeness. max_publish_rate limits the freshest mode.
+    std::string frame_delivery;
+    double max_publish_rate;
+    pnh.param<std::string>("frame_delivery", frame_delivery, "lossless");
+    pnh.param<double>("max_publish_rate", max_publish_rate, 0.0);
+    if (frame_delivery == "freshest")
+    {
+      spinnaker_.setFrameDelivery(SpinnakerCamera::DELIVER_NEWEST);
+      if (max_publish_rate > 0.0)
+        min_publish_period_ = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(1.0 / max_publish_rate));
+    }
+    else
+    {
+      if (frame_delivery != "lossless")
+        NODELET_ERROR("Unknown frame_delivery %s, using lossless.", frame_delivery.c_str());
+      if (max_publish_rate > 0.0)
+        NODELET_WARN("max_publish_rate is only used with the freshest frame_delivery.");
+    }
+    dropped_frames_pub_ = nh.advertise<std_msgs::UInt64>("dropped_frames", 1, true);
+
+    // Conversion of the camera pixel format to the published encoding, e.g. BayerRG8 to rgb8
+    std::string output_encoding;
+    pnh.param<std::string>("output_encoding", output_encoding, "");
+    if (PixelConverter::isOutputEncoding(output_encoding))
+      output_converter_.reset(new PixelConverter(output_encoding));
+    else if (!output_encoding.empty())
+      NODELET_ERROR("Unknown output_encoding %s, use mono8, rgb8 or bgr8.", output_encoding.c_str());
+
+    // Acquisition buffers on 2 MB pages handed to the SDK, and published messages reused instead of allocated
+    int user_buffers;
+    bool user_buffers_lock;
+    int message_pool_size;
+    pnh.param<int>("user_buffers", user_buffers, 0);
+    pnh.param<bool>("user_buffers_lock", user_buffers_lock, false);
+    pnh.param<int>("message_pool_size", message_pool_size, 0);
+    spinnaker_.setUserBuffers(static_cast<size_t>(std::max(0, user_buffers)), user_buffers_lock);
+    wfov_pool_.reset(new MessagePool<wfov_camera_msgs::WFOVImage>(std::max(0, message_pool_size)));
+    image_pool_.reset(new MessagePool<sensor_msgs::Image>(std::max(0, message_pool_size)));
+
+    // Without desired_freq the frequency expected by the diagnostics follows the configured frame rate
+    follow_frame_rate_ = !pnh.hasParam("desired_freq") && !pnh.hasParam("min_freq") && !pnh.hasParam("max_freq");
+
+    // Capture counters and stage latencies, published every second and optionally written for node_exporter
+    spinnaker_.setMetrics(metrics_);
+    metrics_pub_ = nh.advertise<CameraMetrics>("metrics", 1);
+    pnh.param<std::string>("metrics_file", metrics_file_, "");
+    std_msgs::UInt64 no_dropped_frames;
+    no_dropped_frames.data = 0;
+    dropped_frames_pub_.publish(no_dropped_frames);
+
+    // Bandwidth budget in MB/s, either for this camera or for the whole bus shared by bus_camera_count cameras
+    double bandwidth_budget_mbps;
+    double bus_bandwidth_budget_mbps;
+    int bus_camera_count;
+    pnh.param<double>("bandwidth_budget_mbps", bandwidth_budget_mbps, 0.0);
+    pnh.param<double>("bus_bandwidth_budget_mbps", bus_bandwidth_budget_mbps, 0.0);
+    pnh.param<int>("bus_camera_count", bus_camera_count, 1);
+    if (bus_bandwidth_budget_mbps > 0.0)
+    {
+      const double bus_share = bus_bandwidth_budget_mbps / std::max(1, bus_camera_count);
+      bandwidth_budget_mbps = bandwidth_budget_mbps > 0.0 ? std::min(bandwidth_budget_mbps, bus_share) : bus_share;
+    }
+    if (bandwidth_budget_mbps > 0.0)
+    {
+      double bandwidth_min_frame_rate;
+      int bandwidth_max_binning;
+      pnh.param<double>("bandwidth_min_frame_rate", bandwidth_min_frame_rate, 5.0);
+      pnh.param<int>("bandwidth_max_binning", bandwidth_max_binning, 4);
+      bandwidth_governor_.reset(
+          new BandwidthGovernor(bandwidth_budget_mbps * 1e6, bandwidth_min_frame_rate, bandwidth_max_binning));
+      governed_point_ = BandwidthGovernor::OperatingPoint();
+    }
+
+    // Pre-trigger ring buffer, disabled when its size is 0
+    int frame_ring_size_mb;
+    pnh.param<int>("frame_ring_size_mb", frame_ring_size_mb, 0);
+    if (frame_ring_size_mb > 0)
+    {
+      std::string frame_ring_directory;
+      pnh.param<std::string>("frame_ring_directory", frame_ring_directory, "/tmp");
+      // Seconds of frames written before and after a dump trigger
+      pnh.param<double>("frame_ring_pre_trigger", frame_ring_pre_trigger_, 5.0);
+      pnh.param<double>("frame_ring_post_trigger", frame_ring_post_trigger_, 2.0);
+
+      frame_ring_ = std::make_shared<FrameRing>(static_cast<size_t>(frame_ring_size_mb) << 20, frame_ring_directory,
+                                                std::to_string(serial), frame_id_);
+      spinnaker_.setFrameRing(frame_ring_);
+
+      frame_ring_srv_ = pnh.advertiseService("dump_frame_ring", &SpinnakerCameraNodelet::dumpFrameRingCb, this);
+      frame_ring_sub_ = nh.subscribe("dump_frame_ring", 1, &SpinnakerCameraNodelet::dumpFrameRingTriggerCb, this);
+    }
+
+    // Capture on demand with the software trigger, the frames are also published as usual
+    trigger_queue_.reset(new TriggerQueue([this] { spinnaker_.fireSoftwareTrigger(); }));
+    capture_srv_ = pnh.advertiseService("capture", &SpinnakerCameraNodelet::captureCb, this);
+    capture_sub_ = nh.subscribe("capture_trigger", 10, &SpinnakerCameraNodelet::captureTriggerCb, this);
+
+    // Sequencer set of every image bracketed on the camera, see gainWBCallback
+    sequence_tag_pub_ = nh.advertise<SequenceTag>("image_sequence_tag", 10);
+
+    // Shared memory transport for consumers on the same host, disabled when there are no slots
+    int shared_memory_slots;
+    pnh.param<int>("shared_memory_slots", shared_memory_slots, 0);
+    if (shared_memory_slots > 0)
+    {
+      // Named after the nodelet as well, several nodelets may open the same serial
+      std::string shm_name = "/spinnaker" + getName() + "_" + std::to_string(serial);
+      // Portable segment names have no slash but the leading one
+      std::replace(shm_name.begin() + 1, shm_name.end(), '/', '_');
+      shm_pub_.reset(new ShmImagePublisher(shm_name, shared_memory_slots));
+      shm_desc_pub_ = nh.advertise<SharedImageDescriptor>("image_shm", 5);
+    }
+
+    // Lossless compression of the raw frames on compressed_raw, disabled without worker threads
+    int compressed_raw_threads;
+    pnh.param<int>("compressed_raw_threads", compressed_raw_threads, 0);
+    if (compressed_raw_threads > 0)
+    {
+      int compressed_raw_queue_size;
+      int compressed_raw_acceleration;
+      pnh.param<int>("compressed_raw_queue_size", compressed_raw_queue_size, 2 * compressed_raw_threads);
+      pnh.param<int>("compressed_raw_acceleration", compressed_raw_acceleration, 1);
+      raw_compressor_.reset(new RawCompressor(nh, compressed_raw_threads, std::max(1, compressed_raw_queue_size),
+                                              std::max(1, compressed_raw_acceleration)));
+    }
+
+    // JPEG preview on image_preview/compressed, each frame is split into strips encoded in parallel
+    int jpeg_preview_strips;
+    pnh.param<int>("jpeg_preview_strips", jpeg_preview_strips, 0);
+    if (jpeg_preview_strips > 0)
+    {
+      int jpeg_preview_quality;
+      double jpeg_preview_max_rate;
+      pnh.param<int>("jpeg_preview_quality", jpeg_preview_quality, 80);
+      pnh.param<double>("jpeg_preview_max_rate", jpeg_preview_max_rate, 0.0);
+      jpeg_preview_.reset(
+          new TiledJpegEncoder(nh, jpeg_preview_strips, jpeg_preview_quality, jpeg_preview_max_rate));
+    }
+
+    // Software auto exposure, metering every grabbed frame
+    bool auto_exposure;
+    pnh.param<bool>("auto_exposure", auto_exposure, false);
+    if (auto_exposure)
+    {
+      AutoExposure::Parameters parameters;
+      pnh.param<double>("auto_exposure_target", parameters.target, 0.45);
+      pnh.param<double>("auto_exposure_max_saturated", parameters.max_saturated, 0.02);
+      pnh.param<double>("auto_exposure_min_time", parameters.min_exposure, 20.0);
+      pnh.param<double>("auto_exposure_max_time", parameters.max_exposure, 20000.0);
+      pnh.param<double>("auto_exposure_min_gain", parameters.min_gain, 0.0);
+      pnh.param<double>("auto_exposure_max_gain", parameters.max_gain, 18.0);
+      pnh.param<double>("auto_exposure_damping", parameters.damping, 0.6);
+      pnh.param<int>("auto_exposure_settle_frames", parameters.settle_frames, 2);
+      pnh.param<int>("auto_exposure_subsample", parameters.subsample, 4);
+      pnh.param<bool>("auto_exposure_white_balance", parameters.white_balance, false);
+      std::vector<AutoExposure::MeteringRegion> regions;
+      if (!AutoExposure::loadRegions(pnh, "auto_exposure_mask", &regions))
+        NODELET_ERROR("Ignoring the malformed auto_exposure_mask.");
+      auto_exposure_.reset(new AutoExposure(parameters, regions));
+    }
+
+    // Software ROIs cut out of every frame, each published on roi/<name>/image_raw
+    std::vector<RoiStreamer::Roi> rois;
+    if (pnh.hasParam("rois"))
+    {
+      if (RoiStreamer::loadRois(pnh, "rois", &rois))
+        roi_streamer_.reset(new RoiStreamer(nh, rois));
+      else
+        NODELET_ERROR("Ignoring malformed rois parameter.");
+    }
+
+    // Rectification in the driver on image_rect and image_rect_color, instead of an image_proc instance
+    bool rectify;
+    pnh.param<bool>("rectify", rectify, false);
+    if (rectify)
+      rectifier_.reset(new Rectifier(nh));
+
+    // Fusion of the brackets captured by the sequencer into one frame on image_hdr
+    std::string hdr_fusion;
+    pnh.param<std::string>("hdr_fusion", hdr_fusion, "");
+    HdrFusion::Method hdr_method;
+    if (HdrFusion::parseMethod(hdr_fusion, &hdr_method))
+    {
+      hdr_fusion_.reset(new HdrFusion(nh, hdr_method));
+      // Only the fused frame leaves the driver, the diagnosed rate drops by the bracket length
+      pnh.param<bool>("hdr_fusion_only", hdr_fusion_only_, false);
+    }
+    else if (!hdr_fusion.empty())
+    {
+      NODELET_ERROR("Unknown hdr_fusion %s, use radiance or exposure_fusion.", hdr_fusion.c_str());
+    }
+
+    // Frames are converted while copied out of the SDK buffer, unless correction or fusion need the raw frame first
+    if (output_converter_ && !sensor_correction_ && !hdr_fusion_)
+    {
+      spinnaker_.setOutputEncoding(output_converter_->getEncoding());
+      output_converter_.reset();
+    }
+
+    // 8 bit stream of 16 bit captures on image_8bit, mapped through a tone curve
+    std::string tone_map;
+    pnh.param<std::string>("tone_map", tone_map, "");
+    ToneMapper::Parameters tone_map_parameters;
+    if (ToneMapper::parseCurve(tone_map, &tone_map_parameters.curve))
+    {
+      pnh.param<double>("tone_map_min", tone_map_parameters.min, 0.0);
+      pnh.param<double>("tone_map_max", tone_map_parameters.max, 65535.0);
+      pnh.param<double>("tone_map_gamma", tone_map_parameters.gamma, 2.2);
+      pnh.param<double>("tone_map_log_gain", tone_map_parameters.log_gain, 100.0);
+      pnh.param<bool>("tone_map_auto", tone_map_parameters.auto_percentile, false);
+      pnh.param<double>("tone_map_low_percentile", tone_map_parameters.low_percentile, 1.0);
+      pnh.param<double>("tone_map_high_percentile", tone_map_parameters.high_percentile, 99.5);
+      pnh.param<double>("tone_map_damping", tone_map_parameters.damping, 0.3);
+      pnh.param<int>("tone_map_subsample", tone_map_parameters.subsample, 4);
+      tone_mapper_.reset(new ToneMapper(nh, tone_map_parameters));
+    }
+    else if (!tone_map.empty())
+    {
+      NODELET_ERROR("Unknown tone_map %s, use linear, gamma or log.", tone_map.c_str());
+    }
+
+    // Frames of FrameBurstStart triggers are drained into burst buffers and published on burst/image_raw
+    bool burst_capture;
+    pnh.param<bool>("burst_capture", burst_capture, false);
+    if (burst_capture)
+    {
+      int burst_buffers;
+      std::string burst_record_directory;
+      pnh.param<int>("burst_buffers", burst_buffers, 2);
+      pnh.param<std::string>("burst_record_directory", burst_record_directory, "");
+      burst_capture_.reset(new BurstCapture(nh, std::max(1, burst_buffers), burst_record_directory,
+                                            std::to_string(serial), frame_id_));
+    }
+
+    // Device events such as ExposureEnd on device_events, published as soon as the camera sends them
+    std::vector<std::string> device_events;
+    pnh.param<std::vector<std::string> >("device_events", device_events, std::vector<std::string>());
+    if (!device_events.empty())
+    {
+      device_event_pub_ = nh.advertise<DeviceEvent>("device_events", 100);
+      spinnaker_.setDeviceEvents(device_events,
+                                 [this](const std::string& name, const uint64_t frame_id, const uint64_t device_stamp) {
+                                   publishDeviceEvent(name, frame_id, device_stamp);
+                                 });
+    }
+
     // Do not call the connectCb function until after we are done initializing.
     std::lock_guard<std::mutex> scopedLock(connect_mutex_);
 
@@ -337,6 +845,7 @@ private:
     pnh.param<double>("desired_freq", desired_freq, 30.0);
     pnh.param<double>("min_freq", min_freq_, desired_freq);
     pnh.param<double>("max_freq", max_freq_, desired_freq);
+    followFrameRate(config_);
     double freq_tolerance;  // Tolerance before stating error on publish frequency, fractional percent of desired
                             // frequencies.
     pnh.param<double>("freq_tolerance", freq_tolerance, 0.1);
@@ -371,6 +880,17 @@ private:
     diag_man->addDiagnostic("PowerSupplyCurrent", true, std::make_pair(0.4f, 0.6f), 0.3f, 1.0f);
     diag_man->addDiagnostic<int>("DeviceUptime");
     diag_man->addDiagnostic<int>("U3VMessageChannelID");
+    if (bandwidth_governor_)
+    {
+      // The first configuration was applied before the diagnostics manager existed
+      std::lock_guard<std::mutex> bandwidthLock(bandwidth_mutex_);
+      diag_man->updateStatus(bandwidth_governor_->getStatus("Spinnaker " + frame_id_ + " Bandwidth", ""));
+    }
+
+    // Connect right away, the acquisition thread waits for the rest of the group before starting
+    if (startup_coordinator_)
+      pubThread_.reset(
+          new boost::thread(boost::bind(&spinnaker_camera_driver::SpinnakerCameraNodelet::devicePoll, this)));
   }
 
   /**
@@ -403,8 +923,126 @@ private:
     return 0;
   }
 
+  /*!
+  * \brief Writes the frames around trigger_time from the ring buffer to disk.
+  *
+  * The bag is written by the ring's own thread, this returns as soon as the dump is scheduled.
+  * \param message Filled with the bag file name, or the reason the dump was not started.
+  * \return true if the dump was scheduled.
+  */
+  bool dumpFrameRing(const ros::Time& trigger_time, std::string* message)
+  {
+    std::string path;
+    if (!frame_ring_->requestDump(trigger_time, ros::Duration(frame_ring_pre_trigger_),
+                                  ros::Duration(frame_ring_post_trigger_), &path))
+    {
+      *message = "A frame ring dump is already in progress.";
+      return false;
+    }
+    NODELET_INFO("Dumping frame ring around %f to %s", trigger_time.toSec(), path.c_str());
+    *message = path;
+    return true;
+  }
+
+  bool dumpFrameRingCb(std_srvs::Trigger::Request& /*req*/, std_srvs::Trigger::Response& res)
+  {
+    res.success = dumpFrameRing(ros::Time::now(), &res.message);
+    return true;
+  }
+
+  /// Called from the service and subscriber callbacks, so it reads the snapshot taken by paramCallback.
+  bool softwareTriggered() const
+  {
+    return software_trigger_active_;
+  }
+
+  /// Starts acquisition like a new subscriber would and waits up to timeout seconds for the camera to stream.
+  bool startAcquisition(const double timeout)
+  {
+    {
+      std::lock_guard<std::mutex> scopedLock(connect_mutex_);
+      if (!pubThread_)
+        pubThread_.reset(
+            new boost::thread(boost::bind(&spinnaker_camera_driver::SpinnakerCameraNodelet::devicePoll, this)));
+    }
+    const std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                               std::chrono::duration<double>(timeout));
+    while (!acquiring_ && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    return acquiring_;
+  }
+
+  bool captureCb(spinnaker_camera_driver::Capture::Request& req, spinnaker_camera_driver::Capture::Response& res)
+  {
+    const size_t count = std::max<uint32_t>(1, req.count);
+    const double timeout = req.timeout > 0.0 ? req.timeout : static_cast<double>(count);
+    if (!softwareTriggered())
+    {
+      res.success = false;
+      res.message = "The camera is not configured for the software trigger, set enable_trigger On and "
+                    "trigger_source Software.";
+    }
+    else if (!startAcquisition(timeout))
+    {
+      res.success = false;
+      res.message = "The camera did not start streaming.";
+    }
+    else
+    {
+      res.success = trigger_queue_->capture(count, timeout, &res.images, &res.latencies, &res.message);
+    }
+    return true;
+  }
+
+  bool buildCorrectionCb(spinnaker_camera_driver::BuildCorrection::Request& req,
+                         spinnaker_camera_driver::BuildCorrection::Response& res)
+  {
+    SensorCorrection::Map map;
+    const double timeout = req.timeout > 0.0 ? req.timeout : 10.0;
+    res.defects = 0;
+    if (!SensorCorrection::parseMap(req.map, &map))
+    {
+      res.success = false;
+      res.message = "Unknown map " + req.map + ", use dark or flat.";
+    }
+    else if (!startAcquisition(timeout))
+    {
+      res.success = false;
+      res.message = "The camera did not start streaming.";
+    }
+    else
+    {
+      res.success = sensor_correction_->build(map, req.frames > 0 ? req.frames : 16, timeout, &res.defects,
+                                              &res.message);
+    }
+    if (res.success)
+      NODELET_INFO("%s", res.message.c_str());
+    return true;
+  }
+
+  /// Fires msg.data software triggers (at least one), the frames are only published.
+  void captureTriggerCb(const std_msgs::UInt32& msg)
+  {
+    if (!softwareTriggered())
+    {
+      NODELET_WARN("Ignoring capture_trigger, the camera is not configured for the software trigger.");
+      return;
+    }
+    trigger_queue_->queue(std::max<uint32_t>(1, msg.data));
+  }
+
+  /// A zero stamp triggers at the time the message is received.
+  void dumpFrameRingTriggerCb(const std_msgs::Header& msg)
+  {
+    std::string message;
+    if (!dumpFrameRing(msg.stamp.isZero() ? ros::Time::now() : msg.stamp, &message))
+      NODELET_WARN("%s", message.c_str());
+  }
+
   void diagPoll()
   {
+    diagnostics_tuning_.apply("Diagnostics");
     while (!boost::this_thread::interruption_requested())  // Block until we need
                                                            // to stop this
                                                            // thread.
@@ -422,6 +1060,8 @@ private:
   void devicePoll()
   {
     ROS_INFO_ONCE("devicePoll");
+    acquisition_tuning_.apply("Acquisition");
+    memory_counters_.attach();
 
     enum State
     {
@@ -436,11 +1076,25 @@ private:
     State state = DISCONNECTED;
     State previous_state = NONE;
 
+    // Frame interval used as the deadline when the frame rate is not set, smoothed over a few frames
+    std::chrono::steady_clock::time_point previous_grab;
+    double frame_interval = 0.0;
+    std::chrono::steady_clock::time_point last_thread_status = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point last_clock_latch;
+    std::chrono::steady_clock::time_point last_publish;
+    bool connected_before = false;
+
     while (!boost::this_thread::interruption_requested())  // Block until we need to stop this thread.
     {
       bool state_changed = state != previous_state;
 
       previous_state = state;
+      if (state_changed && state == ERROR)
+      {
+        ++metrics_->errors;
+        acquiring_ = false;
+        trigger_queue_->clear("The camera failed while capturing.");
+      }
 
       switch (state)
       {
@@ -500,13 +1154,28 @@ private:
           try
           {
             NODELET_DEBUG("Connecting to camera.");
+            const std::chrono::steady_clock::time_point init_start = std::chrono::steady_clock::now();
 
             spinnaker_.connect();
 
             NODELET_DEBUG("Connected to camera.");
 
             // Set last configuration, forcing the reconfigure level to stop
-            spinnaker_.setNewConfiguration(config_, SpinnakerCamera::LEVEL_RECONFIGURE_STOP);
+            if (configuration_deferred_)
+            {
+              applyConfiguration(config_, SpinnakerCamera::LEVEL_RECONFIGURE_STOP);
+              configuration_deferred_ = false;
+            }
+            else
+            {
+              spinnaker_.setNewConfiguration(config_, SpinnakerCamera::LEVEL_RECONFIGURE_STOP);
+            }
+            if (auto_exposure_)
+            {
+              auto_exposure_->reset(config_.exposure_time, config_.gain);
+              spinnaker_.setExposureTime(static_cast<float>(auto_exposure_->getExposureTime()));
+              spinnaker_.setGain(static_cast<float>(auto_exposure_->getGain()));
+            }
 
             // Set the timeout for grabbing images.
             try
@@ -516,6 +1185,7 @@ private:
 
               NODELET_DEBUG_ONCE("Setting timeout to: %f.", timeout);
               spinnaker_.setTimeout(timeout);
+              grab_timeout_ = timeout;
             }
             catch (const std::runtime_error& e)
             {
@@ -530,6 +1200,14 @@ private:
                                               &spinnaker_camera_driver::SpinnakerCameraNodelet::gainWBCallback, this);
             }
 
+            if (connected_before)
+              ++metrics_->reconnects;
+            connected_before = true;
+            init_time_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - init_start).count();
+            NODELET_INFO("Camera %u initialized in %.2f s.", spinnaker_.getSerial(), init_time_.load());
+            // The clock of the new connection is latched once streaming
+            device_clock_valid_ = false;
+            last_clock_latch = std::chrono::steady_clock::time_point();
             state = CONNECTED;
           }
           catch (const std::runtime_error& e)
@@ -544,15 +1222,32 @@ private:
 
           break;
         case CONNECTED:
+          // Only the first start waits for the group, reconnects after errors start on their own
+          if (startup_coordinator_ && !startup_released_)
+          {
+            startup_coordinator_->arrive(std::to_string(spinnaker_.getSerial()), init_time_);
+            const std::chrono::steady_clock::time_point wait_start = std::chrono::steady_clock::now();
+            while (!startup_coordinator_->wait(0.1) && !boost::this_thread::interruption_requested())
+            {
+              if (std::chrono::steady_clock::now() - wait_start > std::chrono::duration<double>(startup_timeout_))
+                startup_coordinator_->release();
+            }
+            if (boost::this_thread::interruption_requested())
+              break;
+            startup_released_ = true;
+          }
           // Try starting the camera
           try
           {
             NODELET_DEBUG("Starting camera.");
             spinnaker_.start();
+            if (startup_coordinator_)
+              startup_coordinator_->started(std::to_string(spinnaker_.getSerial()));
             NODELET_DEBUG("Started camera.");
             NODELET_DEBUG("Attention: if nothing subscribes to the camera topic, the camera_info is not published "
                           "on the correspondent topic.");
             state = STARTED;
+            acquiring_ = true;
           }
           catch (std::runtime_error& e)
           {
@@ -568,52 +1263,159 @@ private:
         case STARTED:
           try
           {
-            wfov_camera_msgs::WFOVImagePtr wfov_image(new wfov_camera_msgs::WFOVImage);
+            // A burst is drained in one go and published in the background, none of its frames is processed here
+            if (burst_capture_ && burst_trigger_active_)
+            {
+              grabBurst();
+              break;
+            }
+
+            // Wait for the next publish slot before grabbing so that the frame taken is the newest when it is due
+            if (min_publish_period_.count() > 0 && last_publish.time_since_epoch().count() > 0)
+              std::this_thread::sleep_until(last_publish + min_publish_period_);
+
+            // A recycled message already has the storage for the frame, a new one gets it on huge pages
+            wfov_camera_msgs::WFOVImagePtr wfov_image = wfov_pool_->acquire();
+            reserveHugePages(&wfov_image->image.data, frame_size_);
             // Get the image from the camera library
             NODELET_DEBUG_ONCE("Starting a new grab from camera with serial {%d}.", spinnaker_.getSerial());
             spinnaker_.grabImage(&wfov_image->image, frame_id_);
+            frame_size_ = wfov_image->image.data.size();
+            const std::chrono::steady_clock::time_point grabbed = std::chrono::steady_clock::now();
+            last_publish = grabbed;
+            // Stamped before any processing, whose duration varies from frame to frame
+            ros::Time time = ros::Time::now();
+            wfov_image->header.stamp = time;
+            wfov_image->image.header.stamp = time;
+            if (sensor_correction_)
+              sensor_correction_->process(&wfov_image->image);
 
             // Set other values
             wfov_image->header.frame_id = frame_id_;
 
             wfov_image->gain = gain_;
+            SequenceTagPtr sequence_tag(new SequenceTag);
+            Camera::SequencerSet sequencer_set;
+            if (spinnaker_.getSequenceSet(&sequence_tag->index, &sequence_tag->length, &sequencer_set))
+            {
+              sequence_tag->exposure_time = sequencer_set.exposure_time;
+              sequence_tag->gain = sequencer_set.gain;
+              wfov_image->gain = sequencer_set.gain;
+            }
+            else
+            {
+              sequence_tag.reset();
+            }
             wfov_image->white_balance_blue = wb_blue_;
             wfov_image->white_balance_red = wb_red_;
 
             // wfov_image->temperature = spinnaker_.getCameraTemperature();
 
-            ros::Time time = ros::Time::now();
-            wfov_image->header.stamp = time;
-            wfov_image->image.header.stamp = time;
+            // Returned by the capture service if the frame follows a software trigger fired for it
+            trigger_queue_->frameGrabbed(&wfov_image->image, grabbed, grab_timeout_);
 
             // Set the CameraInfo message
-            ci_.reset(new sensor_msgs::CameraInfo(cinfo_->getCameraInfo()));
-            ci_->header.stamp = wfov_image->image.header.stamp;
-            ci_->header.frame_id = wfov_image->header.frame_id;
-            // The height, width, distortion model, and parameters are all filled in by camera info manager.
-            ci_->binning_x = binning_x_;
-            ci_->binning_y = binning_y_;
-            ci_->roi.x_offset = roi_x_offset_;
-            ci_->roi.y_offset = roi_y_offset_;
-            ci_->roi.height = roi_height_;
-            ci_->roi.width = roi_width_;
-            ci_->roi.do_rectify = do_rectify_;
+            ci_ = makeCameraInfo(wfov_image->image.header.stamp);
 
             wfov_image->info = *ci_;
 
+            // Bracketed frames are merged once the last one of the bracket arrives, with hdr_fusion_only none of
+            // them leaves the driver on its own
+            bool publish_frame = true;
+            if (hdr_fusion_ && sequence_tag)
+            {
+              hdr_fusion_->add(wfov_image->image, sequence_tag->index, sequence_tag->length,
+                               sequence_tag->exposure_time);
+              publish_frame = !hdr_fusion_only_;
+            }
+
+            // Converted only once the raw frame has been corrected and fused
+            if (publish_frame && output_converter_)
+              convertOutput(&wfov_image->image);
+
             // Publish the full message
-            pub_->publish(wfov_image);
+            if (publish_frame)
+              pub_->publish(wfov_image);
+
+            if (sequence_tag)
+            {
+              sequence_tag->header = wfov_image->image.header;
+              sequence_tag_pub_.publish(sequence_tag);
+            }
 
             // Publish the message using standard image transport
-            if (it_pub_.getNumSubscribers() > 0)
+            if (publish_frame && it_pub_.getNumSubscribers() > 0)
             {
-              sensor_msgs::ImagePtr image(new sensor_msgs::Image(wfov_image->image));
+              sensor_msgs::ImagePtr image = image_pool_->acquire();
+              reserveHugePages(&image->data, frame_size_);
+              *image = wfov_image->image;
               it_pub_.publish(image, ci_);
             }
+
+            // Publish a descriptor of the image in shared memory, the pixels are copied once into the ring
+            if (publish_frame && shm_pub_ && shm_desc_pub_.getNumSubscribers() > 0)
+            {
+              SharedImageDescriptorPtr descriptor(new SharedImageDescriptor);
+              if (shm_pub_->write(wfov_image->image, descriptor.get()))
+                shm_desc_pub_.publish(descriptor);
+            }
+
+            if (publish_frame && roi_streamer_)
+              roi_streamer_->publish(wfov_image->image, *ci_);
+
+            // Remapped straight from the grab buffer, the tables follow the calibration, binning and ROI
+            if (publish_frame && rectifier_ && rectifier_->hasSubscribers())
+              rectifier_->publish(wfov_image->image, *ci_);
+
+            // Straight from the grab buffer, the table is only applied while someone listens
+            if (publish_frame && tone_mapper_ && tone_mapper_->hasSubscribers())
+              tone_mapper_->publish(wfov_image->image);
+
+            // Compress in the background, the workers share the published image instead of copying it
+            if (publish_frame && raw_compressor_ && raw_compressor_->hasSubscribers())
+              raw_compressor_->publish(sensor_msgs::ImageConstPtr(wfov_image, &wfov_image->image));
+
+            // Skipped while the previous preview is still being encoded
+            if (publish_frame && jpeg_preview_ && jpeg_preview_->hasSubscribers())
+              jpeg_preview_->publish(sensor_msgs::ImageConstPtr(wfov_image, &wfov_image->image));
+
+            // Steer exposure from this frame once it is stamped and published, applied by the next grabImage
+            if (auto_exposure_ && auto_exposure_->process(wfov_image->image))
+            {
+              spinnaker_.setExposureTime(static_cast<float>(auto_exposure_->getExposureTime()));
+              spinnaker_.setGain(static_cast<float>(auto_exposure_->getGain()));
+              if (auto_exposure_->hasWhiteBalance())
+                spinnaker_.setWhiteBalance(static_cast<float>(auto_exposure_->getRedRatio()),
+                                           static_cast<float>(auto_exposure_->getBlueRatio()));
+              gain_ = auto_exposure_->getGain();
+            }
+
+            if (publish_frame)
+              ++metrics_->frames_published;
+            metrics_->recordStage(CaptureMetrics::STAGE_PUBLISH,
+                                  std::chrono::duration<double>(std::chrono::steady_clock::now() - grabbed).count());
+
+            // The frame is handled late if the next one was due before we got back to grabbing it
+            if (previous_grab.time_since_epoch().count() > 0)
+            {
+              const double interval = std::chrono::duration<double>(grabbed - previous_grab).count();
+              frame_interval = frame_interval > 0.0 ? 0.9 * frame_interval + 0.1 * interval : interval;
+            }
+            previous_grab = grabbed;
+            const double deadline = config_.acquisition_frame_rate_enable && config_.acquisition_frame_rate > 0.0 ?
+                                        1.0 / config_.acquisition_frame_rate :
+                                        frame_interval;
+            acquisition_deadlines_.record(
+                std::chrono::duration<double>(std::chrono::steady_clock::now() - grabbed).count(), deadline);
           }
           catch (CameraTimeoutException& e)
           {
-            NODELET_WARN("%s", e.what());
+            // Waiting for a trigger is no reason to warn
+            if (config_.enable_trigger == "On")
+              NODELET_DEBUG("%s", e.what());
+            else
+              NODELET_WARN("%s", e.what());
+            trigger_queue_->frameGrabbed(NULL, std::chrono::steady_clock::now(), grab_timeout_);
           }
 
           catch (std::runtime_error& e)
@@ -629,24 +1431,216 @@ private:
 
       // Update diagnostics
       updater_.update();
+      if (diag_man && std::chrono::steady_clock::now() - last_thread_status > std::chrono::seconds(1))
+      {
+        last_thread_status = std::chrono::steady_clock::now();
+        updateThreadStatus();
+        updateStartupStatus();
+        updateMemoryStatus();
+        publishDroppedFrames();
+        publishMetrics();
+        if (auto_exposure_)
+          diag_man->updateStatus(auto_exposure_->getStatus("Spinnaker " + frame_id_ + " Auto Exposure"));
+      }
+
+      // The camera clock drifts against the host, keep the offset device events are dated with fresh
+      if (device_event_pub_ && state == STARTED &&
+          std::chrono::steady_clock::now() - last_clock_latch > std::chrono::seconds(1))
+      {
+        last_clock_latch = std::chrono::steady_clock::now();
+        int64_t offset;
+        if (spinnaker_.getClockOffset(&offset))
+        {
+          device_clock_offset_ = offset;
+          device_clock_valid_ = true;
+        }
+      }
     }
+    acquiring_ = false;
+    trigger_queue_->clear("Acquisition stopped.");
     NODELET_DEBUG_ONCE("Leaving thread.");
   }
 
+  /// Called on the event thread of the SDK, published right away so that the event arrives ahead of the image.
+  void publishDeviceEvent(const std::string& name, const uint64_t frame_id, const uint64_t device_stamp)
+  {
+    DeviceEventPtr event(new DeviceEvent);
+    event->received = ros::Time::now();
+    event->header.stamp = event->received;
+    event->header.frame_id = frame_id_;
+    event->name = name;
+    event->frame_id = frame_id;
+    event->device_stamp = device_stamp;
+
+    // Dated back by how long ago the event happened on the camera clock
+    if (device_stamp != 0 && device_clock_valid_)
+    {
+      const int64_t now =
+          std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+              .count();
+      const int64_t age = now - (static_cast<int64_t>(device_stamp) + device_clock_offset_);
+      if (age > 0 && age < 1000000000)
+        event->header.stamp = event->received - ros::Duration(age * 1e-9);
+    }
+    device_event_pub_.publish(event);
+  }
+
+  /// Converts image to output_encoding, keeping the data of the previous raw frame for the next conversion.
+  void convertOutput(sensor_msgs::Image* image)
+  {
+    if (!output_converter_->convert(*image, &converted_))
+    {
+      NODELET_WARN_ONCE("No conversion from %s to %s, publishing %s.", image->encoding.c_str(),
+                        output_converter_->getEncoding().c_str(), image->encoding.c_str());
+      return;
+    }
+    image->encoding = converted_.encoding;
+    image->step = converted_.step;
+    image->data.swap(converted_.data);
+  }
+
+  /// CameraInfo of a frame grabbed with the current binning and ROI.
+  sensor_msgs::CameraInfoPtr makeCameraInfo(const ros::Time& stamp)
+  {
+    sensor_msgs::CameraInfoPtr info(new sensor_msgs::CameraInfo(cinfo_->getCameraInfo()));
+    info->header.stamp = stamp;
+    info->header.frame_id = frame_id_;
+    // The height, width, distortion model, and parameters are all filled in by camera info manager.
+    info->binning_x = binning_x_;
+    info->binning_y = binning_y_;
+    info->roi.x_offset = roi_x_offset_;
+    info->roi.y_offset = roi_y_offset_;
+    info->roi.height = roi_height_;
+    info->roi.width = roi_width_;
+    info->roi.do_rectify = do_rectify_;
+    return info;
+  }
+
+  /// Drains one burst into burst_capture_, called from the acquisition thread instead of grabbing a frame.
+  void grabBurst()
+  {
+    const uint32_t received = spinnaker_.grabBurst(burst_capture_.get(), burst_frame_count_);
+    burst_capture_->end(*makeCameraInfo(ros::Time::now()));
+    metrics_->frames_published += received;
+  }
+
+  /// Reports the thread scheduling and the missed acquisition deadlines, called from the acquisition thread.
+  void updateThreadStatus()
+  {
+    diagnostic_msgs::DiagnosticStatus status;
+    status.name = "Spinnaker " + frame_id_ + " Threads";
+    acquisition_deadlines_.getStatus(&status);
+    acquisition_tuning_.addToStatus("Acquisition", &status);
+    diagnostics_tuning_.addToStatus("Diagnostics", &status);
+    diag_man->updateStatus(status);
+  }
+
+  /// Publishes the frames the camera sent but the driver did not publish, only when the count changed.
+  void publishDroppedFrames()
+  {
+    const uint64_t dropped = spinnaker_.getDroppedFrames();
+    if (dropped == reported_dropped_frames_)
+      return;
+    std_msgs::UInt64 msg;
+    msg.data = dropped;
+    dropped_frames_pub_.publish(msg);
+    reported_dropped_frames_ = dropped;
+  }
+
+  /// Publishes the capture metrics and replaces metrics_file with them, called once a second.
+  void publishMetrics()
+  {
+    const std::string serial = std::to_string(spinnaker_.getSerial());
+    if (metrics_pub_.getNumSubscribers() > 0)
+    {
+      CameraMetricsPtr message(new CameraMetrics);
+      message->header.stamp = ros::Time::now();
+      message->header.frame_id = frame_id_;
+      metrics_->fillMessage(serial, message.get());
+      metrics_pub_.publish(message);
+    }
+    if (!metrics_file_.empty() && !metrics_->writePrometheusFile(metrics_file_, frame_id_, serial))
+      NODELET_WARN_THROTTLE(60.0, "Could not write the metrics to %s", metrics_file_.c_str());
+  }
+
+  /// Reports how long connecting and configuring took and, in a startup group, the progress of the group.
+  void updateStartupStatus()
+  {
+    diagnostic_msgs::DiagnosticStatus status;
+    status.name = "Spinnaker " + frame_id_ + " Startup";
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    status.message = "Initialized";
+    addValue(&status, "Init time s", init_time_.load());
+    if (startup_coordinator_)
+      startup_coordinator_->addToStatus(&status);
+    diag_man->updateStatus(status);
+  }
+
+  /// Reports the backing of the frame memory and the faults taken by the acquisition thread, called from it.
+  void updateMemoryStatus()
+  {
+    diagnostic_msgs::DiagnosticStatus status;
+    status.name = "Spinnaker " + frame_id_ + " Memory";
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    const std::shared_ptr<const HugePageBuffer> user_buffers = spinnaker_.getUserBuffers();
+    if (user_buffers)
+    {
+      user_buffers->addToStatus("Acquisition buffers", &status);
+    }
+    else
+    {
+      addValue(&status, "Acquisition buffers", "allocated by the SDK");
+    }
+    addValue(&status, "Messages reused", std::to_string(wfov_pool_->getReused() + image_pool_->getReused()));
+    addValue(&status, "Messages allocated", std::to_string(wfov_pool_->getAllocated() + image_pool_->getAllocated()));
+    memory_counters_.getStatus(metrics_->frames_grabbed, &status);
+    if (status.message.empty())
+      status.message = user_buffers ? "Acquiring into huge pages" : "Acquiring into the buffers of the SDK";
+    diag_man->updateStatus(status);
+  }
+
   void gainWBCallback(const image_exposure_msgs::ExposureSequence& msg)
   {
+    if (auto_exposure_)
+    {
+      NODELET_WARN_THROTTLE(10, "Ignoring image_exposure_sequence while the software auto exposure is enabled.");
+      return;
+    }
+
     try
     {
       NODELET_DEBUG_ONCE("Gain callback:  Setting gain to %f and white balances to %u, %u", msg.gain,
                          msg.white_balance_blue, msg.white_balance_red);
       gain_ = msg.gain;
 
-      spinnaker_.setGain(static_cast<float>(gain_));
+      // Several shutter times bracket exposure on the camera, every frame takes the next one in turn
+      std::vector<Camera::SequencerSet> sequence;
+      if (msg.shutter.size() > 1)
+      {
+        for (size_t i = 0; i < msg.shutter.size(); ++i)
+        {
+          Camera::SequencerSet set;
+          set.exposure_time = static_cast<float>(msg.shutter[i]);
+          set.gain = msg.gain;
+          sequence.push_back(set);
+        }
+      }
+      if (!sequence.empty() || sequencing_)
+      {
+        sequencing_ = false;
+        spinnaker_.setSequence(sequence);
+        sequencing_ = !sequence.empty();
+        NODELET_INFO("Sequencer %s with %zu sets.", sequencing_ ? "programmed" : "turned off", sequence.size());
+      }
+      if (!sequencing_)
+        spinnaker_.setGain(static_cast<float>(gain_));
       wb_blue_ = msg.white_balance_blue;
       wb_red_ = msg.white_balance_red;
 
-      // TODO(mhosmar):
-      // spinnaker_.setBRWhiteBalance(false, wb_blue_, wb_red_);
+      // The white balance of the message is taken as the BalanceRatio of the camera, ratios out of its range are
+      // rejected. Senders that only set the gain leave it at 0, and the auto white balance of the camera wins.
+      if (config_.auto_white_balance == "Off" && wb_red_ != 0 && wb_blue_ != 0)
+        spinnaker_.setWhiteBalance(wb_red_, wb_blue_);
     }
     catch (std::runtime_error& e)
     {
@@ -672,6 +1666,8 @@ private:
   /// constructor
   /// requirements
   ros::Subscriber sub_;  ///< Subscriber for gain and white balance changes.
+  bool sequencing_;      ///< The last image_exposure_sequence programmed the sequencer, callback thread only.
+  ros::Publisher sequence_tag_pub_;
 
   std::mutex connect_mutex_;
 
@@ -684,6 +1680,35 @@ private:
   std::string frame_id_;           ///< Frame id for the camera messages, defaults to 'camera'
   std::shared_ptr<boost::thread> pubThread_;  ///< The thread that reads and publishes the images.
   std::shared_ptr<boost::thread> diagThread_;  ///< The thread that reads and publishes the diagnostics.
+  ThreadTuning acquisition_tuning_;              ///< Scheduling of pubThread_, applied when it starts.
+  ThreadTuning diagnostics_tuning_;              ///< Scheduling of diagThread_, applied when it starts.
+  DeadlineMonitor acquisition_deadlines_;        ///< Frames not handled within one frame interval.
+
+  // Frame delivery:
+  std::chrono::steady_clock::duration min_publish_period_;  ///< Between frames in the freshest mode, 0 if unlimited.
+  ros::Publisher dropped_frames_pub_;                        ///< Latched count of frames dropped since start.
+  uint64_t reported_dropped_frames_;                         ///< Last count published, acquisition thread only.
+
+  // Capture on demand:
+  std::unique_ptr<TriggerQueue> trigger_queue_;
+  std::atomic<bool> software_trigger_active_;  ///< Software triggering is configured, set by paramCallback.
+  ros::ServiceServer capture_srv_;
+  ros::Subscriber capture_sub_;
+  std::atomic<bool> acquiring_;  ///< The acquisition thread is grabbing frames.
+  double grab_timeout_;          ///< Seconds, also the time a software trigger waits for its frame.
+
+  // Metrics:
+  std::shared_ptr<CaptureMetrics> metrics_;  ///< Shared with spinnaker_, which updates it from grabImage.
+  ros::Publisher metrics_pub_;
+  std::string metrics_file_;                 ///< Prometheus text file, empty if not written.
+  bool follow_frame_rate_;                   ///< The diagnosed frequency follows acquisition_frame_rate.
+
+  // Coordinated startup:
+  std::shared_ptr<StartupCoordinator> startup_coordinator_;  ///< NULL unless startup_group is set.
+  double startup_timeout_;            ///< Seconds to wait for the rest of the group before starting anyway.
+  bool startup_released_;             ///< Set once the first start no longer waits for the group.
+  std::atomic<bool> configuration_deferred_;  ///< config_ is applied by the acquisition thread once connected.
+  std::atomic<double> init_time_;     ///< Seconds the last connect and configure took.
 
   std::unique_ptr<DiagnosticsManager> diag_man;
 
@@ -709,6 +1734,46 @@ private:
   /// GigE packet delay:
   int packet_delay_;
 
+  // Bandwidth budget:
+  std::unique_ptr<BandwidthGovernor> bandwidth_governor_;  ///< NULL if no budget is configured.
+  BandwidthGovernor::OperatingPoint governed_point_;        ///< Operating point currently applied to the camera.
+  std::mutex bandwidth_mutex_;
+
+  // Pre-trigger ring buffer:
+  std::shared_ptr<FrameRing> frame_ring_;
+  double frame_ring_pre_trigger_;   ///< Seconds written before the trigger.
+  double frame_ring_post_trigger_;  ///< Seconds written after the trigger.
+  ros::ServiceServer frame_ring_srv_;
+  ros::Subscriber frame_ring_sub_;
+
+  std::unique_ptr<ShmImagePublisher> shm_pub_;  ///< Shared memory ring, only used by the acquisition thread.
+  ros::Publisher shm_desc_pub_;                 ///< Publishes where each image lives in the shared memory ring.
+
+  std::unique_ptr<RawCompressor> raw_compressor_;  ///< Publishes compressed_raw, NULL if disabled.
+  std::unique_ptr<AutoExposure> auto_exposure_;  ///< Software exposure control, NULL if disabled.
+  std::unique_ptr<TiledJpegEncoder> jpeg_preview_;  ///< Publishes image_preview/compressed, NULL if disabled.
+  std::unique_ptr<RoiStreamer> roi_streamer_;  ///< Publishes the software ROIs, NULL if none are configured.
+  std::unique_ptr<SensorCorrection> sensor_correction_;  ///< Applied right after grabImage, NULL if disabled.
+  ros::ServiceServer build_correction_srv_;
+  std::unique_ptr<Rectifier> rectifier_;       ///< Publishes rectified images, NULL unless rectify is set.
+  std::unique_ptr<HdrFusion> hdr_fusion_;      ///< Publishes fused brackets, NULL unless hdr_fusion is set.
+  std::unique_ptr<PixelConverter> output_converter_;  ///< NULL unless the raw frame is converted after correction.
+  sensor_msgs::Image converted_;                       ///< Scratch of output_converter_, poll thread only.
+  bool hdr_fusion_only_;                       ///< Bracketed frames are not published on their own.
+  std::unique_ptr<ToneMapper> tone_mapper_;    ///< Publishes image_8bit, NULL unless tone_map is set.
+  std::unique_ptr<BurstCapture> burst_capture_;  ///< Publishes FrameBurstStart bursts, NULL unless enabled.
+  std::atomic<bool> burst_trigger_active_;       ///< FrameBurstStart triggering is configured, set by paramCallback.
+  std::atomic<uint32_t> burst_frame_count_;      ///< acquisition_burst_frame_count, set by paramCallback.
+  ros::Publisher device_event_pub_;              ///< Only advertised if device_events are configured.
+  std::atomic<bool> device_clock_valid_;         ///< device_clock_offset_ was latched on the current connection.
+  std::atomic<int64_t> device_clock_offset_;     ///< Nanoseconds from the camera clock to steady_clock.
+
+  // Frame memory, only used by the acquisition thread:
+  std::unique_ptr<MessagePool<wfov_camera_msgs::WFOVImage> > wfov_pool_;
+  std::unique_ptr<MessagePool<sensor_msgs::Image> > image_pool_;  ///< Copies published on image_raw.
+  MemoryCounters memory_counters_;
+  size_t frame_size_;  ///< Bytes of the last frame, reserved in the next message before the copy.
+
   /// Configuration:
   spinnaker_camera_driver::SpinnakerConfig config_;
 };
@@ -0,0 +1,300 @@
+/**
+Software License Agreement (BSD)
+
+\file      pixel_converter.cpp
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "spinnaker_camera_driver/pixel_converter.h"
+#include "spinnaker_camera_driver/bayer_pattern.h"
+
+#include <sensor_msgs/image_encodings.h>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <cctype>
+#include <string>
+#include <vector>
+
+namespace spinnaker_camera_driver
+{
+namespace
+{
+enum Layout
+{
+  MONO,
+  BAYER,
+  RGB,
+  BGR,
+  BGRA,
+  UYVY,  ///< YUV422Packed, U Y V Y.
+  YUYV   ///< YCbCr422_8, Y Cb Y Cr.
+};
+
+struct SourceFormat
+{
+  Layout layout;
+  int bits;        ///< Per sample, 8, 12 or 16.
+  bool msb_first;  ///< 12 bit samples packed the GigE Vision way.
+  int to_rgb;      ///< OpenCV conversion codes of Bayer and color formats.
+  int to_bgr;
+  int to_gray;
+};
+
+/// Parses the sample size at the end of a Mono or Bayer PixelFormat name.
+bool parseBits(const std::string& suffix, SourceFormat* format)
+{
+  format->msb_first = false;
+  if (suffix == "8")
+    format->bits = 8;
+  else if (suffix == "16")
+    format->bits = 16;
+  else if (suffix == "12p")
+    format->bits = 12;
+  else if (suffix == "12Packed")
+  {
+    format->bits = 12;
+    format->msb_first = true;
+  }
+  else
+    return false;
+  return true;
+}
+
+bool parseFormat(const std::string& name, SourceFormat* format)
+{
+  if (name.compare(0, 4, "Mono") == 0)
+  {
+    format->layout = MONO;
+    format->to_rgb = cv::COLOR_GRAY2RGB;
+    format->to_bgr = cv::COLOR_GRAY2BGR;
+    format->to_gray = -1;
+    return parseBits(name.substr(4), format);
+  }
+  if (name.compare(0, 5, "Bayer") == 0 && name.size() > 7)
+  {
+    format->layout = BAYER;
+    if (!PixelConverter::getBayerCodes(getBayerRedIndex(name), &format->to_rgb, &format->to_bgr, &format->to_gray))
+      return false;
+    return parseBits(name.substr(7), format);
+  }
+
+  format->bits = 8;
+  format->msb_first = false;
+  if (name == "RGB8Packed" || name == "RGB8")
+  {
+    format->layout = RGB;
+    format->to_rgb = -1;
+    format->to_bgr = cv::COLOR_RGB2BGR;
+    format->to_gray = cv::COLOR_RGB2GRAY;
+  }
+  else if (name == "BGR8")
+  {
+    format->layout = BGR;
+    format->to_rgb = cv::COLOR_BGR2RGB;
+    format->to_bgr = -1;
+    format->to_gray = cv::COLOR_BGR2GRAY;
+  }
+  else if (name == "BGRa8")
+  {
+    format->layout = BGRA;
+    format->to_rgb = cv::COLOR_BGRA2RGB;
+    format->to_bgr = cv::COLOR_BGRA2BGR;
+    format->to_gray = cv::COLOR_BGRA2GRAY;
+  }
+  else if (name == "YUV422Packed")
+  {
+    format->layout = UYVY;
+    format->to_rgb = cv::COLOR_YUV2RGB_UYVY;
+    format->to_bgr = cv::COLOR_YUV2BGR_UYVY;
+    format->to_gray = cv::COLOR_YUV2GRAY_UYVY;
+  }
+  else if (name == "YCbCr422_8")
+  {
+    format->layout = YUYV;
+    format->to_rgb = cv::COLOR_YUV2RGB_YUYV;
+    format->to_bgr = cv::COLOR_YUV2BGR_YUYV;
+    format->to_gray = cv::COLOR_YUV2GRAY_YUYV;
+  }
+  else
+  {
+    return false;
+  }
+  return true;
+}
+
+/// Narrows the rows of a 12 or 16 bit mono or Bayer frame to 8 bits.
+void narrowRows(const SourceFormat& format, const uint8_t* data, const uint32_t width, const uint32_t height,
+                const uint32_t stride, uint8_t* destination, const size_t destination_step)
+{
+  for (uint32_t y = 0; y < height; ++y)
+  {
+    const uint8_t* row = data + static_cast<size_t>(y) * stride;
+    uint8_t* narrowed = destination + y * destination_step;
+    if (format.bits == 16)
+      PixelConverter::narrow16(reinterpret_cast<const uint16_t*>(row), width, narrowed);
+    else
+      PixelConverter::narrow12(row, width, format.msb_first, narrowed);
+  }
+}
+}  // namespace
+
+PixelConverter::PixelConverter(const std::string& encoding) : encoding_(encoding)
+{
+}
+
+bool PixelConverter::getBayerCodes(const int red, int* to_rgb, int* to_bgr, int* to_gray)
+{
+  // OpenCV names Bayer patterns after the second row
+  switch (red)
+  {
+    case 0:
+      *to_rgb = cv::COLOR_BayerBG2RGB;
+      *to_bgr = cv::COLOR_BayerBG2BGR;
+      *to_gray = cv::COLOR_BayerBG2GRAY;
+      return true;
+    case 1:
+      *to_rgb = cv::COLOR_BayerGB2RGB;
+      *to_bgr = cv::COLOR_BayerGB2BGR;
+      *to_gray = cv::COLOR_BayerGB2GRAY;
+      return true;
+    case 2:
+      *to_rgb = cv::COLOR_BayerGR2RGB;
+      *to_bgr = cv::COLOR_BayerGR2BGR;
+      *to_gray = cv::COLOR_BayerGR2GRAY;
+      return true;
+    case 3:
+      *to_rgb = cv::COLOR_BayerRG2RGB;
+      *to_bgr = cv::COLOR_BayerRG2BGR;
+      *to_gray = cv::COLOR_BayerRG2GRAY;
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool PixelConverter::isOutputEncoding(const std::string& encoding)
+{
+  namespace enc = sensor_msgs::image_encodings;
+  return encoding == enc::MONO8 || encoding == enc::RGB8 || encoding == enc::BGR8;
+}
+
+bool PixelConverter::convert(const std::string& pixel_format, const uint8_t* data, const uint32_t width,
+                             const uint32_t height, const uint32_t stride, sensor_msgs::Image* image)
+{
+  namespace enc = sensor_msgs::image_encodings;
+  SourceFormat format;
+  if (!parseFormat(pixel_format, &format))
+    return false;
+
+  const int channels = encoding_ == enc::MONO8 ? 1 : 3;
+  image->height = height;
+  image->width = width;
+  image->encoding = encoding_;
+  image->is_bigendian = false;
+  image->step = width * channels;
+  image->data.resize(static_cast<size_t>(image->step) * height);
+  cv::Mat destination(height, width, CV_MAKETYPE(CV_8U, channels), image->data.data(), image->step);
+  const int code = channels == 1 ? format.to_gray : (encoding_ == enc::RGB8 ? format.to_rgb : format.to_bgr);
+
+  // Mono frames are narrowed straight into the message, Bayer frames have to be demosaiced from 8 bits
+  if (format.bits != 8 && format.layout == MONO && channels == 1)
+  {
+    narrowRows(format, data, width, height, stride, image->data.data(), image->step);
+    return true;
+  }
+
+  int source_channels = 3;
+  if (format.layout == MONO || format.layout == BAYER)
+    source_channels = 1;
+  else if (format.layout == UYVY || format.layout == YUYV)
+    source_channels = 2;
+  else if (format.layout == BGRA)
+    source_channels = 4;
+  cv::Mat source(height, width, CV_MAKETYPE(CV_8U, source_channels), const_cast<uint8_t*>(data), stride);
+  if (format.bits != 8)
+  {
+    narrowed_.resize(static_cast<size_t>(width) * height);
+    narrowRows(format, data, width, height, stride, narrowed_.data(), width);
+    source = cv::Mat(height, width, CV_8UC1, narrowed_.data(), width);
+  }
+
+  // The destination already has the size and type, so the conversion writes into the message
+  if (code < 0)
+    source.copyTo(destination);
+  else
+    cv::cvtColor(source, destination, code);
+  return true;
+}
+
+bool PixelConverter::convert(const sensor_msgs::Image& source, sensor_msgs::Image* image)
+{
+  namespace enc = sensor_msgs::image_encodings;
+  // PixelFormat of the camera the encoding is filled from, e.g. BayerRG16 for bayer_rggb16
+  std::string pixel_format;
+  if (source.encoding == enc::MONO8 || source.encoding == enc::MONO16)
+    pixel_format = "Mono" + source.encoding.substr(4);
+  else if (enc::isBayer(source.encoding) && source.encoding.size() > 10)
+    pixel_format = "Bayer" + std::string(1, std::toupper(source.encoding[6])) +
+                   std::string(1, std::toupper(source.encoding[7])) + source.encoding.substr(10);
+  else if (source.encoding == enc::RGB8)
+    pixel_format = "RGB8";
+  else if (source.encoding == enc::BGR8)
+    pixel_format = "BGR8";
+  else
+    return false;
+  if (source.is_bigendian && enc::bitDepth(source.encoding) == 16)
+    return false;
+  return convert(pixel_format, source.data.data(), source.width, source.height, source.step, image);
+}
+
+void PixelConverter::narrow16(const uint16_t* source, const size_t count, uint8_t* destination)
+{
+  size_t i = 0;
+#if defined(__SSE2__)
+  for (; i + 16 <= count; i += 16)
+  {
+    const __m128i low = _mm_srli_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i)), 8);
+    const __m128i high = _mm_srli_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i + 8)), 8);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), _mm_packus_epi16(low, high));
+  }
+#endif
+  for (; i < count; ++i)
+    destination[i] = static_cast<uint8_t>(source[i] >> 8);
+}
+
+void PixelConverter::narrow12(const uint8_t* source, const size_t count, const bool msb_first, uint8_t* destination)
+{
+  // Two samples a and b in three bytes, capitals are the high bits: AAAAAAAA bbbbaaaa BBBBBBBB for the Packed
+  // formats, aaaaaaaa bbbbAAAA BBBBBBBB for the p formats
+  size_t i = 0;
+  for (; i + 2 <= count; i += 2, source += 3)
+  {
+    destination[i] = msb_first ? source[0] : static_cast<uint8_t>((source[0] >> 4) | (source[1] << 4));
+    destination[i + 1] = source[2];
+  }
+  if (i < count)
+    destination[i] = msb_first ? source[0] : static_cast<uint8_t>((source[0] >> 4) | (source[1] << 4));
+}
+}  // namespace spinnaker_camera_driver
@@ -0,0 +1,337 @@
+/**
+Software License Agreement (BSD)
+
+\file      raw_compressor.cpp
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "spinnaker_camera_driver/raw_compressor.h"
+
+#include <sensor_msgs/image_encodings.h>
+
+#include <lz4.h>
+
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace spinnaker_camera_driver
+{
+namespace
+{
+const char FORMAT_SUFFIX[] = "; lz4 planar delta";
+const uint32_t MAGIC = 0x57415253;  // "SRAW"
+const uint16_t VERSION = 1;
+const size_t MAX_PLANES = 4;
+// LZ4 sizes are ints, larger frames are neither compressed nor accepted from a message
+const uint64_t MAX_IMAGE_BYTES = static_cast<uint64_t>(std::numeric_limits<int>::max());
+
+/// Stored in front of the compressed planes.
+struct RawHeader
+{
+  uint32_t magic;
+  uint16_t version;
+  uint8_t bytes_per_sample;
+  uint8_t plane_count;
+  uint32_t width;
+  uint32_t height;
+  uint32_t channels;
+  uint32_t step;
+  uint32_t plane_bytes[MAX_PLANES];  ///< Compressed size of each plane.
+};
+
+/// Where the samples of one plane are found in the image.
+struct PlaneLayout
+{
+  size_t rows;
+  size_t columns;
+  size_t first_row;
+  size_t first_column;
+  size_t stride;  ///< Distance between neighbouring samples of the plane in rows and in columns.
+};
+
+/// Bayer images have four planes of every other sample, everything else one plane of all samples.
+size_t getPlanes(const uint32_t height, const size_t samples_per_row, const bool bayer, PlaneLayout* planes)
+{
+  if (!bayer)
+  {
+    planes[0] = PlaneLayout{ height, samples_per_row, 0, 0, 1 };
+    return 1;
+  }
+  for (size_t p = 0; p < MAX_PLANES; ++p)
+  {
+    const size_t row = p / 2;
+    const size_t column = p % 2;
+    planes[p] = PlaneLayout{ (height - row + 1) / 2, (samples_per_row - column + 1) / 2, row, column, 2 };
+  }
+  return MAX_PLANES;
+}
+
+template <typename T>
+T readSample(const uint8_t* data, const bool big_endian)
+{
+  if (sizeof(T) == 1)
+    return data[0];
+  return big_endian ? static_cast<T>(data[0] << 8 | data[1]) : static_cast<T>(data[1] << 8 | data[0]);
+}
+
+template <typename T>
+void writeSample(uint8_t* data, const T value, const bool big_endian)
+{
+  if (sizeof(T) == 1)
+  {
+    data[0] = static_cast<uint8_t>(value);
+    return;
+  }
+  data[big_endian ? 1 : 0] = static_cast<uint8_t>(value);
+  data[big_endian ? 0 : 1] = static_cast<uint8_t>(value >> 8);
+}
+
+/*
+ * Residuals against the left neighbour, or the first sample of the previous row at the start of a row. They are
+ * zigzag coded so that small negative and positive values both become small numbers, and for 16 bit samples the low
+ * and high bytes go to separate halves of the buffer, which leaves LZ4 long runs of zero high bytes.
+ */
+template <typename T, typename S>
+void predict(const sensor_msgs::Image& image, const PlaneLayout& plane, std::vector<uint8_t>* residuals)
+{
+  const size_t count = plane.rows * plane.columns;
+  residuals->resize(count * sizeof(T));
+  const bool big_endian = image.is_bigendian;
+  T row_start = 0;
+  size_t index = 0;
+  for (size_t r = 0; r < plane.rows; ++r)
+  {
+    const uint8_t* row = image.data.data() + (plane.first_row + r * plane.stride) * image.step;
+    T previous = row_start;
+    for (size_t c = 0; c < plane.columns; ++c, ++index)
+    {
+      const T value = readSample<T>(row + (plane.first_column + c * plane.stride) * sizeof(T), big_endian);
+      const S delta = static_cast<S>(value - previous);
+      const T zigzag = static_cast<T>((static_cast<T>(delta) << 1) ^ static_cast<T>(delta >> (sizeof(T) * 8 - 1)));
+      (*residuals)[index] = static_cast<uint8_t>(zigzag);
+      if (sizeof(T) == 2)
+        (*residuals)[count + index] = static_cast<uint8_t>(zigzag >> 8);
+      if (c == 0)
+        row_start = value;
+      previous = value;
+    }
+  }
+}
+
+template <typename T, typename S>
+void reconstruct(const std::vector<uint8_t>& residuals, const PlaneLayout& plane, sensor_msgs::Image* image)
+{
+  const size_t count = plane.rows * plane.columns;
+  const bool big_endian = image->is_bigendian;
+  T row_start = 0;
+  size_t index = 0;
+  for (size_t r = 0; r < plane.rows; ++r)
+  {
+    uint8_t* row = image->data.data() + (plane.first_row + r * plane.stride) * image->step;
+    T previous = row_start;
+    for (size_t c = 0; c < plane.columns; ++c, ++index)
+    {
+      T zigzag = residuals[index];
+      if (sizeof(T) == 2)
+        zigzag = static_cast<T>(zigzag | residuals[count + index] << 8);
+      const T delta = static_cast<T>((zigzag >> 1) ^ static_cast<T>(-(zigzag & 1)));
+      const T value = static_cast<T>(previous + delta);
+      writeSample<T>(row + (plane.first_column + c * plane.stride) * sizeof(T), value, big_endian);
+      if (c == 0)
+        row_start = value;
+      previous = value;
+    }
+  }
+}
+}  // namespace
+
+RawCompressor::RawCompressor(ros::NodeHandle& nh, const size_t threads, const size_t queue_size,
+                             const int acceleration)
+  : pub_(nh.advertise<sensor_msgs::CompressedImage>("compressed_raw", 5))
+  , acceleration_(acceleration)
+  , next_submit_(0)
+  , next_publish_(0)
+  , dropped_(0)
+  , pool_(new WorkerPool(threads, queue_size, "RawCompressor"))
+{
+}
+
+RawCompressor::~RawCompressor()
+{
+  // Let the workers finish the queued frames while the publisher is still valid.
+  pool_.reset();
+}
+
+bool RawCompressor::publish(const sensor_msgs::ImageConstPtr& image)
+{
+  const uint64_t sequence = next_submit_;
+  const int acceleration = acceleration_;
+  const bool queued = pool_->trySubmit([this, image, sequence, acceleration]() {
+    sensor_msgs::CompressedImagePtr compressed(new sensor_msgs::CompressedImage);
+    if (!compress(*image, acceleration, compressed.get()))
+    {
+      ROS_WARN_THROTTLE(10, "[RawCompressor]: Unable to compress %s images.", image->encoding.c_str());
+      compressed.reset();
+    }
+    finish(sequence, compressed);
+  });
+
+  if (!queued)
+  {
+    ++dropped_;
+    ROS_DEBUG_THROTTLE(1, "[RawCompressor]: All workers busy, dropped a frame.");
+    return false;
+  }
+  ++next_submit_;
+  return true;
+}
+
+void RawCompressor::finish(const uint64_t sequence, const sensor_msgs::CompressedImagePtr& compressed)
+{
+  std::unique_lock<std::mutex> lock(order_mutex_);
+  order_cv_.wait(lock, [this, sequence] { return next_publish_ == sequence; });
+  if (compressed)
+    pub_.publish(compressed);
+  ++next_publish_;
+  order_cv_.notify_all();
+}
+
+bool RawCompressor::compress(const sensor_msgs::Image& image, const int acceleration,
+                             sensor_msgs::CompressedImage* compressed)
+{
+  namespace enc = sensor_msgs::image_encodings;
+  if (!enc::isBayer(image.encoding) && !enc::isMono(image.encoding) && !enc::isColor(image.encoding))
+    return false;
+  const int bit_depth = enc::bitDepth(image.encoding);
+  if (bit_depth != 8 && bit_depth != 16)
+    return false;
+
+  RawHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.magic = MAGIC;
+  header.version = VERSION;
+  header.bytes_per_sample = static_cast<uint8_t>(bit_depth / 8);
+  header.width = image.width;
+  header.height = image.height;
+  header.channels = static_cast<uint32_t>(enc::numChannels(image.encoding));
+  header.step = image.step;
+  const uint64_t image_bytes = static_cast<uint64_t>(image.step) * image.height;
+  if (image_bytes > MAX_IMAGE_BYTES || image.data.size() < image_bytes ||
+      image.step < static_cast<uint64_t>(image.width) * header.channels * header.bytes_per_sample)
+    return false;
+
+  PlaneLayout planes[MAX_PLANES];
+  header.plane_count = static_cast<uint8_t>(
+      getPlanes(image.height, static_cast<size_t>(image.width) * header.channels, enc::isBayer(image.encoding), planes));
+
+  compressed->header = image.header;
+  compressed->format = image.encoding + FORMAT_SUFFIX;
+
+  size_t bound = sizeof(header);
+  for (size_t p = 0; p < header.plane_count; ++p)
+    bound += LZ4_compressBound(static_cast<int>(planes[p].rows * planes[p].columns * header.bytes_per_sample));
+  compressed->data.resize(bound);
+
+  std::vector<uint8_t> residuals;
+  size_t offset = sizeof(header);
+  for (size_t p = 0; p < header.plane_count; ++p)
+  {
+    if (header.bytes_per_sample == 1)
+      predict<uint8_t, int8_t>(image, planes[p], &residuals);
+    else
+      predict<uint16_t, int16_t>(image, planes[p], &residuals);
+
+    const int size = LZ4_compress_fast(reinterpret_cast<const char*>(residuals.data()),
+                                       reinterpret_cast<char*>(compressed->data.data() + offset),
+                                       static_cast<int>(residuals.size()), static_cast<int>(bound - offset),
+                                       acceleration);
+    if (size <= 0 && !residuals.empty())
+      return false;
+    header.plane_bytes[p] = static_cast<uint32_t>(size);
+    offset += size;
+  }
+
+  std::memcpy(compressed->data.data(), &header, sizeof(header));
+  compressed->data.resize(offset);
+  return true;
+}
+
+bool RawCompressor::decompress(const sensor_msgs::CompressedImage& compressed, sensor_msgs::Image* image)
+{
+  namespace enc = sensor_msgs::image_encodings;
+  const size_t suffix = compressed.format.rfind(FORMAT_SUFFIX);
+  if (suffix == std::string::npos || compressed.data.size() < sizeof(RawHeader))
+    return false;
+
+  RawHeader header;
+  std::memcpy(&header, compressed.data.data(), sizeof(header));
+  if (header.magic != MAGIC || header.version != VERSION || header.plane_count > MAX_PLANES ||
+      (header.bytes_per_sample != 1 && header.bytes_per_sample != 2))
+    return false;
+
+  // The header comes from the network, the rows it describes must fit the image it allocates
+  const std::string encoding = compressed.format.substr(0, suffix);
+  if (!enc::isBayer(encoding) && !enc::isMono(encoding) && !enc::isColor(encoding))
+    return false;
+  if (enc::bitDepth(encoding) != header.bytes_per_sample * 8 ||
+      static_cast<uint32_t>(enc::numChannels(encoding)) != header.channels)
+    return false;
+  const uint64_t image_bytes = static_cast<uint64_t>(header.step) * header.height;
+  if (image_bytes > MAX_IMAGE_BYTES ||
+      header.step < static_cast<uint64_t>(header.width) * header.channels * header.bytes_per_sample)
+    return false;
+
+  PlaneLayout planes[MAX_PLANES];
+  const size_t plane_count = getPlanes(header.height, static_cast<size_t>(header.width) * header.channels,
+                                       enc::isBayer(encoding), planes);
+  if (plane_count != header.plane_count)
+    return false;
+
+  image->header = compressed.header;
+  image->encoding = encoding;
+  image->width = header.width;
+  image->height = header.height;
+  image->step = header.step;
+  image->is_bigendian = false;
+  image->data.assign(static_cast<size_t>(image_bytes), 0);
+
+  std::vector<uint8_t> residuals;
+  size_t offset = sizeof(header);
+  for (size_t p = 0; p < plane_count; ++p)
+  {
+    if (offset + header.plane_bytes[p] > compressed.data.size())
+      return false;
+    residuals.resize(planes[p].rows * planes[p].columns * header.bytes_per_sample);
+    const int size = LZ4_decompress_safe(reinterpret_cast<const char*>(compressed.data.data() + offset),
+                                         reinterpret_cast<char*>(residuals.data()),
+                                         static_cast<int>(header.plane_bytes[p]), static_cast<int>(residuals.size()));
+    if (size != static_cast<int>(residuals.size()))
+      return false;
+    offset += header.plane_bytes[p];
+
+    if (header.bytes_per_sample == 1)
+      reconstruct<uint8_t, int8_t>(residuals, planes[p], image);
+    else
+      reconstruct<uint16_t, int16_t>(residuals, planes[p], image);
+  }
+  return true;
+}
+}  // namespace spinnaker_camera_driver
@@ -0,0 +1,170 @@
+/**
+Software License Agreement (BSD)
+
+\file      rectifier.cpp
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "spinnaker_camera_driver/rectifier.h"
+#include "spinnaker_camera_driver/bayer_pattern.h"
+#include "spinnaker_camera_driver/pixel_converter.h"
+
+#include <sensor_msgs/image_encodings.h>
+
+#include <opencv2/calib3d/calib3d.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <algorithm>
+#include <string>
+
+namespace spinnaker_camera_driver
+{
+namespace
+{
+bool sameCalibration(const sensor_msgs::CameraInfo& a, const sensor_msgs::CameraInfo& b)
+{
+  return a.width == b.width && a.height == b.height && a.distortion_model == b.distortion_model && a.D == b.D &&
+         a.K == b.K && a.R == b.R && a.P == b.P && a.binning_x == b.binning_x && a.binning_y == b.binning_y &&
+         a.roi.x_offset == b.roi.x_offset && a.roi.y_offset == b.roi.y_offset;
+}
+}  // namespace
+
+Rectifier::Rectifier(ros::NodeHandle& nh)
+  : it_(nh), mono_pub_(it_.advertise("image_rect", 5)), color_pub_(it_.advertise("image_rect_color", 5))
+{
+}
+
+bool Rectifier::updateMaps(const sensor_msgs::CameraInfo& info, const cv::Size& size)
+{
+  if (!map_xy_.empty() && size == maps_size_ && sameCalibration(info, maps_info_))
+    return true;
+  map_xy_.release();
+  map_fraction_.release();
+  if (info.K[0] == 0.0)
+  {
+    ROS_WARN_ONCE("[Rectifier]: The camera is not calibrated, not publishing rectified images.");
+    return false;
+  }
+
+  // The calibration is for the full sensor, the image is binned and then cropped to the ROI
+  const double scale_x = 1.0 / std::max<uint32_t>(1, info.binning_x);
+  const double scale_y = 1.0 / std::max<uint32_t>(1, info.binning_y);
+  cv::Matx33d K(&info.K[0]);
+  cv::Matx34d P(&info.P[0]);
+  for (int c = 0; c < 3; ++c)
+  {
+    K(0, c) *= scale_x;
+    K(1, c) *= scale_y;
+  }
+  for (int c = 0; c < 4; ++c)
+  {
+    P(0, c) *= scale_x;
+    P(1, c) *= scale_y;
+  }
+  K(0, 2) -= info.roi.x_offset;
+  K(1, 2) -= info.roi.y_offset;
+  P(0, 2) -= info.roi.x_offset;
+  P(1, 2) -= info.roi.y_offset;
+  const cv::Matx33d R(&info.R[0]);
+  const cv::Mat D(info.D, true);
+
+  // Fixed point tables: integer coordinates and an index into the interpolation weights of the fraction
+  if (info.distortion_model == "equidistant")
+    cv::fisheye::initUndistortRectifyMap(K, D, R, P.get_minor<3, 3>(0, 0), size, CV_16SC2, map_xy_, map_fraction_);
+  else
+    cv::initUndistortRectifyMap(K, D, R, P, size, CV_16SC2, map_xy_, map_fraction_);
+  maps_info_ = info;
+  maps_size_ = size;
+  ROS_INFO("[Rectifier]: Built %dx%d remap tables.", size.width, size.height);
+  return true;
+}
+
+sensor_msgs::ImagePtr Rectifier::remap(const cv::Mat& source, const std_msgs::Header& header,
+                                       const std::string& encoding)
+{
+  sensor_msgs::ImagePtr rectified(new sensor_msgs::Image);
+  rectified->header = header;
+  rectified->height = source.rows;
+  rectified->width = source.cols;
+  rectified->encoding = encoding;
+  rectified->is_bigendian = false;
+  rectified->step = source.cols * source.elemSize();
+  rectified->data.resize(rectified->step * rectified->height);
+  // Write straight into the message
+  cv::Mat destination(source.rows, source.cols, source.type(), rectified->data.data(), rectified->step);
+  cv::remap(source, destination, map_xy_, map_fraction_, cv::INTER_LINEAR, cv::BORDER_CONSTANT);
+  return rectified;
+}
+
+void Rectifier::publish(const sensor_msgs::Image& image, const sensor_msgs::CameraInfo& info)
+{
+  namespace enc = sensor_msgs::image_encodings;
+  const int bit_depth = enc::bitDepth(image.encoding);
+  const int channels = enc::numChannels(image.encoding);
+  if ((bit_depth != 8 && bit_depth != 16) || (bit_depth == 16 && image.is_bigendian) ||
+      image.data.size() < static_cast<size_t>(image.step) * image.height)
+  {
+    ROS_WARN_ONCE("[Rectifier]: Encoding %s is not supported.", image.encoding.c_str());
+    return;
+  }
+  if (!updateMaps(info, cv::Size(image.width, image.height)))
+    return;
+
+  // Wrap the grab buffer instead of copying it
+  const int depth = bit_depth == 8 ? CV_8U : CV_16U;
+  const cv::Mat raw(image.height, image.width, CV_MAKETYPE(depth, channels), const_cast<uint8_t*>(image.data.data()),
+                    image.step);
+  const std::string mono_encoding = bit_depth == 8 ? enc::MONO8 : enc::MONO16;
+  const std::string color_encoding = bit_depth == 8 ? enc::BGR8 : enc::BGR16;
+  int to_rgb;
+  int to_color;
+  int to_gray;
+  if (PixelConverter::getBayerCodes(getBayerRedIndex(image.encoding), &to_rgb, &to_color, &to_gray))
+  {
+    if (mono_pub_.getNumSubscribers() > 0)
+    {
+      cv::cvtColor(raw, gray_, to_gray);
+      mono_pub_.publish(remap(gray_, image.header, mono_encoding));
+    }
+    if (color_pub_.getNumSubscribers() > 0)
+    {
+      cv::cvtColor(raw, demosaiced_, to_color);
+      color_pub_.publish(remap(demosaiced_, image.header, color_encoding));
+    }
+  }
+  else if (enc::isMono(image.encoding))
+  {
+    if (mono_pub_.getNumSubscribers() > 0)
+      mono_pub_.publish(remap(raw, image.header, image.encoding));
+  }
+  else if (channels == 3 || channels == 4)
+  {
+    if (mono_pub_.getNumSubscribers() > 0)
+    {
+      const bool rgb = image.encoding == enc::RGB8 || image.encoding == enc::RGB16 || image.encoding == enc::RGBA8 ||
+                       image.encoding == enc::RGBA16;
+      cv::cvtColor(raw, gray_, channels == 3 ? (rgb ? cv::COLOR_RGB2GRAY : cv::COLOR_BGR2GRAY) :
+                                               (rgb ? cv::COLOR_RGBA2GRAY : cv::COLOR_BGRA2GRAY));
+      mono_pub_.publish(remap(gray_, image.header, mono_encoding));
+    }
+    if (color_pub_.getNumSubscribers() > 0)
+      color_pub_.publish(remap(raw, image.header, image.encoding));
+  }
+}
+}  // namespace spinnaker_camera_driver
@@ -0,0 +1,215 @@
+/**
+Software License Agreement (BSD)
+
+\file      roi_streamer.cpp
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "spinnaker_camera_driver/roi_streamer.h"
+
+#include <sensor_msgs/image_encodings.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace spinnaker_camera_driver
+{
+/// Bytes per pixel of encoding, false for unknown encodings and for pixels that share bytes, e.g. UYVY.
+static bool getPixelSize(const std::string& encoding, size_t* pixel_size)
+{
+  namespace enc = sensor_msgs::image_encodings;
+  // yuv422 and yuv422_yuy2 share the chroma of pixel pairs
+  if (encoding.compare(0, 6, "yuv422") == 0)
+    return false;
+  int bits;
+  try
+  {
+    bits = enc::bitDepth(encoding) * enc::numChannels(encoding);
+  }
+  catch (const std::runtime_error&)
+  {
+    return false;
+  }
+  if (bits <= 0 || bits % 8 != 0)
+    return false;
+  *pixel_size = static_cast<size_t>(bits / 8);
+  return true;
+}
+
+static bool readUnsigned(XmlRpc::XmlRpcValue& entry, const std::string& key, uint32_t* value)
+{
+  if (!entry.hasMember(key))
+    return false;
+  if (entry[key].getType() != XmlRpc::XmlRpcValue::TypeInt || static_cast<int>(entry[key]) < 0)
+    return false;
+  *value = static_cast<int>(entry[key]);
+  return true;
+}
+
+RoiStreamer::RoiStreamer(ros::NodeHandle& nh, const std::vector<Roi>& rois) : it_(nh), streams_(rois.size())
+{
+  for (size_t i = 0; i < rois.size(); ++i)
+  {
+    Stream& stream = streams_[i];
+    stream.roi = rois[i];
+    stream.pub = it_.advertiseCamera("roi/" + rois[i].name + "/image_raw", 5);
+    stream.sub = nh.subscribe<sensor_msgs::RegionOfInterest>(
+        "roi/" + rois[i].name + "/set_roi", 1, boost::bind(&RoiStreamer::setRoiCb, this, _1, i));
+    ROS_INFO("[RoiStreamer]: ROI %s at %u,%u size %ux%u.", rois[i].name.c_str(), rois[i].x_offset, rois[i].y_offset,
+             rois[i].width, rois[i].height);
+  }
+}
+
+bool RoiStreamer::loadRois(const ros::NodeHandle& pnh, const std::string& param, std::vector<Roi>* rois)
+{
+  XmlRpc::XmlRpcValue list;
+  if (!pnh.getParam(param, list) || list.getType() != XmlRpc::XmlRpcValue::TypeArray)
+    return false;
+
+  rois->clear();
+  for (int i = 0; i < list.size(); ++i)
+  {
+    XmlRpc::XmlRpcValue& entry = list[i];
+    Roi roi;
+    if (entry.getType() != XmlRpc::XmlRpcValue::TypeStruct || !entry.hasMember("name") ||
+        entry["name"].getType() != XmlRpc::XmlRpcValue::TypeString || !readUnsigned(entry, "x_offset", &roi.x_offset) ||
+        !readUnsigned(entry, "y_offset", &roi.y_offset) || !readUnsigned(entry, "width", &roi.width) ||
+        !readUnsigned(entry, "height", &roi.height))
+    {
+      ROS_ERROR("[RoiStreamer]: Entry %d of %s needs a name, x_offset, y_offset, width and height.", i, param.c_str());
+      return false;
+    }
+    roi.name = static_cast<std::string>(entry["name"]);
+    roi.rate = 0.0;
+    if (entry.hasMember("rate"))
+    {
+      if (entry["rate"].getType() == XmlRpc::XmlRpcValue::TypeDouble)
+        roi.rate = static_cast<double>(entry["rate"]);
+      else if (entry["rate"].getType() == XmlRpc::XmlRpcValue::TypeInt)
+        roi.rate = static_cast<int>(entry["rate"]);
+    }
+    rois->push_back(roi);
+  }
+  return true;
+}
+
+void RoiStreamer::setRoiCb(const sensor_msgs::RegionOfInterestConstPtr& msg, const size_t index)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  Roi& roi = streams_[index].roi;
+  roi.x_offset = msg->x_offset;
+  roi.y_offset = msg->y_offset;
+  roi.width = msg->width;
+  roi.height = msg->height;
+  ROS_INFO("[RoiStreamer]: Moved ROI %s to %u,%u size %ux%u.", roi.name.c_str(), roi.x_offset, roi.y_offset,
+           roi.width, roi.height);
+}
+
+bool RoiStreamer::clip(const Roi& roi, const sensor_msgs::Image& image, Roi* clipped)
+{
+  *clipped = roi;
+  if (roi.x_offset >= image.width || roi.y_offset >= image.height)
+    return false;
+
+  clipped->width = roi.width == 0 ? image.width - roi.x_offset : std::min(roi.width, image.width - roi.x_offset);
+  clipped->height = roi.height == 0 ? image.height - roi.y_offset : std::min(roi.height, image.height - roi.y_offset);
+
+  // Keep the color filter phase of the crop identical to the full frame by cutting on 2x2 boundaries.
+  if (sensor_msgs::image_encodings::isBayer(image.encoding))
+  {
+    clipped->x_offset &= ~1u;
+    clipped->y_offset &= ~1u;
+    clipped->width &= ~1u;
+    clipped->height &= ~1u;
+  }
+  return clipped->width > 0 && clipped->height > 0;
+}
+
+void RoiStreamer::publish(const sensor_msgs::Image& image, const sensor_msgs::CameraInfo& info)
+{
+  if (image.width == 0 || image.height == 0)
+    return;
+  size_t pixel_size;
+  if (!getPixelSize(image.encoding, &pixel_size))
+  {
+    ROS_WARN_THROTTLE(10, "[RoiStreamer]: Cannot crop %s images.", image.encoding.c_str());
+    return;
+  }
+  if (image.step < image.width * pixel_size || image.data.size() < static_cast<size_t>(image.step) * image.height)
+  {
+    ROS_WARN_THROTTLE(10, "[RoiStreamer]: %ux%u %s image with a step of %u does not fit its data.", image.width,
+                      image.height, image.encoding.c_str(), image.step);
+    return;
+  }
+
+  for (size_t i = 0; i < streams_.size(); ++i)
+  {
+    Stream& stream = streams_[i];
+    if (stream.pub.getNumSubscribers() == 0)
+      continue;
+    if (stream.roi.rate > 0.0 && !stream.last_publish.isZero() &&
+        (image.header.stamp - stream.last_publish).toSec() < 1.0 / stream.roi.rate)
+      continue;
+
+    Roi crop;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!clip(stream.roi, image, &crop))
+      {
+        ROS_WARN_THROTTLE(10, "[RoiStreamer]: ROI %s lies outside of the %ux%u image.", stream.roi.name.c_str(),
+                          image.width, image.height);
+        continue;
+      }
+    }
+
+    sensor_msgs::ImagePtr out(new sensor_msgs::Image);
+    out->header = image.header;
+    out->encoding = image.encoding;
+    out->is_bigendian = image.is_bigendian;
+    out->width = crop.width;
+    out->height = crop.height;
+    out->step = crop.width * pixel_size;
+    out->data.resize(static_cast<size_t>(out->step) * out->height);
+
+    const uint8_t* src = image.data.data() + crop.y_offset * image.step + crop.x_offset * pixel_size;
+    uint8_t* dst = out->data.data();
+    for (uint32_t row = 0; row < crop.height; ++row)
+    {
+      std::memcpy(dst, src, out->step);
+      src += image.step;
+      dst += out->step;
+    }
+
+    // The driver fills the CameraInfo ROI in the binned frame (see the nodelet and the Rectifier), so the crop offsets
+    // add to it without scaling.
+    sensor_msgs::CameraInfoPtr out_info(new sensor_msgs::CameraInfo(info));
+    out_info->roi.x_offset = info.roi.x_offset + crop.x_offset;
+    out_info->roi.y_offset = info.roi.y_offset + crop.y_offset;
+    out_info->roi.width = crop.width;
+    out_info->roi.height = crop.height;
+    out_info->roi.do_rectify = true;
+
+    stream.pub.publish(out, out_info);
+    stream.last_publish = image.header.stamp;
+  }
+}
+}  // namespace spinnaker_camera_driver
@@ -0,0 +1,685 @@
+/**
+Software License Agreement (BSD)
+
+\file      sensor_correction.cpp
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "spinnaker_camera_driver/sensor_correction.h"
+#include "spinnaker_camera_driver/sse2_pack.h"
+
+#include <ros/package.h>
+#include <sensor_msgs/image_encodings.h>
+#include <sys/stat.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace spinnaker_camera_driver
+{
+const int SensorCorrection::GAIN_BITS;
+const uint16_t SensorCorrection::UNIT_GAIN;
+const uint16_t SensorCorrection::MAX_GAIN;
+
+namespace
+{
+/// Alignment of the maps, one cache line.
+const size_t MAP_ALIGNMENT = 64;
+/// Hot pixels exceed the dark level of their neighbours by this fraction of the full scale.
+const double HOT_PIXEL_THRESHOLD = 0.02;
+/// Dead or stuck pixels respond this much more or less to uniform light than their neighbours.
+const double FLAT_DEFECT_THRESHOLD = 0.3;
+
+#if defined(__SSE2__)
+/// Subtracts the dark level from 8 samples and applies the gain, saturating at 16 bit.
+inline __m128i correct8(const __m128i samples, const __m128i dark, const __m128i gain)
+{
+  const __m128i signal = _mm_subs_epu16(samples, dark);
+  const __m128i low = _mm_mullo_epi16(signal, gain);
+  const __m128i high = _mm_mulhi_epu16(signal, gain);
+  const __m128i round = _mm_set1_epi32(1 << (SensorCorrection::GAIN_BITS - 1));
+  const __m128i max = _mm_set1_epi32(0xFFFF);
+  __m128i products[2] = { _mm_unpacklo_epi16(low, high), _mm_unpackhi_epi16(low, high) };
+  for (int k = 0; k < 2; ++k)
+  {
+    products[k] = _mm_srli_epi32(_mm_add_epi32(products[k], round), SensorCorrection::GAIN_BITS);
+    const __m128i over = _mm_cmpgt_epi32(products[k], max);
+    products[k] = _mm_or_si128(_mm_andnot_si128(over, products[k]), _mm_and_si128(over, max));
+  }
+  return packUnsigned16(products[0], products[1]);
+}
+
+inline __m128i load8(const uint16_t* in)
+{
+  return _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+}
+#endif
+
+inline uint32_t correctSample(const uint32_t sample, const uint16_t dark, const uint16_t gain)
+{
+  const uint32_t signal = sample > dark ? sample - dark : 0;
+  return (signal * gain + (1 << (SensorCorrection::GAIN_BITS - 1))) >> SensorCorrection::GAIN_BITS;
+}
+
+void correctSamples(uint16_t* samples, const uint16_t* dark, const uint16_t* gain, const size_t count)
+{
+  size_t i = 0;
+#if defined(__SSE2__)
+  for (; i + 8 <= count; i += 8)
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(samples + i),
+                     correct8(load8(samples + i), load8(dark + i), load8(gain + i)));
+#endif
+  for (; i < count; ++i)
+    samples[i] = static_cast<uint16_t>(std::min<uint32_t>(correctSample(samples[i], dark[i], gain[i]), 0xFFFF));
+}
+
+void correctSamples(uint8_t* samples, const uint16_t* dark, const uint16_t* gain, const size_t count)
+{
+  size_t i = 0;
+#if defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 16 <= count; i += 16)
+  {
+    const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i));
+    // Gains below 8 keep 8 bit samples below 2^11, so the signed pack saturates them correctly
+    const __m128i low = correct8(_mm_unpacklo_epi8(in, zero), load8(dark + i), load8(gain + i));
+    const __m128i high = correct8(_mm_unpackhi_epi8(in, zero), load8(dark + i + 8), load8(gain + i + 8));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(samples + i), _mm_packus_epi16(low, high));
+  }
+#endif
+  for (; i < count; ++i)
+    samples[i] = static_cast<uint8_t>(std::min<uint32_t>(correctSample(samples[i], dark[i], gain[i]), 0xFF));
+}
+
+/// Median of the neighbours of the same color left, right, above and below, -1 if there are none.
+double neighbourMedian(const uint16_t* map, const uint32_t width, const uint32_t height, const uint32_t x,
+                       const uint32_t y, const uint32_t stride)
+{
+  double values[4];
+  int count = 0;
+  if (x >= stride)
+    values[count++] = map[y * width + x - stride];
+  if (x + stride < width)
+    values[count++] = map[y * width + x + stride];
+  if (y >= stride)
+    values[count++] = map[(y - stride) * width + x];
+  if (y + stride < height)
+    values[count++] = map[(y + stride) * width + x];
+  if (count == 0)
+    return -1.0;
+  // Robust against a defective neighbour as long as there are at least three
+  std::sort(values, values + count);
+  return count % 2 == 1 ? values[count / 2] : 0.5 * (values[count / 2 - 1] + values[count / 2]);
+}
+
+template <typename T>
+void replaceSamples(sensor_msgs::Image* image, const std::vector<uint32_t>& defects, const uint32_t stride)
+{
+  const uint32_t width = image->width;
+  const uint32_t height = image->height;
+  for (size_t d = 0; d < defects.size(); ++d)
+  {
+    const uint32_t x = defects[d] % width;
+    const uint32_t y = defects[d] / width;
+    const uint32_t neighbours[4][2] = {
+      { x - stride, y }, { x + stride, y }, { x, y - stride }, { x, y + stride }
+    };
+    uint32_t sum = 0;
+    uint32_t count = 0;
+    for (int n = 0; n < 4; ++n)
+    {
+      // Coordinates below 0 wrap around and fail the bounds check as well
+      const uint32_t nx = neighbours[n][0];
+      const uint32_t ny = neighbours[n][1];
+      if (nx >= width || ny >= height || std::binary_search(defects.begin(), defects.end(), ny * width + nx))
+        continue;
+      sum += reinterpret_cast<const T*>(&image->data[ny * image->step])[nx];
+      ++count;
+    }
+    if (count > 0)
+      reinterpret_cast<T*>(&image->data[y * image->step])[x] = static_cast<T>((sum + count / 2) / count);
+  }
+}
+
+bool fileExists(const std::string& path)
+{
+  struct stat info;
+  return stat(path.c_str(), &info) == 0;
+}
+
+/// Reads a binary PGM, 16 bit samples are big endian.
+bool readPgm(const std::string& path, uint32_t* width, uint32_t* height, uint32_t* max_value,
+             std::vector<uint16_t>* values)
+{
+  std::ifstream file(path.c_str(), std::ios::binary);
+  std::string magic;
+  file >> magic;
+  uint32_t header[3];
+  for (int i = 0; i < 3 && file; ++i)
+  {
+    // Skip comments between the header fields
+    while (file >> std::ws && file.peek() == '#')
+      file.ignore(1 << 16, '\n');
+    file >> header[i];
+  }
+  if (!file || magic != "P5" || header[2] == 0 || header[2] > 0xFFFF)
+    return false;
+  file.get();
+  *width = header[0];
+  *height = header[1];
+  *max_value = header[2];
+  const size_t sample_size = *max_value > 0xFF ? 2 : 1;
+  std::vector<uint8_t> data(static_cast<size_t>(*width) * *height * sample_size);
+  if (!file.read(reinterpret_cast<char*>(data.data()), data.size()))
+    return false;
+  values->resize(static_cast<size_t>(*width) * *height);
+  for (size_t i = 0; i < values->size(); ++i)
+    (*values)[i] = sample_size == 2 ? static_cast<uint16_t>(data[2 * i] << 8 | data[2 * i + 1]) : data[i];
+  return true;
+}
+
+/// Writes a binary PGM through a temporary file, so that readers never see a partial map.
+bool writePgm(const std::string& path, const uint32_t width, const uint32_t height, const uint32_t max_value,
+              const uint16_t* values, const std::string& comment)
+{
+  const size_t count = static_cast<size_t>(width) * height;
+  const size_t sample_size = max_value > 0xFF ? 2 : 1;
+  std::vector<uint8_t> data(count * sample_size);
+  for (size_t i = 0; i < count; ++i)
+  {
+    if (sample_size == 2)
+    {
+      data[2 * i] = static_cast<uint8_t>(values[i] >> 8);
+      data[2 * i + 1] = static_cast<uint8_t>(values[i]);
+    }
+    else
+    {
+      data[i] = static_cast<uint8_t>(values[i]);
+    }
+  }
+  const std::string temporary = path + ".tmp";
+  {
+    std::ofstream file(temporary.c_str(), std::ios::binary);
+    file << "P5\n# " << comment << "\n" << width << " " << height << "\n" << max_value << "\n";
+    file.write(reinterpret_cast<const char*>(data.data()), data.size());
+    if (!file)
+      return false;
+  }
+  return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+}  // namespace
+
+SensorCorrection::SensorCorrection(const std::string& directory, const std::string& serial)
+  : directory_(directory)
+  , serial_(serial)
+  , width_(0)
+  , height_(0)
+  , bit_depth_(0)
+  , has_dark_(false)
+  , has_flat_(false)
+  , building_(false)
+  , build_frames_(0)
+{
+}
+
+std::string SensorCorrection::directoryOf(const std::string& camera_info_url)
+{
+  std::string path;
+  if (camera_info_url.compare(0, 7, "file://") == 0)
+  {
+    path = camera_info_url.substr(7);
+  }
+  else if (camera_info_url.compare(0, 10, "package://") == 0)
+  {
+    const size_t slash = camera_info_url.find('/', 10);
+    const std::string package = ros::package::getPath(camera_info_url.substr(10, slash - 10));
+    if (slash != std::string::npos && !package.empty())
+      path = package + camera_info_url.substr(slash);
+  }
+  const size_t slash = path.rfind('/');
+  if (slash != std::string::npos && slash > 0 && path.find("${") == std::string::npos)
+    return path.substr(0, slash);
+
+  const char* ros_home = std::getenv("ROS_HOME");
+  const char* home = std::getenv("HOME");
+  return (ros_home ? std::string(ros_home) : std::string(home ? home : ".") + "/.ros") + "/camera_info";
+}
+
+bool SensorCorrection::parseMap(const std::string& name, Map* map)
+{
+  if (name == "dark")
+    *map = DARK;
+  else if (name == "flat")
+    *map = FLAT;
+  else
+    return false;
+  return true;
+}
+
+SensorCorrection::AlignedMap SensorCorrection::allocate(const size_t count, const uint16_t value)
+{
+  void* memory = NULL;
+  // Rounded up to whole vectors so that the kernels may read a row end as a full vector
+  if (posix_memalign(&memory, MAP_ALIGNMENT, (count + 8) * sizeof(uint16_t)) != 0)
+    throw std::bad_alloc();
+  AlignedMap map(static_cast<uint16_t*>(memory));
+  std::fill(map.get(), map.get() + count + 8, value);
+  return map;
+}
+
+std::string SensorCorrection::path(const std::string& suffix) const
+{
+  return directory_ + "/" + serial_ + suffix;
+}
+
+bool SensorCorrection::load()
+{
+  std::lock_guard<std::mutex> scopedLock(mutex_);
+  has_dark_ = false;
+  has_flat_ = false;
+  dark_.reset();
+  gain_.reset();
+  defects_.clear();
+  width_ = 0;
+  height_ = 0;
+
+  bool success = true;
+  uint32_t width;
+  uint32_t height;
+  uint32_t max_value;
+  std::vector<uint16_t> values;
+  if (fileExists(path("_dark.pgm")))
+  {
+    if (readPgm(path("_dark.pgm"), &width, &height, &max_value, &values) && (max_value == 0xFF || max_value == 0xFFFF))
+    {
+      width_ = width;
+      height_ = height;
+      bit_depth_ = max_value == 0xFF ? 8 : 16;
+      dark_ = allocate(values.size(), 0);
+      std::copy(values.begin(), values.end(), dark_.get());
+      has_dark_ = true;
+    }
+    else
+    {
+      ROS_ERROR("[SensorCorrection]: Unable to read the dark map %s.", path("_dark.pgm").c_str());
+      success = false;
+    }
+  }
+  if (fileExists(path("_flat.pgm")))
+  {
+    if (readPgm(path("_flat.pgm"), &width, &height, &max_value, &values) &&
+        (!has_dark_ || (width == width_ && height == height_)))
+    {
+      width_ = width;
+      height_ = height;
+      gain_ = allocate(values.size(), UNIT_GAIN);
+      for (size_t i = 0; i < values.size(); ++i)
+        gain_[i] = std::min(values[i], MAX_GAIN);
+      has_flat_ = true;
+    }
+    else
+    {
+      ROS_ERROR("[SensorCorrection]: Unable to read the flat map %s or its size differs from the dark map.",
+                path("_flat.pgm").c_str());
+      success = false;
+    }
+  }
+  if (has_dark_ && !has_flat_)
+    gain_ = allocate(static_cast<size_t>(width_) * height_, UNIT_GAIN);
+  if (has_flat_ && !has_dark_)
+    dark_ = allocate(static_cast<size_t>(width_) * height_, 0);
+
+  // The defect list starts with the size of the image the coordinates belong to
+  if (fileExists(path("_defects.txt")))
+  {
+    std::ifstream file(path("_defects.txt").c_str());
+    std::string line;
+    bool sized = false;
+    while (std::getline(file, line))
+    {
+      if (line.empty() || line[0] == '#')
+        continue;
+      std::istringstream fields(line);
+      uint32_t x;
+      uint32_t y;
+      if (!(fields >> x >> y))
+      {
+        success = false;
+        break;
+      }
+      if (!sized)
+      {
+        sized = true;
+        if ((has_dark_ || has_flat_) && (x != width_ || y != height_))
+        {
+          success = false;
+          break;
+        }
+        width_ = x;
+        height_ = y;
+      }
+      else if (x < width_ && y < height_)
+      {
+        defects_.push_back(y * width_ + x);
+      }
+    }
+    if (!success)
+    {
+      ROS_ERROR("[SensorCorrection]: Unable to read the defective pixels %s.", path("_defects.txt").c_str());
+      defects_.clear();
+    }
+    std::sort(defects_.begin(), defects_.end());
+    defects_.erase(std::unique(defects_.begin(), defects_.end()), defects_.end());
+  }
+
+  if (has_dark_ || has_flat_ || !defects_.empty())
+    ROS_INFO("[SensorCorrection]: Correcting %ux%u images with%s dark map,%s flat map and %zu defective pixels.",
+             width_, height_, has_dark_ ? "" : "out", has_flat_ ? "" : " no", defects_.size());
+  return success;
+}
+
+void SensorCorrection::process(sensor_msgs::Image* image)
+{
+  namespace enc = sensor_msgs::image_encodings;
+  if (!enc::isMono(image->encoding) && !enc::isBayer(image->encoding))
+    return;
+  const int bit_depth = enc::bitDepth(image->encoding);
+  const size_t sample_size = bit_depth / 8;
+  if ((bit_depth != 8 && bit_depth != 16) || image->is_bigendian || image->step < image->width * sample_size ||
+      image->data.size() < static_cast<size_t>(image->step) * image->height)
+    return;
+
+  std::lock_guard<std::mutex> scopedLock(mutex_);
+
+  // Maps are built from the uncorrected samples
+  if (building_ && build_frames_ > 0)
+  {
+    if (sums_.empty())
+    {
+      build_geometry_.width = image->width;
+      build_geometry_.height = image->height;
+      build_geometry_.encoding = image->encoding;
+      sums_.assign(static_cast<size_t>(image->width) * image->height, 0);
+    }
+    if (image->width != build_geometry_.width || image->height != build_geometry_.height ||
+        image->encoding != build_geometry_.encoding)
+    {
+      build_error_ = "The image size or encoding changed while building the map.";
+      build_frames_ = 0;
+    }
+    else
+    {
+      for (uint32_t y = 0; y < image->height; ++y)
+      {
+        const uint8_t* row = &image->data[y * image->step];
+        uint32_t* sums = &sums_[static_cast<size_t>(y) * image->width];
+        for (uint32_t x = 0; x < image->width; ++x)
+          sums[x] += sample_size == 2 ? reinterpret_cast<const uint16_t*>(row)[x] : row[x];
+      }
+      --build_frames_;
+    }
+    if (build_frames_ == 0)
+      build_cv_.notify_all();
+  }
+
+  if (!has_dark_ && !has_flat_ && defects_.empty())
+    return;
+  if (image->width != width_ || image->height != height_ || (has_dark_ && bit_depth != bit_depth_))
+  {
+    ROS_WARN_THROTTLE(10, "[SensorCorrection]: Not correcting %ux%u %s images, the maps are for %ux%u %d bit images.",
+                      image->width, image->height, image->encoding.c_str(), width_, height_, bit_depth_);
+    return;
+  }
+
+  if (has_dark_ || has_flat_)
+  {
+    for (uint32_t y = 0; y < image->height; ++y)
+    {
+      const size_t offset = static_cast<size_t>(y) * width_;
+      uint8_t* row = &image->data[y * image->step];
+      if (sample_size == 2)
+        correctSamples(reinterpret_cast<uint16_t*>(row), dark_.get() + offset, gain_.get() + offset, width_);
+      else
+        correctSamples(row, dark_.get() + offset, gain_.get() + offset, width_);
+    }
+  }
+  replaceDefects(image, enc::isBayer(image->encoding));
+}
+
+void SensorCorrection::replaceDefects(sensor_msgs::Image* image, const bool bayer) const
+{
+  const uint32_t stride = bayer ? 2 : 1;
+  if (sensor_msgs::image_encodings::bitDepth(image->encoding) == 16)
+    replaceSamples<uint16_t>(image, defects_, stride);
+  else
+    replaceSamples<uint8_t>(image, defects_, stride);
+}
+
+bool SensorCorrection::build(const Map map, const uint32_t frames, const double timeout, uint32_t* defects,
+                             std::string* message)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (building_)
+  {
+    *message = "A map is already being built.";
+    return false;
+  }
+  building_ = true;
+  build_frames_ = std::max<uint32_t>(1, frames);
+  const uint32_t count = build_frames_;
+  sums_.clear();
+  build_error_.clear();
+  const bool complete = build_cv_.wait_for(lock, std::chrono::duration<double>(timeout),
+                                           [this] { return build_frames_ == 0; });
+  building_ = false;
+  if (!complete)
+  {
+    *message = "Only " + std::to_string(count - build_frames_) + " of " + std::to_string(count) +
+               " frames arrived within the timeout.";
+    build_frames_ = 0;
+    return false;
+  }
+  if (!build_error_.empty())
+  {
+    *message = build_error_;
+    return false;
+  }
+
+  // Compute the map without holding up the acquisition thread
+  std::vector<uint32_t> sums;
+  sums.swap(sums_);
+  const uint32_t width = build_geometry_.width;
+  const uint32_t height = build_geometry_.height;
+  const int bit_depth = sensor_msgs::image_encodings::bitDepth(build_geometry_.encoding);
+  const bool bayer = sensor_msgs::image_encodings::isBayer(build_geometry_.encoding);
+  const bool same_geometry = width == width_ && height == height_;
+  std::vector<uint16_t> dark;
+  if (map == FLAT && has_dark_ && same_geometry && bit_depth == bit_depth_)
+    dark.assign(dark_.get(), dark_.get() + sums.size());
+  lock.unlock();
+
+  const size_t samples = sums.size();
+  AlignedMap built;
+  if (map == DARK)
+  {
+    built = allocate(samples, 0);
+    for (size_t i = 0; i < samples; ++i)
+      built[i] = static_cast<uint16_t>((sums[i] + count / 2) / count);
+  }
+  else
+  {
+    // Normalize each color of the mosaic on its own so that the flat field keeps the white balance
+    std::vector<double> signal(samples);
+    double channel_sums[4] = { 0.0, 0.0, 0.0, 0.0 };
+    size_t channel_counts[4] = { 0, 0, 0, 0 };
+    for (uint32_t y = 0; y < height; ++y)
+    {
+      for (uint32_t x = 0; x < width; ++x)
+      {
+        const size_t i = static_cast<size_t>(y) * width + x;
+        signal[i] = static_cast<double>(sums[i]) / count - (dark.empty() ? 0.0 : dark[i]);
+        const int channel = bayer ? (y & 1) * 2 + (x & 1) : 0;
+        channel_sums[channel] += signal[i];
+        ++channel_counts[channel];
+      }
+    }
+    const double full_scale = (1 << bit_depth) - 1;
+    for (int c = 0; c < 4; ++c)
+    {
+      if (channel_counts[c] == 0)
+        continue;
+      channel_sums[c] /= channel_counts[c];
+      if (channel_sums[c] < 0.01 * full_scale || channel_sums[c] > 0.95 * full_scale)
+      {
+        *message = "The flat field frames are too dark or saturated.";
+        return false;
+      }
+    }
+    built = allocate(samples, UNIT_GAIN);
+    for (uint32_t y = 0; y < height; ++y)
+    {
+      for (uint32_t x = 0; x < width; ++x)
+      {
+        const size_t i = static_cast<size_t>(y) * width + x;
+        const double mean = channel_sums[bayer ? (y & 1) * 2 + (x & 1) : 0];
+        // Pixels without response get the largest gain, which marks them as defective
+        const double gain = signal[i] > 0.0 ? mean / signal[i] * UNIT_GAIN : MAX_GAIN;
+        built[i] = static_cast<uint16_t>(std::max(1.0, std::min<double>(std::round(gain), MAX_GAIN)));
+      }
+    }
+  }
+
+  lock.lock();
+  // A map of another size replaces all maps
+  if (width != width_ || height != height_)
+  {
+    has_dark_ = false;
+    has_flat_ = false;
+    width_ = width;
+    height_ = height;
+  }
+  if (map == DARK)
+  {
+    dark_ = std::move(built);
+    bit_depth_ = bit_depth;
+    has_dark_ = true;
+    if (!has_flat_)
+      gain_ = allocate(samples, UNIT_GAIN);
+  }
+  else
+  {
+    gain_ = std::move(built);
+    has_flat_ = true;
+    if (!has_dark_)
+    {
+      dark_ = allocate(samples, 0);
+      bit_depth_ = bit_depth;
+    }
+  }
+  detectDefects(bayer);
+  *defects = static_cast<uint32_t>(defects_.size());
+  if (!save(map, message))
+    return false;
+  *message = "Built the " + std::string(map == DARK ? "dark" : "flat") + " map from " + std::to_string(count) +
+             " frames, " + std::to_string(defects_.size()) + " defective pixels.";
+  return true;
+}
+
+void SensorCorrection::detectDefects(const bool bayer)
+{
+  const uint32_t stride = bayer ? 2 : 1;
+  const double hot_threshold = HOT_PIXEL_THRESHOLD * ((1 << bit_depth_) - 1);
+  defects_.clear();
+  for (uint32_t y = 0; y < height_; ++y)
+  {
+    for (uint32_t x = 0; x < width_; ++x)
+    {
+      const uint32_t i = y * width_ + x;
+      bool defect = false;
+      if (has_dark_)
+      {
+        const double mean = neighbourMedian(dark_.get(), width_, height_, x, y, stride);
+        defect = mean >= 0.0 && dark_[i] - mean > hot_threshold;
+      }
+      if (!defect && has_flat_)
+      {
+        const double mean = neighbourMedian(gain_.get(), width_, height_, x, y, stride);
+        defect = mean > 0.0 && std::fabs(gain_[i] - mean) > FLAT_DEFECT_THRESHOLD * mean;
+      }
+      if (defect)
+        defects_.push_back(i);
+    }
+  }
+  if (defects_.size() > static_cast<size_t>(width_) * height_ / 100)
+    ROS_WARN("[SensorCorrection]: %zu defective pixels, was the lens covered for the dark map and the light uniform "
+             "for the flat map?", defects_.size());
+}
+
+bool SensorCorrection::save(const Map map, std::string* message) const
+{
+  mkdir(directory_.c_str(), 0755);
+  const bool written =
+      map == DARK ? writePgm(path("_dark.pgm"), width_, height_, (1u << bit_depth_) - 1, dark_.get(),
+                             "Dark level of camera " + serial_) :
+                    writePgm(path("_flat.pgm"), width_, height_, 0xFFFF, gain_.get(),
+                             "Flat field gains of camera " + serial_ + ", " + std::to_string(UNIT_GAIN) + " is 1");
+  if (!written)
+  {
+    *message = "Unable to write the map to " + directory_ + ".";
+    return false;
+  }
+
+  const std::string defects_path = path("_defects.txt");
+  {
+    std::ofstream file((defects_path + ".tmp").c_str());
+    file << "# Defective pixels of camera " << serial_ << ": the image size, then one x y per line\n";
+    file << width_ << " " << height_ << "\n";
+    for (size_t d = 0; d < defects_.size(); ++d)
+      file << defects_[d] % width_ << " " << defects_[d] / width_ << "\n";
+    if (!file)
+    {
+      *message = "Unable to write " + defects_path + ".";
+      return false;
+    }
+  }
+  if (std::rename((defects_path + ".tmp").c_str(), defects_path.c_str()) != 0)
+  {
+    *message = "Unable to write " + defects_path + ".";
+    return false;
+  }
+  return true;
+}
+
+size_t SensorCorrection::getDefectCount()
+{
+  std::lock_guard<std::mutex> scopedLock(mutex_);
+  return defects_.size();
+}
+}  // namespace spinnaker_camera_driver
@@ -0,0 +1,261 @@
+/**
+Software License Agreement (BSD)
+
+\file      shm_image_ring.cpp
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "spinnaker_camera_driver/shm_image_ring.h"
+
+#include <ros/ros.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+namespace spinnaker_camera_driver
+{
+static const size_t PAGE_ALIGNMENT = 4096;
+// Slot headers start on their own cache line after the ring header.
+static const size_t SLOT_TABLE_OFFSET = 64;
+
+static size_t alignUp(const size_t value, const size_t alignment)
+{
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+ShmImagePublisher::ShmImagePublisher(const std::string& name, const uint32_t slot_count)
+  : name_(name)
+  , slot_count_(slot_count)
+  , layout_(static_cast<uint32_t>(getpid()) << 16)
+  , sequence_(0)
+  , mapping_(NULL)
+  , mapping_size_(0)
+  , header_(NULL)
+  , slots_(NULL)
+{
+}
+
+ShmImagePublisher::~ShmImagePublisher()
+{
+  destroy();
+}
+
+void ShmImagePublisher::destroy()
+{
+  if (mapping_)
+  {
+    munmap(mapping_, mapping_size_);
+    shm_unlink(name_.c_str());
+    mapping_ = NULL;
+    header_ = NULL;
+    slots_ = NULL;
+  }
+}
+
+bool ShmImagePublisher::create(const size_t image_size)
+{
+  // Readers that still map the old segment notice the new layout in the next descriptor and remap.
+  destroy();
+
+  const size_t slot_size = alignUp(image_size, PAGE_ALIGNMENT);
+  const size_t data_offset =
+      alignUp(SLOT_TABLE_OFFSET + slot_count_ * sizeof(shm::SlotHeader), PAGE_ALIGNMENT);
+  const size_t total_size = data_offset + slot_count_ * slot_size;
+
+  // Our own segment was unlinked above, one that still exists was left behind by a publisher that did not exit
+  int fd = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0 && errno == EEXIST)
+  {
+    ROS_WARN("[ShmImagePublisher]: Replacing the existing segment %s.", name_.c_str());
+    shm_unlink(name_.c_str());
+    fd = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  }
+  if (fd < 0)
+  {
+    ROS_ERROR("[ShmImagePublisher]: shm_open(%s) failed: %s", name_.c_str(), std::strerror(errno));
+    return false;
+  }
+  if (ftruncate(fd, total_size) != 0)
+  {
+    ROS_ERROR("[ShmImagePublisher]: Unable to size %s to %zu bytes: %s", name_.c_str(), total_size,
+              std::strerror(errno));
+    close(fd);
+    shm_unlink(name_.c_str());
+    return false;
+  }
+  void* mapping = mmap(NULL, total_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED)
+  {
+    ROS_ERROR("[ShmImagePublisher]: Unable to map %s: %s", name_.c_str(), std::strerror(errno));
+    shm_unlink(name_.c_str());
+    return false;
+  }
+
+  mapping_ = static_cast<uint8_t*>(mapping);
+  mapping_size_ = total_size;
+  header_ = reinterpret_cast<shm::RingHeader*>(mapping_);
+  slots_ = reinterpret_cast<shm::SlotHeader*>(mapping_ + SLOT_TABLE_OFFSET);
+
+  // ftruncate zero-fills the segment, so all slot generations start at 0 (never written).
+  header_->version = shm::VERSION;
+  header_->layout = ++layout_;
+  header_->slot_count = slot_count_;
+  header_->slot_size = slot_size;
+  header_->data_offset = data_offset;
+  std::atomic_thread_fence(std::memory_order_release);
+  header_->magic = shm::MAGIC;
+
+  ROS_INFO("[ShmImagePublisher]: Created %s with %u slots of %zu bytes.", name_.c_str(), slot_count_, slot_size);
+  return true;
+}
+
+bool ShmImagePublisher::write(const sensor_msgs::Image& image, SharedImageDescriptor* descriptor)
+{
+  const size_t size = image.data.size();
+  if (!mapping_ || size > header_->slot_size)
+  {
+    if (!create(size))
+      return false;
+  }
+
+  const uint32_t slot = static_cast<uint32_t>(sequence_ % slot_count_);
+  std::atomic<uint64_t>& generation = slots_[slot].generation;
+  const uint64_t complete = 2 * (sequence_ + 1);
+
+  generation.store(complete - 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  std::memcpy(mapping_ + header_->data_offset + slot * header_->slot_size, image.data.data(), size);
+  generation.store(complete, std::memory_order_release);
+
+  descriptor->header = image.header;
+  descriptor->shm_name = name_;
+  descriptor->layout = header_->layout;
+  descriptor->slot = slot;
+  descriptor->generation = complete;
+  descriptor->sequence = sequence_;
+  descriptor->height = image.height;
+  descriptor->width = image.width;
+  descriptor->encoding = image.encoding;
+  descriptor->is_bigendian = image.is_bigendian;
+  descriptor->step = image.step;
+
+  ++sequence_;
+  return true;
+}
+
+ShmImageReader::ShmImageReader() : mapping_(NULL), mapping_size_(0), header_(NULL), slots_(NULL)
+{
+}
+
+ShmImageReader::~ShmImageReader()
+{
+  unmap();
+}
+
+void ShmImageReader::unmap()
+{
+  if (mapping_)
+  {
+    munmap(const_cast<uint8_t*>(mapping_), mapping_size_);
+    mapping_ = NULL;
+    header_ = NULL;
+    slots_ = NULL;
+  }
+}
+
+bool ShmImageReader::map(const SharedImageDescriptor& descriptor)
+{
+  if (mapping_ && name_ == descriptor.shm_name && header_->layout == descriptor.layout)
+    return true;
+
+  unmap();
+  name_ = descriptor.shm_name;
+
+  int fd = shm_open(name_.c_str(), O_RDONLY, 0);
+  if (fd < 0)
+    return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < PAGE_ALIGNMENT)
+  {
+    close(fd);
+    return false;
+  }
+  void* mapping = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED)
+    return false;
+
+  mapping_ = static_cast<const uint8_t*>(mapping);
+  mapping_size_ = st.st_size;
+  header_ = reinterpret_cast<const shm::RingHeader*>(mapping_);
+  slots_ = reinterpret_cast<const shm::SlotHeader*>(mapping_ + SLOT_TABLE_OFFSET);
+
+  if (header_->magic != shm::MAGIC || header_->version != shm::VERSION || header_->layout != descriptor.layout ||
+      header_->data_offset + header_->slot_count * header_->slot_size > mapping_size_)
+  {
+    // Either a different driver version or the segment was recreated again since the descriptor was sent.
+    unmap();
+    return false;
+  }
+  return true;
+}
+
+const uint8_t* ShmImageReader::acquire(const SharedImageDescriptor& descriptor)
+{
+  if (!map(descriptor) || descriptor.slot >= header_->slot_count ||
+      static_cast<uint64_t>(descriptor.step) * descriptor.height > header_->slot_size)
+    return NULL;
+  if (!isValid(descriptor))
+    return NULL;
+  return mapping_ + header_->data_offset + descriptor.slot * header_->slot_size;
+}
+
+bool ShmImageReader::isValid(const SharedImageDescriptor& descriptor) const
+{
+  if (!mapping_ || header_->layout != descriptor.layout || descriptor.slot >= header_->slot_count)
+    return false;
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return slots_[descriptor.slot].generation.load(std::memory_order_acquire) == descriptor.generation;
+}
+
+bool ShmImageReader::copyTo(const SharedImageDescriptor& descriptor, sensor_msgs::Image* image)
+{
+  const uint8_t* pixels = acquire(descriptor);
+  if (!pixels)
+    return false;
+
+  image->header = descriptor.header;
+  image->height = descriptor.height;
+  image->width = descriptor.width;
+  image->encoding = descriptor.encoding;
+  image->is_bigendian = descriptor.is_bigendian;
+  image->step = descriptor.step;
+  image->data.assign(pixels, pixels + static_cast<size_t>(descriptor.step) * descriptor.height);
+
+  return isValid(descriptor);
+}
+}  // namespace spinnaker_camera_driver
@@ -0,0 +1,335 @@
+/**
+Software License Agreement (BSD)
+
+\file      spinnaker_characterize.cpp
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Steps a camera through combinations of pixel format, binning, ROI, frame rate and exposure time and writes the
+// achieved performance of each point to a CSV file, one profile per host and camera model.
+
+#include "spinnaker_camera_driver/SpinnakerCamera.h"
+
+#include <ros/ros.h>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace spinnaker_camera_driver
+{
+namespace
+{
+struct SweepPoint
+{
+  std::string pixel_format;  ///< Empty keeps the configured format.
+  int binning;
+  int width;                 ///< 0 for the full sensor width.
+  int height;                ///< 0 for the full sensor height.
+  double frame_rate;         ///< 0 for free running.
+  double exposure_time;      ///< Microseconds, 0 for auto exposure.
+};
+
+struct SweepResult
+{
+  std::string status;
+  int width;
+  int height;
+  std::string encoding;
+  double fps;
+  double megabytes_per_second;
+  double incomplete_ratio;
+  double error_ratio;
+  double cpu_percent;
+  double latency_mean;  ///< Milliseconds from exposure start to the frame in user space, all latency_* likewise.
+  double latency_p50;
+  double latency_p99;
+  double latency_max;
+  bool stable;
+};
+
+double cpuSeconds()
+{
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+}
+
+int64_t steadyNanoseconds()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+double percentile(const std::vector<double>& sorted, const double p)
+{
+  if (sorted.empty())
+    return 0.0;
+  return sorted[std::min(sorted.size() - 1, static_cast<size_t>(p * (sorted.size() - 1) + 0.5))];
+}
+}  // namespace
+
+class SpinnakerCharacterize
+{
+public:
+  explicit SpinnakerCharacterize(ros::NodeHandle& pnh);
+
+  /// Runs the whole sweep, returns false if the camera could not be opened or the output not written.
+  bool run();
+
+private:
+  void readSweep(ros::NodeHandle& pnh);
+  SweepResult measure(const SweepPoint& point);
+
+  SpinnakerCamera spinnaker_;
+  int serial_;
+  int frames_;         ///< Frames measured per point.
+  int settle_frames_;  ///< Frames dropped after each start before measuring.
+  double timeout_;
+  std::string output_;
+  std::vector<SweepPoint> points_;
+};
+
+SpinnakerCharacterize::SpinnakerCharacterize(ros::NodeHandle& pnh)
+{
+  pnh.param<int>("serial", serial_, 0);
+  pnh.param<int>("frames", frames_, 200);
+  pnh.param<int>("settle_frames", settle_frames_, 20);
+  pnh.param<double>("timeout", timeout_, 1.0);
+  pnh.param<std::string>("output", output_, "spinnaker_profile.csv");
+  readSweep(pnh);
+}
+
+void SpinnakerCharacterize::readSweep(ros::NodeHandle& pnh)
+{
+  std::vector<std::string> pixel_formats;
+  std::vector<int> binnings;
+  std::vector<std::string> roi_sizes;
+  std::vector<double> frame_rates;
+  std::vector<double> exposure_times;
+  pnh.param<std::vector<std::string> >("pixel_formats", pixel_formats, std::vector<std::string>(1, ""));
+  pnh.param<std::vector<int> >("binnings", binnings, std::vector<int>(1, 1));
+  pnh.param<std::vector<std::string> >("roi_sizes", roi_sizes, std::vector<std::string>(1, "0x0"));
+  pnh.param<std::vector<double> >("frame_rates", frame_rates, std::vector<double>(1, 0.0));
+  pnh.param<std::vector<double> >("exposure_times", exposure_times, std::vector<double>(1, 0.0));
+
+  for (const std::string& pixel_format : pixel_formats)
+    for (const int binning : binnings)
+      for (const std::string& roi : roi_sizes)
+        for (const double frame_rate : frame_rates)
+          for (const double exposure_time : exposure_times)
+          {
+            SweepPoint point;
+            point.pixel_format = pixel_format;
+            point.binning = std::max(1, binning);
+            point.width = 0;
+            point.height = 0;
+            if (std::sscanf(roi.c_str(), "%dx%d", &point.width, &point.height) != 2)
+            {
+              ROS_WARN("Ignoring ROI size '%s', expected WIDTHxHEIGHT.", roi.c_str());
+              continue;
+            }
+            point.frame_rate = frame_rate;
+            point.exposure_time = exposure_time;
+            points_.push_back(point);
+          }
+}
+
+SweepResult SpinnakerCharacterize::measure(const SweepPoint& point)
+{
+  SweepResult result = SweepResult();
+  result.status = "ok";
+
+  SpinnakerConfig config = SpinnakerConfig::__getDefault__();
+  config.image_format_x_binning = point.binning;
+  config.image_format_y_binning = point.binning;
+  config.image_format_roi_width = point.width;
+  config.image_format_roi_height = point.height;
+  config.acquisition_frame_rate_enable = point.frame_rate > 0.0;
+  if (point.frame_rate > 0.0)
+    config.acquisition_frame_rate = point.frame_rate;
+  config.exposure_auto = point.exposure_time > 0.0 ? "Off" : "Continuous";
+  if (point.exposure_time > 0.0)
+    config.exposure_time = point.exposure_time;
+
+  try
+  {
+    spinnaker_.setPixelFormat(point.pixel_format);
+    spinnaker_.setNewConfiguration(config, SpinnakerCamera::LEVEL_RECONFIGURE_STOP);
+    spinnaker_.start();
+  }
+  catch (const std::runtime_error& e)
+  {
+    ROS_WARN("Could not apply point: %s", e.what());
+    result.status = "config_failed";
+    return result;
+  }
+
+  sensor_msgs::Image image;
+  int errors = 0;
+  for (int i = 0; i < settle_frames_; ++i)
+  {
+    try
+    {
+      spinnaker_.grabImage(&image, "camera");
+    }
+    catch (const std::runtime_error&)
+    {
+    }
+  }
+
+  // Latched after settling so that drift over the measurement stays small
+  int64_t clock_offset = 0;
+  const bool have_clock = spinnaker_.getClockOffset(&clock_offset);
+
+  std::vector<double> latencies;
+  latencies.reserve(frames_);
+  size_t bytes = 0;
+  const uint64_t incomplete_start = spinnaker_.getIncompleteFrames();
+  const double cpu_start = cpuSeconds();
+  const int64_t wall_start = steadyNanoseconds();
+  for (int i = 0; i < frames_; ++i)
+  {
+    try
+    {
+      spinnaker_.grabImage(&image, "camera");
+    }
+    catch (const std::runtime_error&)
+    {
+      ++errors;
+      continue;
+    }
+    const int64_t received = steadyNanoseconds();
+    bytes += image.data.size();
+    if (have_clock)
+      latencies.push_back((received - static_cast<int64_t>(image.header.stamp.toNSec()) - clock_offset) * 1e-6);
+  }
+  const double wall = (steadyNanoseconds() - wall_start) * 1e-9;
+  const double cpu = cpuSeconds() - cpu_start;
+  const uint64_t incomplete = spinnaker_.getIncompleteFrames() - incomplete_start;
+
+  try
+  {
+    spinnaker_.stop();
+  }
+  catch (const std::runtime_error& e)
+  {
+    ROS_WARN("Failed to stop the camera: %s", e.what());
+  }
+
+  const int received = frames_ - errors;
+  result.width = image.width;
+  result.height = image.height;
+  result.encoding = image.encoding;
+  result.fps = wall > 0.0 ? received / wall : 0.0;
+  result.megabytes_per_second = wall > 0.0 ? bytes / wall * 1e-6 : 0.0;
+  result.incomplete_ratio = frames_ > 0 ? static_cast<double>(incomplete) / frames_ : 0.0;
+  result.error_ratio = frames_ > 0 ? static_cast<double>(errors) / frames_ : 0.0;
+  result.cpu_percent = wall > 0.0 ? 100.0 * cpu / wall : 0.0;
+  if (!latencies.empty())
+  {
+    std::sort(latencies.begin(), latencies.end());
+    double sum = 0.0;
+    for (const double latency : latencies)
+      sum += latency;
+    result.latency_mean = sum / latencies.size();
+    result.latency_p50 = percentile(latencies, 0.5);
+    result.latency_p99 = percentile(latencies, 0.99);
+    result.latency_max = latencies.back();
+  }
+  if (received == 0)
+    result.status = "no_frames";
+  // Free running points have no requested rate, any clean run is stable
+  result.stable = received > 0 && incomplete == 0 && errors == 0 &&
+                  (point.frame_rate <= 0.0 || result.fps >= 0.95 * point.frame_rate);
+  return result;
+}
+
+bool SpinnakerCharacterize::run()
+{
+  std::ofstream output(output_.c_str());
+  if (!output)
+  {
+    ROS_ERROR("Could not open %s for writing.", output_.c_str());
+    return false;
+  }
+
+  try
+  {
+    spinnaker_.setDesiredCamera(static_cast<uint32_t>(serial_));
+    spinnaker_.setTimeout(timeout_);
+    spinnaker_.connect();
+  }
+  catch (const std::runtime_error& e)
+  {
+    ROS_ERROR("Could not connect to the camera: %s", e.what());
+    return false;
+  }
+
+  char host[256] = "";
+  gethostname(host, sizeof(host) - 1);
+
+  output << "host,serial,pixel_format,binning,roi_width,roi_height,requested_fps,exposure_time_us,status,width,height,"
+            "encoding,fps,mb_per_s,incomplete_ratio,error_ratio,cpu_percent,latency_mean_ms,latency_p50_ms,"
+            "latency_p99_ms,latency_max_ms,stable\n";
+
+  for (size_t i = 0; i < points_.size() && ros::ok(); ++i)
+  {
+    const SweepPoint& point = points_[i];
+    ROS_INFO("Point %zu/%zu: format '%s', binning %d, ROI %dx%d, %.1f fps, exposure %.0f us", i + 1, points_.size(),
+             point.pixel_format.c_str(), point.binning, point.width, point.height, point.frame_rate,
+             point.exposure_time);
+    const SweepResult result = measure(point);
+    ROS_INFO("  %s: %.2f fps, %.1f MB/s, %.1f%% CPU, p99 latency %.2f ms, %s", result.status.c_str(), result.fps,
+             result.megabytes_per_second, result.cpu_percent, result.latency_p99,
+             result.stable ? "stable" : "unstable");
+
+    output << host << ',' << spinnaker_.getSerial() << ',' << point.pixel_format << ',' << point.binning << ','
+           << point.width << ',' << point.height << ',' << point.frame_rate << ',' << point.exposure_time << ','
+           << result.status << ',' << result.width << ',' << result.height << ',' << result.encoding << ','
+           << result.fps << ',' << result.megabytes_per_second << ',' << result.incomplete_ratio << ','
+           << result.error_ratio << ',' << result.cpu_percent << ',' << result.latency_mean << ','
+           << result.latency_p50 << ',' << result.latency_p99 << ',' << result.latency_max << ','
+           << (result.stable ? 1 : 0) << '\n';
+    output.flush();
+  }
+
+  spinnaker_.disconnect();
+  ROS_INFO("Wrote %zu points to %s", points_.size(), output_.c_str());
+  return true;
+}
+}  // namespace spinnaker_camera_driver
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "spinnaker_characterize");
+  ros::NodeHandle pnh("~");
+
+  spinnaker_camera_driver::SpinnakerCharacterize characterize(pnh);
+  return characterize.run() ? 0 : 1;
+}
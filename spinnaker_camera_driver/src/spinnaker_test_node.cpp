@@ -9,66 +9,267 @@ Redistribution and use in source and binary forms, with or without modification,
 permission of Clearpath Robotics.
 */
 
+
+// Enumerates all connected cameras and prints their capabilities as YAML, for planning bandwidth and placement.
+// Cameras are opened in parallel so that the run time stays close to the slowest camera's, not the sum.
+
 // ROS Includes
 #include "ros/ros.h"
 
 // Spinnaker Includes
 #include "Spinnaker.h"
-// #include "SpinGenApi/SpinnakerGenApi.h"
+#include "SpinGenApi/SpinnakerGenApi.h"
+
+#include <chrono>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
 
 namespace spinnaker_camera_driver
 {
+struct FormatCapability
+{
+  std::string name;
+  double frame_rate_min;  ///< 0 if the camera does not report a frame rate range.
+  double frame_rate_max;
+};
+
+struct CameraCapability
+{
+  unsigned int index;
+  std::string serial;
+  std::string vendor;
+  std::string model;
+  std::string firmware;
+  std::string device_type;
+  std::string link_speed;           ///< DeviceCurrentSpeed, e.g. SuperSpeed or the GigE link rate.
+  std::string link_throughput;      ///< DeviceLinkThroughputLimit in bytes per second.
+  std::string max_throughput;       ///< DeviceMaxThroughput at the current configuration in bytes per second.
+  std::string sensor_width;
+  std::string sensor_height;
+  std::string width_max;
+  std::string height_max;
+  std::vector<FormatCapability> formats;
+  std::string error;                ///< Set if the camera could not be opened, the other fields may be partial.
+};
+
 class SpinnakerTestNode
 {
 public:
   SpinnakerTestNode();
 
   void test();
+
+private:
+  static CameraCapability probe(Spinnaker::CameraPtr camera, const unsigned int index);
+  static void writeYaml(std::ostream& out, const std::vector<CameraCapability>& cameras, const unsigned int interfaces,
+                        const double elapsed);
+
+  std::string output_;  ///< Optional file the YAML is also written to.
 };
 
+namespace
+{
+/// Reads any value node as a string, empty if not present on this camera.
+std::string readValue(Spinnaker::GenApi::INodeMap& node_map, const char* name)
+{
+  Spinnaker::GenApi::CValuePtr value = node_map.GetNode(name);
+  if (Spinnaker::GenApi::IsAvailable(value) && Spinnaker::GenApi::IsReadable(value))
+    return value->ToString().c_str();
+  return "";
+}
+
+/// Reads from the device node map first, the transport layer node map has a subset of the same nodes.
+std::string readValue(Spinnaker::GenApi::INodeMap& node_map, Spinnaker::GenApi::INodeMap& tl_node_map,
+                      const char* name)
+{
+  const std::string value = readValue(node_map, name);
+  return value.empty() ? readValue(tl_node_map, name) : value;
+}
+
+std::string quote(const std::string& value)
+{
+  std::string quoted = "\"";
+  for (const char c : value)
+  {
+    if (c == '"' || c == '\\')
+      quoted += '\\';
+    quoted += c;
+  }
+  return quoted + "\"";
+}
+
+/// Unquoted numbers keep the YAML typed, anything unreadable becomes null.
+std::string number(const std::string& value)
+{
+  return value.empty() ? "null" : value;
+}
+}  // namespace
+
 SpinnakerTestNode::SpinnakerTestNode()
 {
+  ros::NodeHandle pnh("~");
+  pnh.param<std::string>("output", output_, "");
   test();
 }
 
+CameraCapability SpinnakerTestNode::probe(Spinnaker::CameraPtr camera, const unsigned int index)
+{
+  CameraCapability capability;
+  capability.index = index;
+  try
+  {
+    Spinnaker::GenApi::INodeMap& tl_node_map = camera->GetTLDeviceNodeMap();
+    capability.serial = readValue(tl_node_map, "DeviceSerialNumber");
+    capability.device_type = readValue(tl_node_map, "DeviceType");
+
+    camera->Init();
+    Spinnaker::GenApi::INodeMap& node_map = camera->GetNodeMap();
+    capability.vendor = readValue(node_map, tl_node_map, "DeviceVendorName");
+    capability.model = readValue(node_map, tl_node_map, "DeviceModelName");
+    capability.firmware = readValue(node_map, tl_node_map, "DeviceFirmwareVersion");
+    capability.link_speed = readValue(node_map, tl_node_map, "DeviceCurrentSpeed");
+    if (capability.link_speed.empty())
+      capability.link_speed = readValue(node_map, "DeviceLinkSpeed");
+    capability.link_throughput = readValue(node_map, "DeviceLinkThroughputLimit");
+    capability.sensor_width = readValue(node_map, "SensorWidth");
+    capability.sensor_height = readValue(node_map, "SensorHeight");
+    capability.width_max = readValue(node_map, "WidthMax");
+    capability.height_max = readValue(node_map, "HeightMax");
+
+    // The frame rate range depends on the format, so every format is selected once and the original restored
+    Spinnaker::GenApi::CEnumerationPtr pixel_format = node_map.GetNode("PixelFormat");
+    Spinnaker::GenApi::CBooleanPtr rate_enable = node_map.GetNode("AcquisitionFrameRateEnable");
+    Spinnaker::GenApi::CFloatPtr rate = node_map.GetNode("AcquisitionFrameRate");
+    const bool can_enable = Spinnaker::GenApi::IsAvailable(rate_enable) && Spinnaker::GenApi::IsWritable(rate_enable);
+    const bool rate_was_enabled = can_enable && rate_enable->GetValue();
+    if (can_enable)
+      rate_enable->SetValue(true);
+
+    if (Spinnaker::GenApi::IsAvailable(pixel_format) && Spinnaker::GenApi::IsReadable(pixel_format))
+    {
+      const int64_t original_format = pixel_format->GetIntValue();
+      const bool can_select = Spinnaker::GenApi::IsWritable(pixel_format);
+      Spinnaker::GenApi::NodeList_t entries;
+      pixel_format->GetEntries(entries);
+      for (size_t i = 0; i < entries.size(); ++i)
+      {
+        Spinnaker::GenApi::CEnumEntryPtr entry = entries[i];
+        if (!Spinnaker::GenApi::IsAvailable(entry) || !Spinnaker::GenApi::IsReadable(entry))
+          continue;
+
+        FormatCapability format;
+        format.name = entry->GetSymbolic().c_str();
+        format.frame_rate_min = 0.0;
+        format.frame_rate_max = 0.0;
+        if (can_select || entry->GetValue() == original_format)
+        {
+          if (can_select)
+            pixel_format->SetIntValue(entry->GetValue());
+          if (Spinnaker::GenApi::IsAvailable(rate) && Spinnaker::GenApi::IsReadable(rate))
+          {
+            format.frame_rate_min = rate->GetMin();
+            format.frame_rate_max = rate->GetMax();
+          }
+        }
+        capability.formats.push_back(format);
+      }
+      if (can_select)
+        pixel_format->SetIntValue(original_format);
+    }
+    // Read after restoring the format since it depends on the current configuration
+    capability.max_throughput = readValue(node_map, "DeviceMaxThroughput");
+
+    if (can_enable)
+      rate_enable->SetValue(rate_was_enabled);
+    camera->DeInit();
+  }
+  catch (const Spinnaker::Exception& e)
+  {
+    capability.error = e.what();
+    try
+    {
+      if (camera->IsInitialized())
+        camera->DeInit();
+    }
+    catch (const Spinnaker::Exception&)
+    {
+    }
+  }
+  return capability;
+}
+
+void SpinnakerTestNode::writeYaml(std::ostream& out, const std::vector<CameraCapability>& cameras,
+                                  const unsigned int interfaces, const double elapsed)
+{
+  out << "interfaces: " << interfaces << "\n";
+  out << "enumeration_time: " << elapsed << "\n";
+  out << "cameras:" << (cameras.empty() ? " []" : "") << "\n";
+  for (const CameraCapability& camera : cameras)
+  {
+    out << "  - index: " << camera.index << "\n";
+    out << "    serial: " << quote(camera.serial) << "\n";
+    out << "    vendor: " << quote(camera.vendor) << "\n";
+    out << "    model: " << quote(camera.model) << "\n";
+    out << "    firmware: " << quote(camera.firmware) << "\n";
+    out << "    device_type: " << quote(camera.device_type) << "\n";
+    out << "    link_speed: " << quote(camera.link_speed) << "\n";
+    out << "    link_throughput_limit: " << number(camera.link_throughput) << "\n";
+    out << "    max_throughput: " << number(camera.max_throughput) << "\n";
+    out << "    sensor: {width: " << number(camera.sensor_width) << ", height: " << number(camera.sensor_height)
+        << "}\n";
+    out << "    max_roi: {width: " << number(camera.width_max) << ", height: " << number(camera.height_max) << "}\n";
+    out << "    pixel_formats:" << (camera.formats.empty() ? " []" : "") << "\n";
+    for (const FormatCapability& format : camera.formats)
+    {
+      out << "      - {name: " << quote(format.name);
+      if (format.frame_rate_max > 0.0)
+        out << ", frame_rate_min: " << format.frame_rate_min << ", frame_rate_max: " << format.frame_rate_max;
+      out << "}\n";
+    }
+    if (!camera.error.empty())
+      out << "    error: " << quote(camera.error) << "\n";
+  }
+}
+
 void SpinnakerTestNode::test()
 {
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
   Spinnaker::SystemPtr system = Spinnaker::System::GetInstance();
 
   Spinnaker::InterfaceList interfaceList = system->GetInterfaces();
   unsigned int numInterfaces = interfaceList.GetSize();
-  std::printf("\033[93m[Spinnaker] Number of interfaces detected: %d \n", numInterfaces);
 
   Spinnaker::CameraList camList = system->GetCameras();
   unsigned int numCameras = camList.GetSize();
 
-  std::printf("\033[93m[Spinnaker] # of connected cameras: %d \n", numCameras);
+  // Opening a camera mostly waits on the device, so one thread per camera
+  std::vector<std::future<CameraCapability> > probes;
+  for (unsigned int i = 0; i < numCameras; i++)
+    probes.push_back(std::async(std::launch::async, &SpinnakerTestNode::probe, camList.GetByIndex(i), i));
 
-  // Finish if there are no cameras
-  if (numCameras == 0)
-  {
-    std::printf("\033[91mNO Cameras Connected! \n\n");
-    // Clear camera list before releasing system
-    camList.Clear();
-    interfaceList.Clear();
-    // Release system
-    system->ReleaseInstance();
-
-    return;
-  }
-  else
+  std::vector<CameraCapability> cameras;
+  for (std::future<CameraCapability>& probe : probes)
+    cameras.push_back(probe.get());
+
+  const double elapsed =
+      std::chrono::duration_cast<std::chrono::duration<double> >(std::chrono::steady_clock::now() - start).count();
+
+  std::ostringstream yaml;
+  writeYaml(yaml, cameras, numInterfaces, elapsed);
+  std::cout << yaml.str() << std::flush;
+  if (!output_.empty())
   {
-    for (unsigned int i = 0; i < numCameras; i++)
-    {
-      Spinnaker::CameraPtr pCam = camList[i];
-      Spinnaker::GenApi::INodeMap& nodeMapTLDevice = pCam->GetTLDeviceNodeMap();
-      Spinnaker::GenApi::CStringPtr ptrDeviceSerialNumber = nodeMapTLDevice.GetNode("DeviceSerialNumber");
-      if (Spinnaker::GenApi::IsAvailable(ptrDeviceSerialNumber) && Spinnaker::GenApi::IsReadable(ptrDeviceSerialNumber))
-      {
-        std::cout << "\033[92m[" << i << "]\t" << ptrDeviceSerialNumber->ToString() << std::endl;
-      }
-    }
+    std::ofstream file(output_.c_str());
+    file << yaml.str();
+    if (!file)
+      ROS_ERROR("Could not write the capabilities to %s", output_.c_str());
   }
+
+  // Clear camera list before releasing system
   camList.Clear();
   interfaceList.Clear();
   system->ReleaseInstance();
@@ -79,6 +280,5 @@ int main(int argc, char** argv)
 {
   ros::init(argc, argv, "spinnaker_test_node");
   spinnaker_camera_driver::SpinnakerTestNode node;
-  ros::spin();
   return 0;
 }
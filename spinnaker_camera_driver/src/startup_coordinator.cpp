@@ -0,0 +1,145 @@
+/**
+Software License Agreement (BSD)
+
+\file      startup_coordinator.cpp
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "spinnaker_camera_driver/startup_coordinator.h"
+#include "spinnaker_camera_driver/diagnostic_values.h"
+
+#include <ros/ros.h>
+
+#include <algorithm>
+#include <map>
+
+namespace spinnaker_camera_driver
+{
+namespace
+{
+// Groups of the process. Weak so that a group is recreated if all its nodelets are unloaded and loaded again.
+std::mutex groups_mutex;
+std::map<std::string, std::weak_ptr<StartupCoordinator> > groups;
+}  // namespace
+
+std::shared_ptr<StartupCoordinator> StartupCoordinator::join(const std::string& group, const size_t size)
+{
+  std::lock_guard<std::mutex> lock(groups_mutex);
+  std::shared_ptr<StartupCoordinator> coordinator = groups[group].lock();
+  if (!coordinator)
+  {
+    coordinator.reset(new StartupCoordinator(group, size));
+    groups[group] = coordinator;
+  }
+  else if (coordinator->size_ != size)
+  {
+    ROS_WARN("Startup group %s was created with %zu members, ignoring the size %zu.", group.c_str(),
+             coordinator->size_, size);
+  }
+  return coordinator;
+}
+
+StartupCoordinator::StartupCoordinator(const std::string& group, const size_t size)
+  : group_(group), size_(size), released_(false), complete_(false)
+{
+  members_.reserve(size);
+}
+
+StartupCoordinator::Member& StartupCoordinator::member(const std::string& name)
+{
+  for (Member& member : members_)
+  {
+    if (member.name == name)
+      return member;
+  }
+  Member member;
+  member.name = name;
+  member.init_time = 0.0;
+  members_.push_back(member);
+  return members_.back();
+}
+
+void StartupCoordinator::arrive(const std::string& name, const double init_time)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  member(name).init_time = init_time;
+  if (!released_ && members_.size() >= size_)
+  {
+    released_ = true;
+    complete_ = true;
+    ROS_INFO("Startup group %s: all %zu cameras configured, starting acquisition.", group_.c_str(), size_);
+    released_cv_.notify_all();
+  }
+}
+
+bool StartupCoordinator::wait(const double timeout)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  return released_cv_.wait_for(lock, std::chrono::duration<double>(timeout), [this] { return released_; });
+}
+
+void StartupCoordinator::release()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (released_)
+    return;
+  released_ = true;
+  ROS_WARN("Startup group %s: starting with %zu of %zu cameras configured.", group_.c_str(), members_.size(), size_);
+  released_cv_.notify_all();
+}
+
+void StartupCoordinator::started(const std::string& name)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  Member& started = member(name);
+  if (started.started.time_since_epoch().count() == 0)
+    started.started = std::chrono::steady_clock::now();
+}
+
+void StartupCoordinator::addToStatus(diagnostic_msgs::DiagnosticStatus* status) const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  addValue(status, "Startup group", group_);
+  addValue(status, "Group configured", std::to_string(members_.size()) + "/" + std::to_string(size_));
+
+  double slowest = 0.0;
+  std::chrono::steady_clock::time_point first_start = std::chrono::steady_clock::time_point::max();
+  std::chrono::steady_clock::time_point last_start = std::chrono::steady_clock::time_point::min();
+  for (const Member& member : members_)
+  {
+    addValue(status, "Init time s " + member.name, std::to_string(member.init_time));
+    slowest = std::max(slowest, member.init_time);
+    if (member.started.time_since_epoch().count() != 0)
+    {
+      first_start = std::min(first_start, member.started);
+      last_start = std::max(last_start, member.started);
+    }
+  }
+  addValue(status, "Slowest init time s", std::to_string(slowest));
+  if (first_start <= last_start)
+    addValue(status, "Start skew ms",
+             std::to_string(std::chrono::duration<double, std::milli>(last_start - first_start).count()));
+
+  if (released_ && !complete_ && status->level < diagnostic_msgs::DiagnosticStatus::WARN)
+  {
+    status->level = diagnostic_msgs::DiagnosticStatus::WARN;
+    status->message = "Group started before all cameras were configured";
+  }
+}
+}  // namespace spinnaker_camera_driver
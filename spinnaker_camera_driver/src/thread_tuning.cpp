@@ -0,0 +1,250 @@
+/**
+Software License Agreement (BSD)
+
+\file      thread_tuning.cpp
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "spinnaker_camera_driver/thread_tuning.h"
+#include "spinnaker_camera_driver/diagnostic_values.h"
+
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace spinnaker_camera_driver
+{
+static std::string formatCpuList(const std::vector<int>& cpus)
+{
+  std::ostringstream list;
+  for (size_t i = 0; i < cpus.size(); ++i)
+    list << (i > 0 ? "," : "") << cpus[i];
+  return list.str();
+}
+
+static bool readFirstLine(const std::string& path, std::string* line)
+{
+  std::ifstream file(path.c_str());
+  return file && std::getline(file, *line);
+}
+
+bool parseCpuList(const std::string& list, std::vector<int>* cpus)
+{
+  cpus->clear();
+  std::istringstream ranges(list);
+  std::string range;
+  while (std::getline(ranges, range, ','))
+  {
+    range.erase(std::remove_if(range.begin(), range.end(), ::isspace), range.end());
+    if (range.empty())
+      continue;
+
+    int first = 0;
+    int last = 0;
+    char dash = 0;
+    std::istringstream parser(range);
+    parser >> first;
+    if (parser.fail() || first < 0)
+      return false;
+    if (parser >> dash)
+    {
+      if (dash != '-' || !(parser >> last) || last < first)
+        return false;
+    }
+    else
+    {
+      last = first;
+    }
+    if (!parser.eof())
+      return false;
+
+    for (int cpu = first; cpu <= last; ++cpu)
+      cpus->push_back(cpu);
+  }
+  std::sort(cpus->begin(), cpus->end());
+  cpus->erase(std::unique(cpus->begin(), cpus->end()), cpus->end());
+  return true;
+}
+
+int getDeviceNumaNode(const std::string& device)
+{
+  std::vector<std::string> candidates;
+  if (!device.empty() && device[0] == '/')
+  {
+    candidates.push_back(device + "/numa_node");
+  }
+  else
+  {
+    candidates.push_back("/sys/class/net/" + device + "/device/numa_node");
+    candidates.push_back("/sys/bus/pci/devices/" + device + "/numa_node");
+  }
+
+  for (const std::string& path : candidates)
+  {
+    std::string line;
+    if (readFirstLine(path, &line))
+      return std::atoi(line.c_str());  // -1 on machines without NUMA
+  }
+  return -1;
+}
+
+ThreadTuning::ThreadTuning() : priority(0), numa_node(-1), state_(NOT_APPLIED)
+{
+}
+
+void ThreadTuning::load(const ros::NodeHandle& pnh, const std::string& prefix, const int default_numa_node)
+{
+  std::string cpu_list;
+  pnh.param<std::string>(prefix + "_cpus", cpu_list, "");
+  if (!parseCpuList(cpu_list, &cpus))
+  {
+    ROS_ERROR("[ThreadTuning]: Ignoring malformed CPU list '%s' in %s_cpus.", cpu_list.c_str(), prefix.c_str());
+    cpus.clear();
+  }
+  pnh.param<int>(prefix + "_priority", priority, 0);
+  pnh.param<int>(prefix + "_numa_node", numa_node, default_numa_node);
+}
+
+bool ThreadTuning::apply(const std::string& name)
+{
+  bool ok = true;
+
+  std::vector<int> affinity = cpus;
+  if (affinity.empty() && numa_node >= 0)
+  {
+    std::string node_cpus;
+    if (readFirstLine("/sys/devices/system/node/node" + std::to_string(numa_node) + "/cpulist", &node_cpus))
+      parseCpuList(node_cpus, &affinity);
+  }
+  if (!affinity.empty())
+  {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (const int cpu : affinity)
+    {
+      if (cpu < CPU_SETSIZE)
+        CPU_SET(cpu, &set);
+    }
+    const int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (error != 0)
+    {
+      ROS_WARN("[ThreadTuning]: Unable to run the %s thread on CPUs %s: %s", name.c_str(),
+               formatCpuList(affinity).c_str(), std::strerror(error));
+      ok = false;
+    }
+  }
+
+  if (numa_node >= 0)
+  {
+    // Preferred rather than bound, so allocations still succeed when the node runs out of memory
+    const size_t bits = 8 * sizeof(unsigned long);  // NOLINT(runtime/int) as required by set_mempolicy
+    std::vector<unsigned long> mask(numa_node / bits + 1, 0);  // NOLINT(runtime/int)
+    mask[numa_node / bits] |= 1UL << (numa_node % bits);
+    if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask.data(), mask.size() * bits + 1) != 0)
+    {
+      ROS_WARN("[ThreadTuning]: Unable to allocate the %s thread memory on NUMA node %d: %s", name.c_str(), numa_node,
+               std::strerror(errno));
+      ok = false;
+    }
+  }
+
+  if (priority > 0)
+  {
+    sched_param param;
+    param.sched_priority =
+        std::min(std::max(priority, sched_get_priority_min(SCHED_FIFO)), sched_get_priority_max(SCHED_FIFO));
+    const int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (error != 0)
+    {
+      ROS_WARN("[ThreadTuning]: Unable to run the %s thread with SCHED_FIFO priority %d: %s. Check the rtprio limit "
+               "in /etc/security/limits.conf.",
+               name.c_str(), param.sched_priority, std::strerror(error));
+      ok = false;
+    }
+  }
+
+  if (ok && (!affinity.empty() || numa_node >= 0 || priority > 0))
+    ROS_INFO("[ThreadTuning]: %s thread runs on CPUs %s with priority %d, memory on NUMA node %d.", name.c_str(),
+             affinity.empty() ? "any" : formatCpuList(affinity).c_str(), priority, numa_node);
+
+  state_ = ok ? APPLIED : FAILED;
+  return ok;
+}
+
+void ThreadTuning::addToStatus(const std::string& name, diagnostic_msgs::DiagnosticStatus* status) const
+{
+  addValue(status, name + " CPUs", cpus.empty() ? "any" : formatCpuList(cpus));
+  addValue(status, name + " priority", priority > 0 ? "SCHED_FIFO " + std::to_string(priority) : "default");
+  addValue(status, name + " NUMA node", numa_node >= 0 ? std::to_string(numa_node) : "default");
+
+  const int state = state_;
+  addValue(status, name + " tuning", state == APPLIED ? "applied" : state == FAILED ? "failed" : "not started");
+  if (state == FAILED)
+  {
+    status->level = std::max<uint8_t>(status->level, diagnostic_msgs::DiagnosticStatus::WARN);
+    status->message += (status->message.empty() ? "" : ", ") + name + " thread tuning failed";
+  }
+}
+
+DeadlineMonitor::DeadlineMonitor() : cycles_(0), missed_(0), worst_time_(0.0), last_deadline_(0.0), reported_missed_(0)
+{
+}
+
+void DeadlineMonitor::record(const double work_time, const double deadline)
+{
+  cycles_.store(cycles_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  if (deadline > 0.0 && work_time > deadline)
+    missed_.store(missed_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  if (work_time > worst_time_.load(std::memory_order_relaxed))
+    worst_time_.store(work_time, std::memory_order_relaxed);
+  last_deadline_.store(deadline, std::memory_order_relaxed);
+}
+
+void DeadlineMonitor::getStatus(diagnostic_msgs::DiagnosticStatus* status)
+{
+  const uint64_t missed = missed_;
+  if (missed > reported_missed_)
+  {
+    status->level = diagnostic_msgs::DiagnosticStatus::WARN;
+    status->message = std::to_string(missed - reported_missed_) + " deadlines missed";
+  }
+  else
+  {
+    status->level = diagnostic_msgs::DiagnosticStatus::OK;
+    status->message = "No deadlines missed";
+  }
+  reported_missed_ = missed;
+
+  addValue(status, "Cycles", std::to_string(cycles_.load()));
+  addValue(status, "Missed deadlines", std::to_string(missed));
+  addValue(status, "Worst cycle ms", std::to_string(worst_time_.exchange(0.0) * 1e3));
+  addValue(status, "Deadline ms", std::to_string(last_deadline_.load() * 1e3));
+}
+}  // namespace spinnaker_camera_driver
@@ -0,0 +1,408 @@
+/**
+Software License Agreement (BSD)
+
+\file      tiled_jpeg_encoder.cpp
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "spinnaker_camera_driver/tiled_jpeg_encoder.h"
+#include "spinnaker_camera_driver/bayer_pattern.h"
+
+#include <sensor_msgs/image_encodings.h>
+
+#include <algorithm>
+#include <csetjmp>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+
+// jpeglib.h needs size_t and FILE declared first
+#include <jpeglib.h>
+
+namespace spinnaker_camera_driver
+{
+namespace
+{
+// Strips other than the last must end on an MCU row, which is at most 16 pixel rows high.
+const size_t STRIP_ALIGNMENT = 16;
+
+struct PreviewLayout
+{
+  size_t width;
+  size_t height;
+  int components;
+  bool bayer;
+  bool sixteen_bit;
+  bool bgr;
+  size_t pixel_bytes;  ///< Bytes per pixel of the input image.
+  int red;             ///< Index of the red sample in a Bayer quad, row major.
+};
+
+bool getLayout(const sensor_msgs::Image& image, PreviewLayout* layout)
+{
+  namespace enc = sensor_msgs::image_encodings;
+  const std::string& encoding = image.encoding;
+  const int depth = enc::bitDepth(encoding);
+  if (depth != 8 && depth != 16)
+    return false;
+
+  layout->sixteen_bit = depth == 16;
+  layout->bayer = enc::isBayer(encoding);
+  layout->bgr = encoding == enc::BGR8 || encoding == enc::BGRA8;
+  layout->pixel_bytes = enc::numChannels(encoding) * depth / 8;
+  layout->red = 0;
+  if (layout->bayer)
+  {
+    layout->red = getBayerRedIndex(encoding);
+    if (layout->red < 0)
+      return false;
+    layout->width = image.width / 2;
+    layout->height = image.height / 2;
+    layout->components = 3;
+  }
+  else if (enc::isMono(encoding))
+  {
+    layout->width = image.width;
+    layout->height = image.height;
+    layout->components = 1;
+  }
+  else if (encoding == enc::RGB8 || encoding == enc::BGR8 || encoding == enc::RGBA8 || encoding == enc::BGRA8)
+  {
+    layout->width = image.width;
+    layout->height = image.height;
+    layout->components = 3;
+  }
+  else
+  {
+    return false;
+  }
+  return layout->width > 0 && layout->height > 0;
+}
+
+/// The most significant byte of a sample.
+inline uint8_t sample(const uint8_t* data, const bool sixteen_bit, const bool big_endian)
+{
+  return sixteen_bit && !big_endian ? data[1] : data[0];
+}
+
+/// Fills one row of 8 bit gray or RGB preview pixels.
+void convertRow(const sensor_msgs::Image& image, const PreviewLayout& layout, const size_t row, uint8_t* out)
+{
+  const size_t sample_bytes = layout.sixteen_bit ? 2 : 1;
+  const bool big_endian = image.is_bigendian;
+
+  if (layout.bayer)
+  {
+    const uint8_t* rows[2] = { image.data.data() + 2 * row * image.step,
+                               image.data.data() + (2 * row + 1) * image.step };
+    const int blue = 3 - layout.red;
+    const int green1 = layout.red ^ 1;
+    const int green2 = layout.red ^ 2;
+    for (size_t x = 0; x < layout.width; ++x)
+    {
+      uint8_t quad[4];
+      for (int i = 0; i < 4; ++i)
+        quad[i] = sample(rows[i / 2] + (2 * x + i % 2) * sample_bytes, layout.sixteen_bit, big_endian);
+      out[3 * x] = quad[layout.red];
+      out[3 * x + 1] = static_cast<uint8_t>((quad[green1] + quad[green2] + 1) / 2);
+      out[3 * x + 2] = quad[blue];
+    }
+    return;
+  }
+
+  const uint8_t* in = image.data.data() + row * image.step;
+  if (layout.components == 1)
+  {
+    for (size_t x = 0; x < layout.width; ++x)
+      out[x] = sample(in + x * sample_bytes, layout.sixteen_bit, big_endian);
+    return;
+  }
+  for (size_t x = 0; x < layout.width; ++x)
+  {
+    const uint8_t* pixel = in + x * layout.pixel_bytes;
+    out[3 * x] = layout.bgr ? pixel[2] : pixel[0];
+    out[3 * x + 1] = pixel[1];
+    out[3 * x + 2] = layout.bgr ? pixel[0] : pixel[2];
+  }
+}
+
+struct ErrorManager
+{
+  jpeg_error_mgr pub;
+  std::jmp_buf jump;
+  unsigned char* buffer;
+  unsigned long size;  // NOLINT(runtime/int) as required by jpeg_mem_dest
+};
+
+void onJpegError(j_common_ptr cinfo)
+{
+  std::longjmp(reinterpret_cast<ErrorManager*>(cinfo->err)->jump, 1);
+}
+
+/// Encodes rows [first_row, first_row + rows) of the preview as a standalone JPEG with a restart every MCU row.
+bool encodeStrip(const sensor_msgs::Image& image, const PreviewLayout& layout, const size_t first_row,
+                 const size_t rows, const int quality, std::vector<uint8_t>* out)
+{
+  jpeg_compress_struct cinfo;
+  ErrorManager error;
+  error.buffer = NULL;
+  error.size = 0;
+  cinfo.err = jpeg_std_error(&error.pub);
+  error.pub.error_exit = onJpegError;
+  std::vector<uint8_t> scanline(layout.width * layout.components);
+
+  if (setjmp(error.jump))
+  {
+    jpeg_destroy_compress(&cinfo);
+    std::free(error.buffer);
+    return false;
+  }
+
+  jpeg_create_compress(&cinfo);
+  jpeg_mem_dest(&cinfo, &error.buffer, &error.size);
+  cinfo.image_width = static_cast<JDIMENSION>(layout.width);
+  cinfo.image_height = static_cast<JDIMENSION>(rows);
+  cinfo.input_components = layout.components;
+  cinfo.in_color_space = layout.components == 1 ? JCS_GRAYSCALE : JCS_RGB;
+  jpeg_set_defaults(&cinfo);
+  jpeg_set_quality(&cinfo, quality, TRUE);
+  // The fixed default Huffman tables are shared by all strips, so their scans can be concatenated.
+  cinfo.optimize_coding = FALSE;
+  cinfo.restart_in_rows = 1;
+  jpeg_start_compress(&cinfo, TRUE);
+
+  for (size_t r = 0; r < rows; ++r)
+  {
+    convertRow(image, layout, first_row + r, scanline.data());
+    JSAMPROW row_pointer = scanline.data();
+    jpeg_write_scanlines(&cinfo, &row_pointer, 1);
+  }
+
+  jpeg_finish_compress(&cinfo);
+  out->assign(error.buffer, error.buffer + error.size);
+  jpeg_destroy_compress(&cinfo);
+  std::free(error.buffer);
+  return true;
+}
+
+/// Finds the start of the entropy coded data and the height field of the frame header.
+bool findScan(const std::vector<uint8_t>& jpeg, size_t* scan_start, size_t* height_offset)
+{
+  size_t pos = 2;  // Skip SOI
+  while (pos + 4 <= jpeg.size())
+  {
+    if (jpeg[pos] != 0xFF)
+      return false;
+    const uint8_t marker = jpeg[pos + 1];
+    const size_t length = static_cast<size_t>(jpeg[pos + 2]) << 8 | jpeg[pos + 3];
+    if (marker == 0xC0)  // SOF0: length, precision, height, width
+      *height_offset = pos + 5;
+    if (marker == 0xDA)  // SOS
+    {
+      *scan_start = pos + 2 + length;
+      return *scan_start <= jpeg.size();
+    }
+    pos += 2 + length;
+  }
+  return false;
+}
+
+/*
+ * Joins the strips into one JPEG. The headers of the first strip are kept with the height patched to the whole
+ * image. Every strip starts with fresh DC predictors just like after a restart, so the scans are concatenated with a
+ * restart marker in between and all restart markers renumbered in sequence.
+ */
+bool joinStrips(const std::vector<std::vector<uint8_t> >& strips, const size_t height, std::vector<uint8_t>* out)
+{
+  out->clear();
+  unsigned int restart = 0;
+  for (size_t k = 0; k < strips.size(); ++k)
+  {
+    const std::vector<uint8_t>& strip = strips[k];
+    size_t scan_start = 0;
+    size_t height_offset = 0;
+    if (!findScan(strip, &scan_start, &height_offset) || strip.size() < scan_start + 2)
+      return false;
+
+    if (k == 0)
+    {
+      if (height_offset == 0)
+        return false;
+      out->reserve(strips.size() * strip.size());
+      out->assign(strip.begin(), strip.begin() + scan_start);
+      (*out)[height_offset] = static_cast<uint8_t>(height >> 8);
+      (*out)[height_offset + 1] = static_cast<uint8_t>(height);
+    }
+    else
+    {
+      out->push_back(0xFF);
+      out->push_back(static_cast<uint8_t>(0xD0 + restart++ % 8));
+    }
+
+    const size_t end = strip.size() - 2;  // Drop EOI
+    for (size_t i = scan_start; i < end; ++i)
+    {
+      out->push_back(strip[i]);
+      if (strip[i] == 0xFF && i + 1 < end && strip[i + 1] >= 0xD0 && strip[i + 1] <= 0xD7)
+      {
+        out->push_back(static_cast<uint8_t>(0xD0 + restart++ % 8));
+        ++i;
+      }
+    }
+  }
+  out->push_back(0xFF);
+  out->push_back(0xD9);
+  return true;
+}
+
+size_t getStripRows(const size_t height, const size_t strips)
+{
+  const size_t rows = (height + strips - 1) / strips;
+  return (rows + STRIP_ALIGNMENT - 1) / STRIP_ALIGNMENT * STRIP_ALIGNMENT;
+}
+
+std::string getFormat(const PreviewLayout& layout)
+{
+  return layout.components == 1 ? "mono8; jpeg compressed mono8" : "rgb8; jpeg compressed bgr8";
+}
+}  // namespace
+
+struct TiledJpegEncoder::Frame
+{
+  sensor_msgs::ImageConstPtr image;
+  PreviewLayout layout;
+  size_t strip_rows;
+  std::vector<std::vector<uint8_t> > strips;
+  std::atomic<size_t> remaining;
+  std::atomic<bool> failed;
+};
+
+TiledJpegEncoder::TiledJpegEncoder(ros::NodeHandle& nh, const size_t strips, const int quality, const double max_rate)
+  : pub_(nh.advertise<sensor_msgs::CompressedImage>("image_preview/compressed", 5))
+  , strips_(std::max<size_t>(1, strips))
+  , quality_(std::min(100, std::max(1, quality)))
+  , min_period_(max_rate > 0.0 ? 1.0 / max_rate : 0.0)
+  , busy_(false)
+  , skipped_(0)
+  , pool_(new WorkerPool(strips_, strips_, "TiledJpegEncoder"))
+{
+}
+
+TiledJpegEncoder::~TiledJpegEncoder()
+{
+  pool_.reset();
+}
+
+bool TiledJpegEncoder::encode(const sensor_msgs::Image& image, const size_t strips, const int quality,
+                              sensor_msgs::CompressedImage* compressed)
+{
+  PreviewLayout layout;
+  if (!getLayout(image, &layout) || image.data.size() < static_cast<size_t>(image.step) * image.height)
+    return false;
+
+  const size_t strip_rows = getStripRows(layout.height, std::max<size_t>(1, strips));
+  std::vector<std::vector<uint8_t> > encoded((layout.height + strip_rows - 1) / strip_rows);
+  for (size_t k = 0; k < encoded.size(); ++k)
+  {
+    const size_t first_row = k * strip_rows;
+    if (!encodeStrip(image, layout, first_row, std::min(strip_rows, layout.height - first_row), quality,
+                     &encoded[k]))
+      return false;
+  }
+
+  compressed->header = image.header;
+  compressed->format = getFormat(layout);
+  return joinStrips(encoded, layout.height, &compressed->data);
+}
+
+bool TiledJpegEncoder::publish(const sensor_msgs::ImageConstPtr& image)
+{
+  if (!last_frame_.isZero() && image->header.stamp - last_frame_ < min_period_)
+    return false;
+
+  std::shared_ptr<Frame> frame = std::make_shared<Frame>();
+  frame->image = image;
+  if (!getLayout(*image, &frame->layout) || image->data.size() < static_cast<size_t>(image->step) * image->height)
+  {
+    ROS_WARN_THROTTLE(10, "[TiledJpegEncoder]: Unable to encode %s images.", image->encoding.c_str());
+    return false;
+  }
+
+  // Skip the frame rather than queue up behind a frame that is still being encoded
+  if (busy_.exchange(true))
+  {
+    ++skipped_;
+    return false;
+  }
+  last_frame_ = image->header.stamp;
+
+  frame->strip_rows = getStripRows(frame->layout.height, strips_);
+  const size_t count = (frame->layout.height + frame->strip_rows - 1) / frame->strip_rows;
+  frame->strips.resize(count);
+  frame->remaining = count;
+  frame->failed = false;
+
+  for (size_t k = 0; k < count; ++k)
+  {
+    // The pool queue holds a full frame of strips and only one frame is in flight, so this always succeeds.
+    if (!pool_->trySubmit(std::bind(&TiledJpegEncoder::encodeStripTask, this, frame, k)))
+    {
+      ROS_ERROR("[TiledJpegEncoder]: Unable to queue strip %zu.", k);
+      frame->failed = true;
+      for (size_t j = k; j < count; ++j)
+      {
+        if (--frame->remaining == 0)
+          busy_ = false;
+      }
+      return false;
+    }
+  }
+  return true;
+}
+
+void TiledJpegEncoder::encodeStripTask(const std::shared_ptr<Frame>& frame, const size_t strip)
+{
+  const size_t first_row = strip * frame->strip_rows;
+  const size_t rows = std::min(frame->strip_rows, frame->layout.height - first_row);
+  if (!encodeStrip(*frame->image, frame->layout, first_row, rows, quality_, &frame->strips[strip]))
+    frame->failed = true;
+
+  if (--frame->remaining > 0)
+    return;
+
+  // Last strip of the frame, join and publish
+  if (!frame->failed)
+  {
+    sensor_msgs::CompressedImagePtr compressed(new sensor_msgs::CompressedImage);
+    compressed->header = frame->image->header;
+    compressed->format = getFormat(frame->layout);
+    if (joinStrips(frame->strips, frame->layout.height, &compressed->data))
+      pub_.publish(compressed);
+    else
+      ROS_ERROR_THROTTLE(10, "[TiledJpegEncoder]: Unable to join the JPEG strips.");
+  }
+  else
+  {
+    ROS_ERROR_THROTTLE(10, "[TiledJpegEncoder]: Failed to encode a frame.");
+  }
+  busy_ = false;
+}
+}  // namespace spinnaker_camera_driver
@@ -0,0 +1,248 @@
+/**
+Software License Agreement (BSD)
+
+\file      tone_mapper.cpp
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "spinnaker_camera_driver/tone_mapper.h"
+
+#include <sensor_msgs/image_encodings.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TONE_MAPPER_AVX2
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+namespace spinnaker_camera_driver
+{
+namespace
+{
+/// Entries of the table, one per 16 bit input value.
+const size_t LUT_SIZE = 65536;
+/// A 32 bit gather of the last entry reads this many bytes past it.
+const size_t LUT_PADDING = 3;
+/// Input values per histogram bin.
+const int HISTOGRAM_SHIFT = 4;
+
+/// 8 bit encoding with the same layout as a 16 bit mono or Bayer encoding, empty for other encodings.
+std::string eightBitEncoding(const std::string& encoding)
+{
+  namespace enc = sensor_msgs::image_encodings;
+  if (encoding == enc::MONO16)
+    return enc::MONO8;
+  if (encoding == enc::BAYER_RGGB16)
+    return enc::BAYER_RGGB8;
+  if (encoding == enc::BAYER_BGGR16)
+    return enc::BAYER_BGGR8;
+  if (encoding == enc::BAYER_GBRG16)
+    return enc::BAYER_GBRG8;
+  if (encoding == enc::BAYER_GRBG16)
+    return enc::BAYER_GRBG8;
+  return std::string();
+}
+
+#if defined(TONE_MAPPER_AVX2)
+/// Looks up 16 samples per iteration with two gathers of 8 table entries each.
+__attribute__((target("avx2"))) void applyAvx2(const uint16_t* source, const size_t count, const uint8_t* lut,
+                                                uint8_t* destination)
+{
+  const int* table = reinterpret_cast<const int*>(lut);
+  const __m256i low_byte = _mm256_set1_epi32(0xff);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16)
+  {
+    const __m256i samples = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+    const __m256i index_low = _mm256_cvtepu16_epi32(_mm256_castsi256_si128(samples));
+    const __m256i index_high = _mm256_cvtepu16_epi32(_mm256_extracti128_si256(samples, 1));
+    // Each gather reads 4 bytes at the entry, the entry is the lowest one
+    const __m256i values_low = _mm256_and_si256(_mm256_i32gather_epi32(table, index_low, 1), low_byte);
+    const __m256i values_high = _mm256_and_si256(_mm256_i32gather_epi32(table, index_high, 1), low_byte);
+    // Packing works within 128 bit lanes, the permute puts the 16 bit values back in order
+    const __m256i words = _mm256_permute4x64_epi64(_mm256_packus_epi32(values_low, values_high), 0xd8);
+    const __m128i bytes = _mm_packus_epi16(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), bytes);
+  }
+  for (; i < count; ++i)
+    destination[i] = lut[source[i]];
+}
+#endif
+}  // namespace
+
+ToneMapper::ToneMapper(ros::NodeHandle& nh, const Parameters& parameters)
+  : it_(nh)
+  , pub_(it_.advertise("image_8bit", 5))
+  , parameters_(parameters)
+  , window_valid_(false)
+  , low_(parameters.min)
+  , high_(parameters.max)
+  , lut_low_(0.0)
+  , lut_high_(0.0)
+  , lut_(LUT_SIZE + LUT_PADDING, 0)
+  , histogram_(LUT_SIZE >> HISTOGRAM_SHIFT)
+{
+  buildLut();
+}
+
+bool ToneMapper::parseCurve(const std::string& name, Curve* curve)
+{
+  if (name == "linear")
+    *curve = LINEAR;
+  else if (name == "gamma")
+    *curve = GAMMA;
+  else if (name == "log")
+    *curve = LOG;
+  else
+    return false;
+  return true;
+}
+
+void ToneMapper::apply(const uint16_t* source, const size_t count, const uint8_t* lut, uint8_t* destination)
+{
+#if defined(TONE_MAPPER_AVX2)
+  static const bool avx2 = __builtin_cpu_supports("avx2");
+  if (avx2)
+  {
+    applyAvx2(source, count, lut, destination);
+    return;
+  }
+#endif
+  for (size_t i = 0; i < count; ++i)
+    destination[i] = lut[source[i]];
+}
+
+void ToneMapper::publish(const sensor_msgs::Image& image)
+{
+  const std::string encoding = eightBitEncoding(image.encoding);
+  if (encoding.empty() || image.is_bigendian || image.step < image.width * 2 ||
+      image.data.size() < static_cast<size_t>(image.step) * image.height)
+  {
+    ROS_WARN_ONCE("[ToneMapper]: Only 16 bit mono and Bayer images are mapped to 8 bit, skipping %s images.",
+                  image.encoding.c_str());
+    return;
+  }
+
+  if (parameters_.auto_percentile && updateWindow(image))
+    buildLut();
+
+  sensor_msgs::ImagePtr mapped(new sensor_msgs::Image);
+  mapped->header = image.header;
+  mapped->height = image.height;
+  mapped->width = image.width;
+  mapped->encoding = encoding;
+  mapped->is_bigendian = false;
+  mapped->step = image.width;
+  mapped->data.resize(static_cast<size_t>(image.width) * image.height);
+  for (uint32_t y = 0; y < image.height; ++y)
+    apply(reinterpret_cast<const uint16_t*>(&image.data[static_cast<size_t>(y) * image.step]), image.width,
+          lut_.data(), &mapped->data[static_cast<size_t>(y) * image.width]);
+  pub_.publish(mapped);
+}
+
+bool ToneMapper::updateWindow(const sensor_msgs::Image& image)
+{
+  // Bayer images are sampled in whole quads so that every color counts the same
+  const uint32_t block = sensor_msgs::image_encodings::isBayer(image.encoding) ? 2 : 1;
+  const uint32_t stride = block * static_cast<uint32_t>(std::max(1, parameters_.subsample));
+  std::fill(histogram_.begin(), histogram_.end(), 0);
+  uint64_t total = 0;
+  for (uint32_t y = 0; y + block <= image.height; y += stride)
+  {
+    for (uint32_t dy = 0; dy < block; ++dy)
+    {
+      const uint16_t* row = reinterpret_cast<const uint16_t*>(&image.data[static_cast<size_t>(y + dy) * image.step]);
+      for (uint32_t x = 0; x + block <= image.width; x += stride)
+      {
+        for (uint32_t dx = 0; dx < block; ++dx)
+          ++histogram_[row[x + dx] >> HISTOGRAM_SHIFT];
+      }
+    }
+  }
+  for (size_t i = 0; i < histogram_.size(); ++i)
+    total += histogram_[i];
+  if (total == 0)
+    return false;
+
+  const uint64_t low_count =
+      static_cast<uint64_t>(total * std::min(std::max(parameters_.low_percentile, 0.0), 100.0) / 100.0);
+  const uint64_t high_count =
+      static_cast<uint64_t>(total * std::min(std::max(parameters_.high_percentile, 0.0), 100.0) / 100.0);
+  size_t low_bin = histogram_.size() - 1;
+  size_t high_bin = histogram_.size() - 1;
+  uint64_t sum = 0;
+  for (size_t i = 0; i < histogram_.size(); ++i)
+  {
+    sum += histogram_[i];
+    if (sum >= low_count && low_bin == histogram_.size() - 1)
+      low_bin = i;
+    if (sum >= high_count)
+    {
+      high_bin = i;
+      break;
+    }
+  }
+  const double low = static_cast<double>(low_bin << HISTOGRAM_SHIFT);
+  const double high = static_cast<double>(((high_bin + 1) << HISTOGRAM_SHIFT) - 1);
+
+  if (!window_valid_)
+  {
+    low_ = low;
+    high_ = high;
+    window_valid_ = true;
+  }
+  else
+  {
+    const double damping = std::min(std::max(parameters_.damping, 0.0), 1.0);
+    low_ += damping * (low - low_);
+    high_ += damping * (high - high_);
+  }
+
+  // Rebuilt only once an edge of the window moved by at least one output level
+  const double level = (lut_high_ - lut_low_) / 256.0;
+  return std::abs(low_ - lut_low_) >= level || std::abs(high_ - lut_high_) >= level;
+}
+
+void ToneMapper::buildLut()
+{
+  // A window narrower than a histogram bin would map single values to the full output range
+  const double low = std::min(std::max(low_, 0.0), static_cast<double>(LUT_SIZE - 1));
+  const double high = std::max(std::min(high_, static_cast<double>(LUT_SIZE - 1)), low + (1 << HISTOGRAM_SHIFT));
+  const double inverse_gamma = parameters_.gamma > 0.0 ? 1.0 / parameters_.gamma : 1.0;
+  const double log_gain = parameters_.log_gain > 0.0 ? parameters_.log_gain : 1.0;
+  const double log_scale = 1.0 / std::log1p(log_gain);
+
+  for (size_t value = 0; value < LUT_SIZE; ++value)
+  {
+    const double t = std::min(std::max((value - low) / (high - low), 0.0), 1.0);
+    double mapped = t;
+    if (parameters_.curve == GAMMA)
+      mapped = std::pow(t, inverse_gamma);
+    else if (parameters_.curve == LOG)
+      mapped = std::log1p(log_gain * t) * log_scale;
+    lut_[value] = static_cast<uint8_t>(std::lround(255.0 * mapped));
+  }
+  lut_low_ = low;
+  lut_high_ = high;
+}
+}  // namespace spinnaker_camera_driver
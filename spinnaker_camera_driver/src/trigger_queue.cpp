@@ -0,0 +1,154 @@
+/**
+Software License Agreement (BSD)
+
+\file      trigger_queue.cpp
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "spinnaker_camera_driver/trigger_queue.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace spinnaker_camera_driver
+{
+TriggerQueue::TriggerQueue(const std::function<void()>& fire) : fire_(fire)
+{
+}
+
+bool TriggerQueue::capture(const size_t count, const double timeout, std::vector<sensor_msgs::Image>* images,
+                           std::vector<double>* latencies, std::string* message)
+{
+  std::shared_ptr<Request> request = std::make_shared<Request>();
+  request->remaining = count;
+  request->failed = false;
+  request->images.reserve(count);
+  request->latencies.reserve(count);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (size_t i = 0; i < count; ++i)
+  {
+    Shot shot;
+    shot.request = request;
+    shot.fired = false;
+    shots_.push_back(shot);
+  }
+  fireNext();
+
+  const bool done = done_cv_.wait_for(lock, std::chrono::duration<double>(timeout),
+                                      [&request] { return request->remaining == 0 || request->failed; });
+  if (!done)
+    fail(request, "Timed out with " + std::to_string(request->remaining) + " of " + std::to_string(count) +
+                      " frames missing.");
+  // A frame of the shot in flight may still arrive, it is published but no longer returned
+  if (request->failed && !shots_.empty() && shots_.front().request == request)
+    shots_.front().request.reset();
+
+  images->swap(request->images);
+  latencies->swap(request->latencies);
+  *message = request->message;
+  return !request->failed;
+}
+
+void TriggerQueue::queue(const size_t count)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (size_t i = 0; i < count; ++i)
+  {
+    Shot shot;
+    shot.fired = false;
+    shots_.push_back(shot);
+  }
+  fireNext();
+}
+
+void TriggerQueue::frameGrabbed(const sensor_msgs::Image* image, const std::chrono::steady_clock::time_point grabbed,
+                                const double stale_timeout)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  // Frames without a shot in flight come from another trigger source or from free running
+  if (shots_.empty() || !shots_.front().fired)
+    return;
+
+  Shot shot = shots_.front();
+  if (image)
+  {
+    shots_.pop_front();
+    if (shot.request)
+    {
+      shot.request->images.push_back(*image);
+      shot.request->latencies.push_back(std::chrono::duration<double>(grabbed - shot.fired_at).count());
+      if (--shot.request->remaining == 0)
+        done_cv_.notify_all();
+    }
+  }
+  else if (grabbed - shot.fired_at > std::chrono::duration<double>(stale_timeout))
+  {
+    shots_.pop_front();
+    if (shot.request)
+      fail(shot.request, "No frame followed the software trigger, is trigger_source Software?");
+  }
+  fireNext();
+}
+
+void TriggerQueue::clear(const std::string& reason)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::deque<Shot> shots;
+  shots.swap(shots_);
+  for (const Shot& shot : shots)
+  {
+    if (shot.request && !shot.request->failed)
+      fail(shot.request, reason);
+  }
+}
+
+void TriggerQueue::fireNext()
+{
+  while (!shots_.empty() && !shots_.front().fired)
+  {
+    Shot& shot = shots_.front();
+    try
+    {
+      shot.fired_at = std::chrono::steady_clock::now();
+      fire_();
+      shot.fired = true;
+      return;
+    }
+    catch (const std::runtime_error& e)
+    {
+      const std::shared_ptr<Request> request = shot.request;
+      shots_.pop_front();
+      if (request)
+        fail(request, e.what());
+    }
+  }
+}
+
+void TriggerQueue::fail(const std::shared_ptr<Request>& request, const std::string& message)
+{
+  request->failed = true;
+  request->message = message;
+  // The remaining shots of the request would fail the same way
+  shots_.erase(std::remove_if(shots_.begin(), shots_.end(),
+                              [&request](const Shot& shot) { return !shot.fired && shot.request == request; }),
+               shots_.end());
+  done_cv_.notify_all();
+}
+}  // namespace spinnaker_camera_driver
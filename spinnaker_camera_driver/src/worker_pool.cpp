@@ -0,0 +1,88 @@
+/**
+Software License Agreement (BSD)
+
+\file      worker_pool.cpp
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "spinnaker_camera_driver/worker_pool.h"
+
+#include <ros/ros.h>
+
+#include <algorithm>
+#include <exception>
+#include <string>
+
+namespace spinnaker_camera_driver
+{
+WorkerPool::WorkerPool(const size_t thread_count, const size_t queue_size, const std::string& name)
+  : queue_size_(std::max<size_t>(1, queue_size)), name_(name), shutdown_(false)
+{
+  for (size_t i = 0; i < std::max<size_t>(1, thread_count); ++i)
+    threads_.push_back(std::thread(&WorkerPool::run, this));
+}
+
+WorkerPool::~WorkerPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutdown_ = true;
+  }
+  cv_.notify_all();
+  for (std::thread& thread : threads_)
+    thread.join();
+}
+
+bool WorkerPool::trySubmit(const std::function<void()>& task)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (tasks_.size() >= queue_size_)
+      return false;
+    tasks_.push_back(task);
+  }
+  cv_.notify_one();
+  return true;
+}
+
+void WorkerPool::run()
+{
+  while (true)
+  {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this] { return shutdown_ || !tasks_.empty(); });
+      if (tasks_.empty())
+        return;
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+
+    try
+    {
+      task();
+    }
+    catch (const std::exception& e)
+    {
+      ROS_ERROR("[%s]: Task failed: %s", name_.c_str(), e.what());
+    }
+  }
+}
+}  // namespace spinnaker_camera_driver
@@ -0,0 +1,159 @@
+/**
+Software License Agreement (BSD)
+
+\file      raw_compressor_test.cpp
+\copyright Copyright (c) 2018, Clearpath Robotics, Inc., All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "spinnaker_camera_driver/raw_compressor.h"
+
+#include <gtest/gtest.h>
+#include <sensor_msgs/image_encodings.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+using spinnaker_camera_driver::RawCompressor;
+
+namespace
+{
+sensor_msgs::Image makeImage(const std::string& encoding, const uint32_t width, const uint32_t height,
+                             const uint32_t step)
+{
+  sensor_msgs::Image image;
+  image.encoding = encoding;
+  image.width = width;
+  image.height = height;
+  image.step = step;
+  image.is_bigendian = false;
+  image.data.resize(static_cast<size_t>(step) * height);
+  uint32_t state = 12345;
+  for (size_t i = 0; i < image.data.size(); ++i)
+  {
+    // Smooth gradient with noise in the low bits, like a real frame
+    state = state * 1103515245 + 12345;
+    image.data[i] = static_cast<uint8_t>((i % step) / 4 + ((state >> 16) & 7));
+  }
+  return image;
+}
+
+void expectRoundTrip(const sensor_msgs::Image& image)
+{
+  sensor_msgs::CompressedImage compressed;
+  ASSERT_TRUE(RawCompressor::compress(image, 1, &compressed));
+  sensor_msgs::Image restored;
+  ASSERT_TRUE(RawCompressor::decompress(compressed, &restored));
+  EXPECT_EQ(image.encoding, restored.encoding);
+  EXPECT_EQ(image.width, restored.width);
+  EXPECT_EQ(image.height, restored.height);
+  EXPECT_EQ(image.step, restored.step);
+  ASSERT_EQ(image.data.size(), restored.data.size());
+  // Padding at the end of the rows is not kept
+  const size_t row_bytes = image.width * sensor_msgs::image_encodings::numChannels(image.encoding) *
+                           sensor_msgs::image_encodings::bitDepth(image.encoding) / 8;
+  for (size_t r = 0; r < image.height; ++r)
+    EXPECT_EQ(0, std::memcmp(&image.data[r * image.step], &restored.data[r * image.step], row_bytes)) << "row " << r;
+}
+
+/// Offset of the step in the header, after magic, version, bytes per sample, plane count, width, height and channels.
+const size_t STEP_OFFSET = 4 + 2 + 1 + 1 + 4 + 4 + 4;
+const size_t HEIGHT_OFFSET = 4 + 2 + 1 + 1 + 4;
+}  // namespace
+
+TEST(RawCompressor, RoundTripBayer8)
+{
+  expectRoundTrip(makeImage(sensor_msgs::image_encodings::BAYER_RGGB8, 64, 48, 64));
+}
+
+TEST(RawCompressor, RoundTripBayer16OddSize)
+{
+  expectRoundTrip(makeImage(sensor_msgs::image_encodings::BAYER_GRBG16, 33, 17, 66));
+}
+
+TEST(RawCompressor, RoundTripPaddedColor)
+{
+  expectRoundTrip(makeImage(sensor_msgs::image_encodings::RGB8, 20, 10, 64));
+}
+
+TEST(RawCompressor, RoundTripMono16)
+{
+  expectRoundTrip(makeImage(sensor_msgs::image_encodings::MONO16, 31, 7, 62));
+}
+
+TEST(RawCompressor, RejectsStepShorterThanRow)
+{
+  sensor_msgs::Image image = makeImage(sensor_msgs::image_encodings::MONO8, 32, 8, 32);
+  image.step = 16;
+  sensor_msgs::CompressedImage compressed;
+  EXPECT_FALSE(RawCompressor::compress(image, 1, &compressed));
+}
+
+TEST(RawCompressor, RejectsTruncatedData)
+{
+  sensor_msgs::CompressedImage compressed;
+  ASSERT_TRUE(RawCompressor::compress(makeImage(sensor_msgs::image_encodings::BAYER_RGGB8, 64, 48, 64), 1,
+                                      &compressed));
+  sensor_msgs::Image restored;
+  sensor_msgs::CompressedImage truncated = compressed;
+  truncated.data.resize(compressed.data.size() - 1);
+  EXPECT_FALSE(RawCompressor::decompress(truncated, &restored));
+  truncated.data.resize(10);
+  EXPECT_FALSE(RawCompressor::decompress(truncated, &restored));
+}
+
+TEST(RawCompressor, RejectsCorruptHeader)
+{
+  sensor_msgs::CompressedImage compressed;
+  ASSERT_TRUE(
+      RawCompressor::compress(makeImage(sensor_msgs::image_encodings::MONO8, 64, 48, 64), 1, &compressed));
+  sensor_msgs::Image restored;
+
+  // A step too small for the rows would let the planes write past the image
+  sensor_msgs::CompressedImage corrupt = compressed;
+  const uint32_t short_step = 8;
+  std::memcpy(&corrupt.data[STEP_OFFSET], &short_step, sizeof(short_step));
+  EXPECT_FALSE(RawCompressor::decompress(corrupt, &restored));
+
+  // Sizes whose product overflows
+  corrupt = compressed;
+  const uint32_t huge = 0xffffffff;
+  std::memcpy(&corrupt.data[STEP_OFFSET], &huge, sizeof(huge));
+  std::memcpy(&corrupt.data[HEIGHT_OFFSET], &huge, sizeof(huge));
+  EXPECT_FALSE(RawCompressor::decompress(corrupt, &restored));
+
+  // Encoding and header disagree on the sample size
+  corrupt = compressed;
+  corrupt.format = sensor_msgs::image_encodings::MONO16 + "; lz4 planar delta";
+  EXPECT_FALSE(RawCompressor::decompress(corrupt, &restored));
+
+  corrupt = compressed;
+  corrupt.data[0] ^= 0xff;
+  EXPECT_FALSE(RawCompressor::decompress(corrupt, &restored));
+
+  corrupt = compressed;
+  corrupt.format = "mono8";
+  EXPECT_FALSE(RawCompressor::decompress(corrupt, &restored));
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}